@@ -0,0 +1,33 @@
+#pragma once
+
+#include "vm.h"
+
+#include <string>
+#include <vector>
+
+namespace jiffle {
+	namespace aot {
+
+		// Ahead-of-time translation of linked tables to C, built by any C99
+		// compiler ('cc -O2 program.c -lm') into a program printing the
+		// output of the first table as the command line does. A table is a
+		// function with its registers as locals, its constants as static
+		// data, and its jump tables as C switches; tail calls return to a
+		// trampoline, so loops don't grow the native stack. Values outside
+		// the runtime (objects, closures, big integers, shared state and
+		// input) make a program untranslatable. End code, which the VM
+		// doesn't run either, isn't translated.
+
+		// C source of tables, false (with what is missing) when a table
+		// can't be translated. The source includes "jiffle_runtime.h".
+		bool translate(const std::vector<vm::table>& tables, std::string& source, std::vector<std::string>& unsupported);
+
+		// the runtime header translated sources include
+		const std::string& runtime();
+
+		// tests --------------------------------------------------------------
+
+		void translate_test();
+
+	}
+}
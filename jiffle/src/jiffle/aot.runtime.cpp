@@ -0,0 +1,395 @@
+#include "aot.h"
+
+namespace jiffle {
+	namespace aot {
+
+		// C99, pieces below the size MSVC allows for one string literal
+		static const char* _pieces[] = {
+R"runtime(/* jiffle_runtime.h: runtime of C translated from jiffle tables (aot::translate).
+ *
+ * Values behave as in the VM, but for integers: where the VM continues an
+ * overflowing result as a big integer, this runtime gives an error value.
+ * Values are never freed, a translated program runs once and exits.
+ * Deep recursion (up to JF_MAX_FRAMES, as the VM) needs a large native stack.
+ */
+#ifndef JIFFLE_RUNTIME_H
+#define JIFFLE_RUNTIME_H
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef JF_MAX_FRAMES
+#define JF_MAX_FRAMES (1 << 16)
+#endif
+
+enum { JF_VOID, JF_BOOL, JF_INTEGER, JF_REAL, JF_STRING, JF_ERROR, JF_SEQUENCE, JF_OBJECT, JF_BIGINTEGER };
+enum { JF_ADD, JF_SUB, JF_MUL, JF_DIV, JF_MOD, JF_POW, JF_RSHIFT, JF_LSHIFT, JF_AND, JF_OR, JF_XOR };
+
+typedef struct jf_value {
+	unsigned char type;
+	union {
+		int boolean;
+		int64_t integer;
+		long double real;
+		struct { const char* text; size_t length; } s;				/* String, Error */
+		struct { const struct jf_value* items; size_t count; } seq;	/* Sequence */
+	} u;
+} jf_value;
+
+typedef struct { jf_value* items; size_t count, capacity; } jf_seq;
+
+struct jf_ctx;
+typedef int (*jf_code)(struct jf_ctx* c, const jf_value* args, size_t argc);
+
+/* translated table: code returns the table it tail calls, or -1 */
+typedef struct {
+	jf_code code;
+	const unsigned char* specs;	/* parameter types, JF_VOID when unspecified */
+	size_t nspecs;
+} jf_table;
+
+typedef struct jf_ctx {
+	const jf_table* tables;
+	jf_seq* outputs;			/* stack of output sequences */
+	size_t depth, capacity;
+	jf_value args[256];			/* arguments of a tail call */
+	size_t argc;
+	size_t frames;
+} jf_ctx;
+
+static const jf_value jf_none = { JF_VOID, { 0 } };
+
+static inline void* jf_alloc(void* p, size_t n) {
+	p = realloc(p, n ? n : 1);
+	if (!p) {
+		fputs("jiffle: out of memory\n", stderr);
+		exit(2);
+	}
+	return p;
+}
+
+/* values */
+static inline jf_value jf_bool(int b) { jf_value v = jf_none; v.type = JF_BOOL; v.u.boolean = b != 0; return v; }
+static inline jf_value jf_int(int64_t i) { jf_value v = jf_none; v.type = JF_INTEGER; v.u.integer = i; return v; }
+static inline jf_value jf_real(long double r) { jf_value v = jf_none; v.type = JF_REAL; v.u.real = r; return v; }
+static inline jf_value jf_err(const char* text) {
+	jf_value v = jf_none;
+	v.type = JF_ERROR;
+	v.u.s.text = text;
+	v.u.s.length = strlen(text);
+	return v;
+}
+static inline int jf_integral(jf_value v) { return v.type == JF_INTEGER; }
+static inline int jf_number(jf_value v) { return v.type == JF_INTEGER || v.type == JF_REAL; }
+static inline long double jf_to_real(jf_value v) {
+	return v.type == JF_INTEGER ? (long double)v.u.integer : v.type == JF_REAL ? v.u.real : 0;
+}
+static inline int jf_sign(jf_value v) {
+	switch (v.type) {
+	case JF_VOID: return 0;
+	case JF_BOOL: return v.u.boolean ? 1 : 0;
+	case JF_INTEGER: return v.u.integer < 0 ? -1 : v.u.integer > 0 ? 1 : 0;
+	case JF_REAL: return v.u.real < 0 ? -1 : v.u.real > 0 ? 1 : 0;
+	default: return 1;
+	}
+}
+
+/* output sequences */
+static inline void jf_push(jf_seq* s, jf_value v) {
+	if (s->count == s->capacity) {
+		s->capacity = s->capacity ? s->capacity * 2 : 4;
+		s->items = (jf_value*)jf_alloc(s->items, s->capacity * sizeof(jf_value));
+	}
+	s->items[s->count++] = v;
+}
+static inline void jf_emit(struct jf_ctx* c, jf_value v) { jf_push(&c->outputs[c->depth - 1], v); }
+static inline void jf_begin(struct jf_ctx* c) {
+	if (c->depth == c->capacity) {
+		c->capacity = c->capacity ? c->capacity * 2 : 64;
+		c->outputs = (jf_seq*)jf_alloc(c->outputs, c->capacity * sizeof(jf_seq));
+	}
+	c->outputs[c->depth].items = NULL;
+	c->outputs[c->depth].count = c->outputs[c->depth].capacity = 0;
+	c->depth++;
+}
+/* a single item sequence equals its item, unless forced */
+static inline jf_value jf_pack(jf_seq s, int forced) {
+	jf_value v = jf_none;
+	if (s.count <= 1 && !forced) {
+		if (s.count)
+			v = s.items[0];
+		free(s.items);
+		return v;
+	}
+	v.type = JF_SEQUENCE;
+	v.u.seq.items = s.items;
+	v.u.seq.count = s.count;
+	return v;
+}
+static inline jf_value jf_end(struct jf_ctx* c, int forced) { return jf_pack(c->outputs[--c->depth], forced); }
+static inline void jf_store(struct jf_ctx* c, jf_value* into, jf_value v) {
+	if (into)
+		*into = v;
+	else
+		jf_emit(c, v);
+}
+)runtime",
+R"runtime(
+/* items */
+static inline size_t jf_size(jf_value v) { return v.type == JF_SEQUENCE ? v.u.seq.count : v.type == JF_VOID ? 0 : 1; }
+static inline jf_value jf_item(jf_value v, size_t index, int from_end) {
+	size_t size = jf_size(v);
+	if (index >= size)
+		return jf_none;
+	if (from_end)
+		index = size - 1 - index;
+	return v.type == JF_SEQUENCE ? v.u.seq.items[index] : v;
+}
+static inline jf_value jf_slice(jf_value v, size_t from, size_t drop) {
+	size_t size = jf_size(v), to = size > drop ? size - drop : 0, i;
+	jf_seq s = { NULL, 0, 0 };
+	if (v.type != JF_SEQUENCE && from < to)
+		jf_push(&s, v);
+	else
+		for (i = from; i < to; i++)
+			jf_push(&s, v.u.seq.items[i]);
+	return jf_pack(s, 0);
+}
+static inline size_t jf_key(jf_value v, size_t count) {
+	return v.type != JF_INTEGER || v.u.integer < 0 ? 0 : (uint64_t)v.u.integer < count ? (size_t)v.u.integer : count - 1;
+}
+static inline jf_value jf_concat(jf_value a, jf_value b) {
+	char* text;
+	if (a.type != JF_STRING || b.type != JF_STRING)
+		return jf_err("invalid operands, strings expected");
+	text = (char*)jf_alloc(NULL, a.u.s.length + b.u.s.length);
+	memcpy(text, a.u.s.text, a.u.s.length);
+	memcpy(text + a.u.s.length, b.u.s.text, b.u.s.length);
+	a.u.s.text = text;
+	a.u.s.length += b.u.s.length;
+	return a;
+}
+
+/* arithmetics */
+static inline jf_value jf_overflow(void) { return jf_err("integer overflow, big integers need the VM"); }
+static inline jf_value jf_arith(int op, jf_value a, jf_value b) {
+	int64_t x, y, r;
+	uint64_t ux, uy, m;
+	if (a.type != JF_INTEGER || b.type != JF_INTEGER)
+		return jf_err("invalid operands, integers expected");
+	x = a.u.integer, y = b.u.integer;
+	ux = (uint64_t)x, uy = (uint64_t)y;
+	switch (op) {
+	case JF_RSHIFT: return jf_int(x >> (uy & 63));
+	case JF_LSHIFT: return jf_int((int64_t)(ux << (uy & 63)));
+	case JF_AND: return jf_int((int64_t)(ux & uy));
+	case JF_OR: return jf_int((int64_t)(ux | uy));
+	case JF_XOR: return jf_int((int64_t)(ux ^ uy));
+	case JF_ADD:
+		return (y > 0 ? x <= INT64_MAX - y : x >= INT64_MIN - y) ? jf_int(x + y) : jf_overflow();
+	case JF_SUB:
+		return (y < 0 ? x <= INT64_MAX + y : x >= INT64_MIN + y) ? jf_int(x - y) : jf_overflow();
+	case JF_MUL:
+		if (x == 0 || y == 0)
+			return jf_int(0);
+		ux = x < 0 ? 0 - ux : ux;
+		uy = y < 0 ? 0 - uy : uy;
+		if (ux > UINT64_MAX / uy)
+			return jf_overflow();
+		m = ux * uy;
+		if ((x < 0) != (y < 0))
+			return m <= (uint64_t)INT64_MAX + 1 ? jf_int((int64_t)(0 - m)) : jf_overflow();
+		return m <= (uint64_t)INT64_MAX ? jf_int((int64_t)m) : jf_overflow();
+	case JF_POW: {
+		uint64_t result = 1, base = x < 0 ? 0 - ux : ux;
+		int odd = (y & 1) != 0;
+		if (y <= 0)
+			return jf_int(1);
+		for (; y > 0; y--) {
+			if (base > 1 && result > (uint64_t)INT64_MAX / base)
+				return jf_overflow();
+			result *= base;
+			if (base <= 1)
+				break;
+		}
+		return jf_int(x < 0 && odd ? -(int64_t)result : (int64_t)result);
+	}
+	default:
+		if (y == 0)
+			return jf_err("division by zero");
+		if (y == -1 && x == INT64_MIN)
+			return op == JF_DIV ? jf_overflow() : jf_int(0);
+		r = op == JF_DIV ? x / y : x % y;
+		return jf_int(r);
+	}
+}
+static inline jf_value jf_float(int op, long double x, long double y) {
+	switch (op) {
+	case JF_ADD: return jf_real(x + y);
+	case JF_SUB: return jf_real(x - y);
+	case JF_MUL: return jf_real(x * y);
+	case JF_DIV: return jf_real(x / y);
+	case JF_MOD: return jf_real(fmodl(x, y));
+	default: return jf_real(powl(x, y));
+	}
+}
+/* integers when both are, strings joined by addition, else numbers; an error operand is the result */
+static inline jf_value jf_operate(int op, jf_value a, jf_value b) {
+	if (a.type == JF_ERROR || b.type == JF_ERROR)
+		return a.type == JF_ERROR ? a : b;
+	if (jf_integral(a) && jf_integral(b))
+		return jf_arith(op, a, b);
+	if (op == JF_ADD && a.type == JF_STRING && b.type == JF_STRING)
+		return jf_concat(a, b);
+	if (jf_number(a) && jf_number(b))
+		return jf_float(op, jf_to_real(a), jf_to_real(b));
+	return jf_err("invalid operands, numbers expected");
+}
+/* element by element over sequences, a single value applies to every element */
+static inline jf_value jf_dynamic(int op, jf_value a, jf_value b) {
+	jf_seq s = { NULL, 0, 0 };
+	size_t n, i;
+	if (a.type != JF_SEQUENCE && b.type != JF_SEQUENCE)
+		return jf_operate(op, a, b);
+	if (a.type == JF_SEQUENCE && b.type == JF_SEQUENCE && a.u.seq.count != b.u.seq.count)
+		return jf_err("invalid operands, sequences of equal length expected");
+	n = a.type == JF_SEQUENCE ? a.u.seq.count : b.u.seq.count;
+	for (i = 0; i < n; i++)
+		jf_push(&s, jf_operate(op, a.type == JF_SEQUENCE ? a.u.seq.items[i] : a, b.type == JF_SEQUENCE ? b.u.seq.items[i] : b));
+	return jf_pack(s, 1);
+}
+static inline jf_value jf_not(jf_value a) {
+	return a.type == JF_INTEGER ? jf_int((int64_t)~(uint64_t)a.u.integer) : jf_err("invalid operand, integer expected");
+}
+static inline jf_value jf_minus(jf_value a) {
+	if (a.type != JF_INTEGER)
+		return jf_err("invalid operand, integer expected");
+	return a.u.integer != INT64_MIN ? jf_int(-a.u.integer) : jf_overflow();
+}
+static inline jf_value jf_fminus(jf_value a) {
+	return jf_number(a) ? jf_real(-jf_to_real(a)) : jf_err("invalid operand, number expected");
+}
+)runtime",
+R"runtime(
+/* calls */
+static inline int jf_admit(const jf_table* t, const jf_value* args, jf_value* failure) {
+	static const char* expected[] = {
+		"invalid argument, Void expected", "invalid argument, Bool expected",
+		"invalid argument, Integer expected", "invalid argument, Real expected",
+		"invalid argument, String expected", "invalid argument, Error expected",
+		"invalid argument, Sequence expected", "invalid argument, Object expected",
+		"invalid argument, BigInteger expected",
+	};
+	size_t i;
+	for (i = 0; i < t->nspecs; i++) {
+		unsigned char spec = t->specs[i], type = args[i].type;
+		if (spec == JF_VOID || type == spec || (spec == JF_REAL && type == JF_INTEGER))
+			continue;
+		*failure = jf_err(expected[spec]);
+		return 0;
+	}
+	return 1;
+}
+/* a table and every table it tail calls */
+static inline void jf_run(struct jf_ctx* c, int t, const jf_value* args, size_t argc) {
+	while (t >= 0) {
+		t = c->tables[t].code(c, args, argc);
+		args = c->args;
+		argc = c->argc;
+	}
+}
+/* into a register, or appended to the output when into is null */
+static inline void jf_call(struct jf_ctx* c, int t, const jf_value* args, size_t argc, jf_value* into) {
+	jf_value failure;
+	jf_seq s;
+	size_t i;
+	if (!jf_admit(&c->tables[t], args, &failure)) {
+		jf_store(c, into, failure);
+		return;
+	}
+	if (c->frames >= JF_MAX_FRAMES) {
+		jf_store(c, into, jf_err("stack overflow"));
+		return;
+	}
+	c->frames++;
+	jf_begin(c);
+	jf_run(c, t, args, argc);
+	c->frames--;
+	if (into) {
+		*into = jf_end(c, 0);
+		return;
+	}
+	s = c->outputs[--c->depth];
+	for (i = 0; i < s.count; i++)
+		jf_emit(c, s.items[i]);
+	free(s.items);
+}
+/* arguments of a tail call, false when the table doesn't admit them */
+static inline int jf_tail(struct jf_ctx* c, int t, const jf_value* args, size_t argc) {
+	jf_value failure;
+	if (!jf_admit(&c->tables[t], args, &failure)) {
+		jf_emit(c, failure);
+		return 0;
+	}
+	memmove(c->args, args, argc * sizeof(jf_value));
+	c->argc = argc;
+	return 1;
+}
+
+/* output, as the jiffle command line prints it */
+static inline void jf_print(FILE* out, jf_value v) {
+	size_t i;
+	switch (v.type) {
+	case JF_VOID: fputs("null", out); break;
+	case JF_BOOL: fputs(v.u.boolean ? "true" : "false", out); break;
+	case JF_INTEGER: fprintf(out, "%lld", (long long)v.u.integer); break;
+	case JF_REAL: fprintf(out, "%g", (double)v.u.real); break;
+	case JF_STRING: fprintf(out, "'%.*s'", (int)v.u.s.length, v.u.s.text); break;
+	case JF_ERROR: fprintf(out, "`%.*s`", (int)v.u.s.length, v.u.s.text); break;
+	case JF_SEQUENCE:
+		fputc('(', out);
+		for (i = 0; i < v.u.seq.count; i++) {
+			if (i)
+				fputs(", ", out);
+			jf_print(out, v.u.seq.items[i]);
+		}
+		fputs(v.u.seq.count == 1 ? ",)" : ")", out);
+		break;
+	default: fputc('?', out); break;
+	}
+}
+
+/* runs the first table, prints its output one value per line */
+static inline int jf_main(const jf_table* tables) {
+	static jf_ctx c;
+	size_t i;
+	c.tables = tables;
+	c.frames = 1;
+	jf_begin(&c);
+	jf_run(&c, 0, NULL, 0);
+	for (i = 0; i < c.outputs[0].count; i++) {
+		jf_print(stdout, c.outputs[0].items[i]);
+		fputc('\n', stdout);
+	}
+	return 0;
+}
+
+#endif
+)runtime",
+		};
+
+		const std::string& runtime() {
+			static const std::string text = [] {
+				std::string out;
+				for (auto piece : _pieces)
+					out += piece;
+				return out;
+			}();
+			return text;
+		}
+
+	}
+}
@@ -0,0 +1,269 @@
+#include "aot.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <set>
+
+namespace jiffle {
+	namespace aot {
+
+		bool translate(const std::vector<vm::table>& tables, std::string& source, std::vector<std::string>& unsupported) {
+			using namespace vm;
+
+			// internal state -------------------------------------------------
+			std::string _out;
+			std::set<std::string> _missing;
+
+			// methods --------------------------------------------------------
+
+			// stateless
+			auto nameOf = [](const table& t) {
+				auto name = t.symbol.empty() ? std::string("(root)") : t.symbol;
+				for (size_t at; (at = name.find("*/")) != std::string::npos;)
+					name.replace(at, 2, "* /");
+				return name;
+			};
+			auto quoted = [](const std::string& text) {
+				// octal escapes, never read on into the next character
+				std::string out = "\"";
+				char escape[8];
+				for (unsigned char ch : text) {
+					if (ch == '"' || ch == '\\' || ch == '?' || ch < 0x20 || ch >= 0x7f) {
+						snprintf(escape, sizeof(escape), "\\%03o", ch);
+						out += escape;
+					}
+					else
+						out += (char)ch;
+				}
+				return out + "\"";
+			};
+			auto registers = [](const table& t) {
+				auto n = t.registers > t.parameters ? t.registers : t.parameters;
+				return n ? n : 1;
+			};
+
+			// statefull
+			auto constant = [&](const table& t, const value& v) {
+				char text[64];
+				switch (v.type) {
+				case data::Void: return std::string("{ JF_VOID, { 0 } }");
+				case data::Bool: return std::string(v.boolean ? "{ JF_BOOL, { 1 } }" : "{ JF_BOOL, { 0 } }");
+				case data::Integer:
+					if (v.integer == INT64_MIN)
+						return std::string("{ JF_INTEGER, { .integer = INT64_MIN } }");
+					snprintf(text, sizeof(text), "INT64_C(%lld)", (long long)v.integer);
+					return "{ JF_INTEGER, { .integer = " + std::string(text) + " } }";
+				case data::Real: {
+					auto r = (long double)v.real;
+					std::string literal;
+					if (std::isnan(r))
+						literal = "NAN";
+					else if (std::isinf(r))
+						literal = r < 0 ? "-HUGE_VALL" : "HUGE_VALL";
+					else {
+						snprintf(text, sizeof(text), "%.21Lg", r);
+						literal = text;
+						if (literal.find_first_of(".e") == std::string::npos)
+							literal += ".0";
+						literal += "L";
+					}
+					return "{ JF_REAL, { .real = " + literal + " } }";
+				}
+				case data::String:
+				case data::Error: {
+					auto s = v.text.str();
+					return std::string(v.type == data::String ? "{ JF_STRING" : "{ JF_ERROR")
+						+ ", { .s = { " + quoted(s) + ", " + std::to_string(s.size()) + " } } }";
+				}
+				default:
+					_missing.insert(nameOf(t) + ": constant of type " + std::to_string(v.type));
+					return std::string("{ JF_VOID, { 0 } }");
+				}
+			};
+
+			// one function per table, returning the table it tail calls
+			auto function = [&](size_t index) {
+				auto& t = tables[index];
+				auto& code = t.start;
+				auto n = registers(t);
+				auto fn = "jf_t" + std::to_string(index);
+				auto reg = [&](unsigned char r) {
+					return r < n ? "r[" + std::to_string(r) + "]" : std::string("jf_none");
+				};
+				auto store = [&](unsigned char r, const std::string& expr) {
+					if (r == Output)
+						return "jf_emit(c, " + expr + ");";
+					if (r < n)
+						return "r[" + std::to_string(r) + "] = " + expr + ";";
+					return "(void)" + expr + ";";
+				};
+				auto target = [&](size_t pc) {
+					return pc < code.size() ? pc : code.size();
+				};
+
+				// constants as static data, jump targets as labels
+				std::map<size_t, size_t> constants;
+				std::string pool;
+				std::set<size_t> labels;
+				auto self = false;
+				for (size_t i = 0; i < code.size(); i++) {
+					auto& in = code[i];
+					switch (in.opcode) {
+					case SET:
+						if (!constants.count(in.addr.index)) {
+							constants.emplace(in.addr.index, constants.size());
+							pool += "\t" + constant(t, decode(t, in.addr.index)) + ",\n";
+						}
+						break;
+					case JUMP:
+						labels.insert(target(in.addr.index));
+						break;
+					case SWITCH: {
+						data::type_info info;
+						memcpy(&info, &t.memory[in.addr.index], sizeof(info));
+						for (size_t k = 0; k < info.bytelen / sizeof(uint32_t); k++) {
+							uint32_t pc;
+							memcpy(&pc, &t.memory[in.addr.index + sizeof(info) + k * sizeof(uint32_t)], sizeof(pc));
+							labels.insert(target(pc));
+						}
+						break;
+					}
+					case IFZ: case IFNZ: case IFL: case IFLE: case IFG: case IFGE:
+						labels.insert(target(i + 2));
+						break;
+					case TAILCALL:
+						self = self || in.addr.table == index;
+						break;
+					case LOAD: case STORE: case FENCE: case CAS: case OBJECT: case MEMBER: case EXTEND:
+					case CLOSE: case APPLY: case RECEIVE:
+						_missing.insert(nameOf(t) + ": " + name(in.opcode));
+						break;
+					default:
+						break;
+					}
+				}
+
+				_out += "/* " + nameOf(t) + " */\n";
+				if (!pool.empty())
+					_out += "static const jf_value " + fn + "_k[] = {\n" + pool + "};\n";
+				_out += "static int " + fn + "(jf_ctx* c, const jf_value* args, size_t argc) {\n";
+				_out += "\tjf_value r[" + std::to_string(n) + "];\n\tsize_t i;\n";
+				_out += "\tfor (i = 0; i < " + std::to_string(n) + "; i++)\n\t\tr[i] = i < argc ? args[i] : jf_none;\n";
+				if (self)
+					_out += "start:\n";
+
+				static const char* arith[] = { "JF_ADD", "JF_SUB", "JF_MUL", "JF_DIV", "JF_MOD", "JF_POW" };
+				static const char* bitwise[] = { "JF_RSHIFT", "JF_LSHIFT", "JF_AND", "JF_OR", "", "JF_XOR" };
+				static const char* sign[] = { "==", "!=", "<", "<=", ">", ">=" };
+				for (size_t i = 0; i <= code.size(); i++) {
+					if (labels.count(i))
+						_out += "L" + std::to_string(i) + ":\n";
+					if (i == code.size())
+						break;
+					auto& in = code[i];
+					auto a = reg(in.a), b = reg(in.b);
+					std::string line;
+					switch (in.opcode) {
+					case SET: line = store(in.reg, fn + "_k[" + std::to_string(constants[in.addr.index]) + "]"); break;
+					case MOVE: line = store(in.reg, a); break;
+					case EMIT: line = "jf_emit(c, " + a + ");"; break;
+					case BEGIN: line = "jf_begin(c);"; break;
+					case END: line = store(in.reg, std::string("jf_end(c, ") + (in.b ? "1" : "0") + ")"); break;
+					case TYPE: line = store(in.reg, "jf_int(" + a + ".type)"); break;
+					case COUNT: line = store(in.reg, "jf_int((int64_t)jf_size(" + a + "))"); break;
+					case ITEM: line = store(in.reg, "jf_item(" + a + ", " + std::to_string(in.addr.index) + ", " + (in.b ? "1" : "0") + ")"); break;
+					case SLICE: line = store(in.reg, "jf_slice(" + a + ", " + std::to_string(in.addr.index) + ", " + std::to_string(in.b) + ")"); break;
+					case CONCAT: line = store(in.reg, "jf_concat(" + a + ", " + b + ")"); break;
+					case JUMP: line = "goto L" + std::to_string(target(in.addr.index)) + ";"; break;
+					case SWITCH: {
+						data::type_info info;
+						memcpy(&info, &t.memory[in.addr.index], sizeof(info));
+						auto count = info.bytelen / sizeof(uint32_t);
+						line = "switch (jf_key(" + a + ", " + std::to_string(count) + ")) {";
+						for (size_t k = 0; k < count; k++) {
+							uint32_t pc;
+							memcpy(&pc, &t.memory[in.addr.index + sizeof(info) + k * sizeof(uint32_t)], sizeof(pc));
+							line += (k + 1 < count ? " case " + std::to_string(k) + ":" : std::string(" default:"))
+								+ " goto L" + std::to_string(target(pc)) + ";";
+						}
+						line += " }";
+						break;
+					}
+					case CALL:
+						line = "jf_call(c, " + std::to_string(in.addr.table) + ", &r[" + std::to_string(in.a) + "], "
+							+ std::to_string(in.b) + ", " + (in.reg == Output ? std::string("NULL") : "&r[" + std::to_string(in.reg) + "]") + ");";
+						break;
+					case TAILCALL:
+						line = "if (jf_tail(c, " + std::to_string(in.addr.table) + ", &r[" + std::to_string(in.a) + "], " + std::to_string(in.b) + ")) ";
+						if (in.addr.table == index)
+							line += "{ for (i = 0; i < " + std::to_string(n) + "; i++) r[i] = i < c->argc ? c->args[i] : jf_none; goto start; }";
+						else
+							line += "return " + std::to_string(in.addr.table) + ";";
+						break;
+					case RETURN: line = "return -1;"; break;
+					case IFZ: case IFNZ: case IFL: case IFLE: case IFG: case IFGE:
+						line = "if (!(jf_sign(" + a + ") " + sign[in.opcode - IFZ] + " 0)) goto L" + std::to_string(target(i + 2)) + ";";
+						break;
+					case RSHIFT: case LSHIFT: case AND: case OR: case XOR:
+						line = store(in.reg, std::string("jf_arith(") + bitwise[in.opcode - RSHIFT] + ", " + a + ", " + b + ")");
+						break;
+					case NOT: line = store(in.reg, "jf_not(" + a + ")"); break;
+					case MINUS: line = store(in.reg, "jf_minus(" + a + ")"); break;
+					case ADD: case SUB: case MUL: case DIV: case MOD: case POW:
+						line = store(in.reg, std::string("jf_arith(") + arith[in.opcode - ADD] + ", " + a + ", " + b + ")");
+						break;
+					case FADD: case FSUB: case FMUL: case FDIV: case FMOD: case FPOW:
+						line = store(in.reg, std::string("jf_float(") + arith[in.opcode - FADD] + ", jf_to_real(" + a + "), jf_to_real(" + b + "))");
+						break;
+					case FMINUS: line = store(in.reg, "jf_fminus(" + a + ")"); break;
+					case DADD: case DSUB: case DMUL: case DDIV: case DMOD:
+						line = store(in.reg, std::string("jf_dynamic(") + arith[in.opcode - DADD] + ", " + a + ", " + b + ")");
+						break;
+					default:
+						line = "/* " + std::string(name(in.opcode)) + " */";
+						break;
+					}
+					_out += "\t" + line + "\n";
+				}
+				_out += "\treturn -1;\n}\n\n";
+			};
+
+			// entry ----------------------------------------------------------
+			_out += "/* generated by jiffle, build with: cc -O2 program.c -lm */\n";
+			_out += "#include \"jiffle_runtime.h\"\n\n";
+			for (size_t i = 0; i < tables.size(); i++)
+				function(i);
+
+			for (size_t i = 0; i < tables.size(); i++) {
+				auto& specs = tables[i].specifications;
+				if (specs.empty())
+					continue;
+				_out += "static const unsigned char jf_t" + std::to_string(i) + "_s[] = {";
+				for (size_t k = 0; k < specs.size(); k++)
+					_out += (k ? ", " : " ") + std::to_string(specs[k]);
+				_out += " };\n";
+			}
+			if (!tables.empty()) {
+				_out += "static const jf_table jf_tables[] = {\n";
+				for (size_t i = 0; i < tables.size(); i++) {
+					auto fn = "jf_t" + std::to_string(i);
+					auto& specs = tables[i].specifications;
+					_out += "\t{ " + fn + ", " + (specs.empty() ? std::string("NULL") : fn + "_s")
+						+ ", " + std::to_string(specs.size()) + " },\n";
+				}
+				_out += "};\n\nint main(void) {\n\treturn jf_main(jf_tables);\n}\n";
+			}
+			else
+				_out += "int main(void) {\n\treturn 0;\n}\n";
+
+			unsupported.assign(_missing.begin(), _missing.end());
+			if (!_missing.empty())
+				return false;
+			source = std::move(_out);
+			return true;
+		}
+
+	}
+}
@@ -0,0 +1,135 @@
+#include "aot.h"
+#include <assert.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <sstream>
+
+namespace jiffle {
+	namespace aot {
+
+		void translate_test() {
+			// internal state -------------------------------------------------
+			static const char* Source = "jiffle_aot_test.c";
+			static const char* Binary = "./jiffle_aot_test";
+
+			// methods --------------------------------------------------------
+			auto tables = [](const std::string& code) {
+				auto t = vm::generate(expr::parse(syntax::tokenize(code), code));
+				vm::link(t);
+				return t;
+			};
+			auto has = [](const std::string& text, const std::string& part) {
+				return text.find(part) != std::string::npos;
+			};
+			// output of the VM, printed as translated programs print it
+			std::function<std::string(const vm::value&)> print = [&](const vm::value& v) -> std::string {
+				switch (v.type) {
+				case data::Void: return "null";
+				case data::Bool: return v.boolean ? "true" : "false";
+				case data::Integer: return std::to_string(v.integer);
+				case data::Real: {
+					std::ostringstream out;
+					out << (double)v.real;
+					return out.str();
+				}
+				case data::String: return "'" + v.text.str() + "'";
+				case data::Error: return "`" + v.text.str() + "`";
+				case data::Sequence: {
+					std::string out = "(";
+					auto items = v.items.materialize();
+					for (size_t i = 0; i < items.size(); i++)
+						out += (i ? ", " : "") + print(items[i]);
+					return out + (items.size() == 1 ? ",)" : ")");
+				}
+				default: return "?";
+				}
+			};
+			auto interpreted = [&](const std::string& code) {
+				auto t = tables(code);
+				std::string out;
+				if (!t.empty())
+					for (auto& v : vm::execute(t))
+						out += print(v) + "\n";
+				return out;
+			};
+			auto compiled = [&](const std::string& code) {
+				std::string source, out;
+				std::vector<std::string> unsupported;
+				assert(translate(tables(code), source, unsupported));
+				std::ofstream(Source, std::ios::binary) << source;
+				std::ofstream("jiffle_runtime.h", std::ios::binary) << runtime();
+				auto built = system((std::string("cc -std=c99 -O1 -o ") + Binary + " " + Source + " -lm").c_str());
+				assert(built == 0);
+#ifndef _WIN32
+				auto pipe = popen(Binary, "r");
+				char buffer[256];
+				for (size_t n; pipe && (n = fread(buffer, 1, sizeof(buffer), pipe)) > 0;)
+					out.append(buffer, n);
+				if (pipe)
+					pclose(pipe);
+#endif
+				return out;
+			};
+
+			// tests ----------------------------------------------------------
+
+			{ // structure of the translation
+				std::string source;
+				std::vector<std::string> unsupported;
+				assert(translate(tables("kind [x:Integer] = 'int'\nkind [x] = 'other'\nkind 1, kind 'a\"?'"), source, unsupported));
+				assert(unsupported.empty());
+				assert(has(source, "#include \"jiffle_runtime.h\""));
+				assert(has(source, "static const jf_value jf_t0_k[] = {"));
+				assert(has(source, "{ JF_STRING, { .s = { \"a\\042\\077\", 3 } } }"));
+				assert(has(source, "static const jf_table jf_tables[] = {"));
+				assert(has(source, "return jf_main(jf_tables);"));
+
+				assert(translate({}, source, unsupported) && has(source, "return 0;"));
+				assert(has(runtime(), "#ifndef JIFFLE_RUNTIME_H") && has(runtime(), "static inline int jf_main("));
+			}
+			{ // closures and shared state stay in the VM
+				std::string source = "untouched";
+				std::vector<std::string> unsupported;
+				assert(!translate(tables("add [a] [b] = a + b\napp [f] [x] = f x\napp (add 1) 2"), source, unsupported));
+				assert(source == "untouched");
+				assert(std::find(unsupported.begin(), unsupported.end(), "(root): CLOSE") != unsupported.end());
+				assert(std::find(unsupported.begin(), unsupported.end(), "app: APPLY") != unsupported.end());
+
+				assert(!translate(tables("123456789012345678901234567890"), source, unsupported));
+				assert(unsupported.size() == 1 && has(unsupported[0], "constant of type"));
+			}
+#ifndef _WIN32
+			// translated programs print what the VM does, when a C compiler is around
+			if (system("cc --version >/dev/null 2>&1") == 0) {
+				std::string items = "0";
+				for (int i = 1; i < 300; i++)
+					items += "," + std::to_string(i);
+				const std::string programs[] = {
+					"3, 'hi', 1.5, true, null\n0x11 0b11 0o11\n(1, 2), (3), (4,), ()",
+					"three = 3\nident [x] = x\nthree\nident 'hi'\nadd [a] [b] { b, a }\nadd 3 8",
+					"kind [x:Integer] = 'int'\nkind [x:String|Bool] = 'text'\nkind [x] = 'other'\n"
+						"kind 1, kind 'a', kind true, kind 1.5\npick [x:Integer|Real] = x\npick 'a'",
+					"square [x:Integer] = x * x\nsquare 7\nsquare (1 + 2)\nsquare 1.5\nhalf [x:Real] = x / 2\nhalf 3",
+					"inc [x] = x + 1\ninc 2, inc 2.5, inc 'a'\n7 / 0\n(7 % 4) - 1\n1.5 - 3, 0 - 7",
+					"head [a,b..] = a\ntail [a..,b] = b\nrest [a,b..] = b\nhead (1, 2, 3)\ntail (1, 2, 3)\nrest (1, 2, 3)\nrest (1, 2)\nhead 7",
+					"join [a:String] [b:String] = a + b\njoin 'ab' 'cd'\n('a' + 'b') + 'c'",
+					"count [n] [a,b..] = count (n + a) b\ncount [n] [r] = n + r\ncount 0 (" + items + ")",
+					"f { 1 \n g } \n g { 2, 3 } \n f\nouter { inner = 5 \n inner }\nouter",
+					"add [a] [b] = a + b\nadd (1, 2) (3, 4)\nadd (1.5, 'a') 1\nadd (1, 2) (1,)",
+					"(7 / 0) + 1\n(7 % 0) - 2\nf [x:Integer] = (x / 0) + 5\nf 3",
+				};
+				for (auto& code : programs)
+					assert(compiled(code) == interpreted(code));
+
+				remove(Source);
+				remove(Binary + 2);
+				remove("jiffle_runtime.h");
+			}
+#endif
+		}
+
+	}
+}
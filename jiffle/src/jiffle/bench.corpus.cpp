@@ -0,0 +1,178 @@
+#include "bench.h"
+
+#include <functional>
+
+namespace jiffle {
+	namespace bench {
+
+		std::string corpus(size_t bytes, uint64_t seed) {
+			// internal state -------------------------------------------------
+			struct definition {
+				std::string name;
+				size_t parameters;
+			};
+			static const char* _words[] = {
+				"alpha", "beta", "gamma", "delta", "value", "count", "index", "total",
+				"left", "right", "node", "tree", "list", "item", "sum", "size",
+			};
+			static const size_t MaxDepth = 4;
+			std::string _out;
+			std::vector<definition> _defined;	// callable from anywhere after
+			uint64_t _state = seed ? seed : 1;
+			size_t _names = 0;
+
+			// methods --------------------------------------------------------
+
+			// xorshift, same sequence on every platform
+			// (draws are sequenced statements, never operands of one expression)
+			auto next = [&]() {
+				_state ^= _state << 13;
+				_state ^= _state >> 7;
+				_state ^= _state << 17;
+				return _state;
+			};
+			auto below = [&](size_t n) {
+				return (size_t)(next() % n);
+			};
+			auto word = [&]() {
+				return std::string(_words[below(sizeof(_words) / sizeof(_words[0]))]);
+			};
+			auto indent = [&](size_t depth) {
+				_out.append(depth, '\t');
+			};
+			auto literal = [&]() {
+				switch (below(10)) {
+				case 0: return std::string("null");
+				case 1: return std::string(below(2) ? "true" : "false");
+				case 2: return "0x" + std::to_string(below(0xffff));
+				case 3: return "0b" + std::string(below(2) ? "1011" : "110");
+				case 4: {
+					auto whole = std::to_string(below(1000));
+					return whole + "." + std::to_string(below(100));
+				}
+				case 5: {
+					auto mantissa = std::to_string(below(100));
+					return mantissa + "e-" + std::to_string(1 + below(20));
+				}
+				case 6: {
+					// long strings, a sentence up to a few hundred characters
+					std::string s = "'" + word();
+					for (size_t n = below(40); n > 0; n--)
+						s += " " + word();
+					return s + "'";
+				}
+				case 7: return "'" + word() + "'";
+				default: return std::to_string(below(1000000));
+				}
+			};
+			auto comment = [&](size_t depth) {
+				indent(depth);
+				_out += "# " + word();
+				for (size_t n = below(8); n > 0; n--)
+					_out += " " + word();
+				_out += "\n";
+			};
+
+			std::function<void(size_t, const std::vector<std::string>&)> statement;
+			std::function<void(size_t)> define;
+
+			// an argument or item, a parameter when there are any
+			auto operand = [&](const std::vector<std::string>& params) {
+				return !params.empty() && below(2) ? params[below(params.size())] : literal();
+			};
+
+			statement = [&](size_t depth, const std::vector<std::string>& params) {
+				indent(depth);
+				switch (below(6)) {
+				case 0: // arithmetic
+					_out += operand(params);
+					_out += " + ";
+					_out += operand(params);
+					break;
+				case 1: // sequence, maybe nested
+					_out += "(";
+					_out += operand(params);
+					for (size_t n = below(5); n > 0; n--) {
+						_out += ", ";
+						_out += operand(params);
+					}
+					if (depth < MaxDepth && below(3) == 0) {
+						_out += ", (";
+						_out += operand(params);
+						_out += ", ";
+						_out += operand(params);
+						_out += ")";
+					}
+					_out += ")";
+					break;
+				case 2:
+				case 3: { // call with matching arity
+					if (_defined.empty()) {
+						_out += operand(params);
+						break;
+					}
+					auto& d = _defined[below(_defined.size())];
+					_out += d.name;
+					for (size_t i = 0; i < d.parameters; i++) {
+						_out += " ";
+						_out += operand(params);
+					}
+					break;
+				}
+				default:
+					_out += operand(params);
+					break;
+				}
+				if (below(4) == 0)
+					_out += "\t# " + word();
+				_out += "\n";
+			};
+
+			// 'name [a] [b] { ... }' or 'name [a] = ...'
+			define = [&](size_t depth) {
+				definition d = { word() + std::to_string(++_names), below(4) };
+				std::vector<std::string> params;
+				indent(depth);
+				_out += d.name;
+				for (size_t i = 0; i < d.parameters; i++) {
+					params.push_back(std::string(1, (char)('a' + i)));
+					_out += " [" + params.back() + "]";
+				}
+				if (below(4) == 0) {
+					_out += " = ";
+					statement(0, params);
+				}
+				else {
+					_out += " {\n";
+					for (size_t n = 1 + below(6); n > 0; n--) {
+						auto kind = below(8);
+						if (kind == 0)
+							comment(depth + 1);
+						else if (kind == 1 && depth < MaxDepth)
+							define(depth + 1);
+						else
+							statement(depth + 1, params);
+					}
+					indent(depth);
+					_out += "}\n";
+				}
+				// nested definitions are private to their owner
+				if (depth == 0)
+					_defined.push_back(d);
+			};
+
+			// entry ----------------------------------------------------------
+			_out.reserve(bytes + 1024);
+			while (_out.size() < bytes) {
+				switch (below(8)) {
+				case 0: comment(0); break;
+				case 1: statement(0, {}); break;
+				case 2: _out += "\n"; break;
+				default: define(0); break;
+				}
+			}
+			return _out;
+		}
+
+	}
+}
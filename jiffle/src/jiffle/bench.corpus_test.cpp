@@ -0,0 +1,57 @@
+#include "bench.h"
+#include "expr.h"
+#include "syntax.h"
+#include "vm.h"
+#include <assert.h>
+#include <functional>
+
+namespace jiffle {
+	namespace bench {
+
+		void corpus_test() {
+			// methods --------------------------------------------------------
+			std::function<bool(const expr::node&)> valid = [&](const expr::node& n) {
+				if (n.type & expr::ERROR_BIT)
+					return false;
+				for (auto& i : n.items)
+					if (!valid(i))
+						return false;
+				return true;
+			};
+
+			// tests ----------------------------------------------------------
+
+			{ // deterministic, at least the requested size
+				auto a = corpus(64 * 1024, 7);
+				assert(a.size() >= 64 * 1024 && a.size() < 64 * 1024 + 4096);
+				assert(a == corpus(64 * 1024, 7));
+				assert(a != corpus(64 * 1024, 8));
+				assert(corpus(1000, 7) == a.substr(0, corpus(1000, 7).size()));
+			}
+			{ // well formed through every stage
+				auto source = corpus(256 * 1024, 3);
+				for (auto c : { "{", "[", "(", "#", "'", "0x", "." })
+					assert(source.find(c) != std::string::npos);
+				auto tokens = syntax::tokenize(source);
+				auto ast = expr::parse(tokens, source);
+				assert(valid(ast));
+				auto tables = vm::generate(ast);
+				assert(vm::link(tables).empty());
+			}
+			{ // measured stages
+				auto r = measure(corpus(16 * 1024), 2);
+				assert(r.bytes >= 16 * 1024 && r.runs == 2 && r.stages.size() == 3);
+				for (auto& s : r.stages)
+					assert(s.items > 0 && s.allocations > 0 && s.seconds >= 0);
+				assert(r.stages[1].items > r.stages[0].items / 2);
+
+				auto text = json(r);
+				assert(text.front() == '{' && text.back() == '}');
+				assert(text.find("\"name\":\"tokenize\"") != std::string::npos);
+				assert(text.find("\"tokens_per_sec\":") != std::string::npos);
+				assert(text.find("\"mb_per_sec\":") != std::string::npos);
+			}
+		}
+
+	}
+}
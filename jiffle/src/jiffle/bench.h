@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace jiffle {
+	namespace bench {
+
+		// corpus -------------------------------------------------------------
+
+		// Deterministic Jiffle source of at least bytes size, the same seed
+		// always gives the same source. Written like hand written code:
+		// definitions with parameters nested in '{}', calls with matching
+		// arity, '()' sequences, comments, literals of every kind and long
+		// strings. Well formed, so every stage runs its common path.
+		std::string corpus(size_t bytes, uint64_t seed = 1);
+
+		// measurements -------------------------------------------------------
+
+		// one front-end stage, items are its output units
+		struct stage {
+			std::string name;
+			std::string unit;		// tokens, nodes or instructions
+			double seconds;			// fastest run
+			size_t items;
+			size_t allocations;		// heap allocations of one run
+		};
+
+		struct report {
+			size_t bytes;			// source size
+			size_t runs;
+			std::vector<stage> stages;	// tokenize, parse, generate
+		};
+
+		// heap allocations made so far by every thread
+		size_t allocations();
+
+		// times each stage of a source separately, best of runs
+		report measure(const std::string& source, size_t runs = 5);
+
+		// report as a JSON object with rates (MB/s and items/s) per stage,
+		// one line so results of commits can be appended and compared
+		std::string json(const report& r);
+
+		// process usage ------------------------------------------------------
+
+		// resource counters of the process at a point in time
+		struct usage {
+			double wall;			// seconds, monotonic
+			double cpu;				// user and system seconds of every thread
+			size_t peak;			// peak resident set size so far, bytes
+			size_t allocations;		// heap allocations so far
+		};
+
+		// a named span of work, counters relative to its start
+		// (but peak, the high water mark at its end)
+		struct phase {
+			std::string name;
+			double wall;
+			double cpu;
+			size_t peak;
+			size_t allocations;
+		};
+
+		usage now();
+
+		// phase from a sample taken at its start to now
+		phase since(const std::string& name, const usage& start);
+
+		// phases as aligned columns, a total line last
+		std::string format(const std::vector<phase>& phases);
+
+		// tests --------------------------------------------------------------
+
+		void corpus_test();
+		void usage_test();
+
+	}
+}
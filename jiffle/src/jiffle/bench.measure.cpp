@@ -0,0 +1,92 @@
+#include "bench.h"
+#include "expr.h"
+#include "syntax.h"
+#include "vm.h"
+
+#include <chrono>
+#include <functional>
+#include <sstream>
+
+namespace jiffle {
+	namespace bench {
+
+		report measure(const std::string& source, size_t runs) {
+			// internal state -------------------------------------------------
+			report _report = { source.size(), runs ? runs : 1, {
+				{ "tokenize", "tokens", 0, 0, 0 },
+				{ "parse", "nodes", 0, 0, 0 },
+				{ "generate", "instructions", 0, 0, 0 },
+			} };
+
+			// methods --------------------------------------------------------
+
+			// stateless
+			std::function<size_t(const expr::node&)> nodes = [&](const expr::node& n) {
+				size_t count = 1;
+				for (auto& i : n.items)
+					count += nodes(i);
+				return count;
+			};
+			auto instructions = [](const std::vector<vm::table>& tables) {
+				size_t count = 0;
+				for (auto& t : tables)
+					count += t.start.size() + t.end.size();
+				return count;
+			};
+
+			// statefull
+			// runs a stage, keeping its fastest time and its allocations
+			auto time = [&](stage& s, bool first, const std::function<size_t()>& run) {
+				auto allocated = allocations();
+				auto start = std::chrono::steady_clock::now();
+				s.items = run();
+				std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+				s.allocations = allocations() - allocated;
+				if (first || elapsed.count() < s.seconds)
+					s.seconds = elapsed.count();
+			};
+
+			// entry ----------------------------------------------------------
+			for (size_t i = 0; i < _report.runs; i++) {
+				std::vector<syntax::token> tokens;
+				expr::node ast;
+				std::vector<vm::table> tables;
+				time(_report.stages[0], i == 0, [&]() {
+					tokens = syntax::tokenize(source);
+					return tokens.size();
+				});
+				time(_report.stages[1], i == 0, [&]() {
+					ast = expr::parse(tokens, source);
+					return nodes(ast);
+				});
+				time(_report.stages[2], i == 0, [&]() {
+					tables = vm::generate(ast);
+					return instructions(tables);
+				});
+			}
+			return _report;
+		}
+
+		std::string json(const report& r) {
+			std::ostringstream out;
+			auto rate = [](double amount, double seconds) {
+				return seconds > 0 ? amount / seconds : 0.0;
+			};
+			out << "{\"bytes\":" << r.bytes << ",\"runs\":" << r.runs << ",\"stages\":[";
+			for (size_t i = 0; i < r.stages.size(); i++) {
+				auto& s = r.stages[i];
+				out << (i ? "," : "")
+					<< "{\"name\":\"" << s.name << "\""
+					<< ",\"seconds\":" << s.seconds
+					<< ",\"mb_per_sec\":" << rate(r.bytes / 1e6, s.seconds)
+					<< ",\"" << s.unit << "\":" << s.items
+					<< ",\"" << s.unit << "_per_sec\":" << rate((double)s.items, s.seconds)
+					<< ",\"allocations\":" << s.allocations
+					<< "}";
+			}
+			out << "]}";
+			return out.str();
+		}
+
+	}
+}
@@ -0,0 +1,74 @@
+#include "bench.h"
+
+#include <chrono>
+#include <cstdio>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace jiffle {
+	namespace bench {
+
+		usage now() {
+			usage u = {};
+			u.wall = std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+			u.allocations = allocations();
+#ifdef _WIN32
+			FILETIME created, exited, kernel, user;
+			if (GetProcessTimes(GetCurrentProcess(), &created, &exited, &kernel, &user)) {
+				auto seconds = [](const FILETIME& t) {
+					return (((uint64_t)t.dwHighDateTime << 32) | t.dwLowDateTime) * 1e-7; // 100ns ticks
+				};
+				u.cpu = seconds(kernel) + seconds(user);
+			}
+			PROCESS_MEMORY_COUNTERS memory;
+			if (GetProcessMemoryInfo(GetCurrentProcess(), &memory, sizeof(memory)))
+				u.peak = memory.PeakWorkingSetSize;
+#else
+			rusage r;
+			if (getrusage(RUSAGE_SELF, &r) == 0) {
+				u.cpu = r.ru_utime.tv_sec + r.ru_utime.tv_usec * 1e-6
+					+ r.ru_stime.tv_sec + r.ru_stime.tv_usec * 1e-6;
+#ifdef __APPLE__
+				u.peak = (size_t)r.ru_maxrss;			// bytes
+#else
+				u.peak = (size_t)r.ru_maxrss * 1024;	// kilobytes
+#endif
+			}
+#endif
+			return u;
+		}
+
+		phase since(const std::string& name, const usage& start) {
+			auto end = now();
+			return phase{ name, end.wall - start.wall, end.cpu - start.cpu, end.peak, end.allocations - start.allocations };
+		}
+
+		std::string format(const std::vector<phase>& phases) {
+			std::string out;
+			char line[128];
+			auto row = [&](const std::string& name, double wall, double cpu, size_t peak, size_t allocations) {
+				snprintf(line, sizeof(line), "%-10s %10.3f %10.3f %10.1f %12zu\n",
+					name.c_str(), wall * 1e3, cpu * 1e3, peak / (1024.0 * 1024.0), allocations);
+				out += line;
+			};
+			snprintf(line, sizeof(line), "%-10s %10s %10s %10s %12s\n", "phase", "wall ms", "cpu ms", "peak MB", "allocations");
+			out += line;
+			phase total = { "total", 0, 0, 0, 0 };
+			for (auto& p : phases) {
+				row(p.name, p.wall, p.cpu, p.peak, p.allocations);
+				total.wall += p.wall;
+				total.cpu += p.cpu;
+				total.peak = p.peak > total.peak ? p.peak : total.peak;
+				total.allocations += p.allocations;
+			}
+			row(total.name, total.wall, total.cpu, total.peak, total.allocations);
+			return out;
+		}
+
+	}
+}
@@ -0,0 +1,34 @@
+#include "bench.h"
+#include <assert.h>
+#include <memory>
+
+namespace jiffle {
+	namespace bench {
+
+		void usage_test() {
+			// tests ----------------------------------------------------------
+
+			{ // counters only grow
+				auto a = now();
+				std::vector<std::unique_ptr<int>> held;
+				for (int i = 0; i < 1000; i++)
+					held.emplace_back(new int(i));
+				auto b = now();
+				assert(b.wall >= a.wall && b.cpu >= a.cpu && b.peak >= a.peak);
+				assert(b.allocations - a.allocations >= 1000);
+			}
+			{ // phases and their table
+				auto start = now();
+				std::vector<std::string> strings(100, std::string(100, 'x'));
+				std::vector<phase> phases = { since("first", start), since("second", now()) };
+				assert(phases[0].name == "first" && phases[0].allocations >= 100 && phases[0].wall >= 0);
+				assert(phases[1].peak >= phases[0].peak);
+
+				auto text = format(phases);
+				assert(text.find("allocations") != std::string::npos);
+				assert(text.find("first") < text.find("second") && text.find("second") < text.find("total"));
+			}
+		}
+
+	}
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "vm.h"
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace jiffle {
+	namespace build {
+
+		// interfaces ---------------------------------------------------------
+
+		// What a module shows other modules, and what it uses of them.
+		// Code generation of a module reads the declarations of every other
+		// module: their symbols, parameters, and the single evaluation of a
+		// short definition ('add3to = add 3' is called as 'add 3 ...').
+		// The hash covers exactly that, so a change to any other part of a
+		// module doesn't touch the modules depending on it.
+		struct interface {
+			std::vector<std::string> definitions;	// top-level names, sets that are extended too
+			std::vector<std::string> references;	// names used and not declared by the module
+			size_t hash;
+		};
+
+		interface scan(const expr::node& module);
+
+		// Modules each module depends on, those declaring a name it uses
+		// or declares itself (definitions and extensions of one set see
+		// each other). Sorted, never the module itself.
+		std::vector<std::vector<size_t>> dependencies(const std::vector<interface>& modules);
+
+		// projects -----------------------------------------------------------
+
+		// Incremental build of many modules into one program. Modules are
+		// tokenized, parsed, unfolded and generated on worker threads, each
+		// on its own, and linked last. A module inlines calls of its own
+		// definitions only. Between builds a module is parsed again
+		// when its content changed, and generated again when it was parsed
+		// again or an interface it depends on changed.
+		class project {
+		public:
+			struct counters {
+				size_t parsed;		// modules tokenized and parsed
+				size_t generated;	// modules generated
+				size_t kept;		// modules whose tables were current
+			};
+
+			// zero threads uses every hardware thread
+			explicit project(size_t threads = 0);
+
+			// sources as distinct paths and code, in order. The tables run as
+			// vm::generate of the modules in order would, once linked.
+			std::vector<vm::table> build(const std::vector<std::pair<std::string, std::string>>& sources,
+				std::vector<std::string>& unresolved);
+
+			const counters& stats() const { return _stats; }
+
+		private:
+			struct module {
+				size_t hash;
+				expr::node tree;
+				interface face;
+				std::vector<vm::table> tables;
+				std::vector<std::pair<std::string, size_t>> seen;	// dependencies and interface hashes when generated
+				bool current;	// tables generated
+			};
+
+			size_t _threads;
+			std::map<std::string, module> _modules;
+			counters _stats;
+		};
+
+		// tests --------------------------------------------------------------
+
+		void project_test();
+
+	}
+}
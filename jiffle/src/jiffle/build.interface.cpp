@@ -0,0 +1,137 @@
+#include "build.h"
+#include "text.h"
+
+#include <algorithm>
+#include <functional>
+#include <set>
+
+namespace jiffle {
+	namespace build {
+
+		interface scan(const expr::node& module) {
+			using namespace expr;
+
+			// internal state -------------------------------------------------
+			std::set<std::string> _definitions, _declared, _used;
+			std::string _shown;	// what other modules' code generation reads
+
+			// methods --------------------------------------------------------
+
+			// stateless
+			auto isDefinition = [](const node& n) {
+				if (n.type != Object)
+					return false;
+				for (auto& i : n.items)
+					if (i.type == Definition || i.type == DefinitionSequence)
+						return true;
+				return false;
+			};
+			auto isDeclaration = [&](const node& eval) {
+				return eval.items.size() == 1
+					&& isDefinition(eval.items.front())
+					&& !eval.items.front().text.empty();
+			};
+			// 'set' of '.set.member', 'x' of 'x:Integer' and 'x..'
+			auto headOf = [](const std::string& name) {
+				auto from = name.size() > 1 && name[0] == '.' ? 1 : 0;
+				return name.substr(from, name.find_first_of(".:", from) - from);
+			};
+			// structure and text, not positions
+			std::function<void(const node&)> show = [&](const node& n) {
+				_shown += (char)n.type;
+				_shown += n.text;
+				_shown += '(';
+				for (auto& i : n.items)
+					show(i);
+				_shown += ')';
+			};
+
+			// statefull
+			std::function<void(const node&)> uses = [&](const node& n) {
+				if (n.type == Object && n.items.empty() && !n.text.empty())
+					_used.insert(headOf(n.text));
+				for (auto& i : n.items)
+					uses(i);
+			};
+			std::function<void(const std::string&, const std::list<node>&)> declarations;
+			declarations = [&](const std::string& path, const std::list<node>& items) {
+				for (auto& eval : items) {
+					if (!isDeclaration(eval)) {
+						uses(eval);
+						continue;
+					}
+					auto& obj = eval.items.front();
+					auto symbol = path.empty() ? obj.text : path + "." + obj.text;
+					auto extension = obj.text.find('.', 1) != std::string::npos;
+					if (path.empty())
+						_definitions.insert(headOf(obj.text));
+					if (!extension)
+						_declared.insert(headOf(obj.text));
+					_shown += symbol + "\n";
+
+					// parameters, and the evaluation of a single evaluation body
+					const node* only = nullptr;
+					size_t evaluations = 0;
+					for (auto& d : obj.items) {
+						if (d.type == Parameter) {
+							show(d);
+							for (auto& p : d.items)
+								for (auto& item : p.items)
+									if (item.type == Object && item.items.empty())
+										_declared.insert(headOf(item.text));
+						}
+						else if (d.type == Definition || d.type == DefinitionSequence)
+							for (auto& e : d.items)
+								if (!isDeclaration(e) && !e.items.empty()) {
+									only = &e;
+									evaluations++;
+								}
+					}
+					if (only && evaluations == 1)
+						show(*only);
+					_shown += "\n";
+
+					for (auto& d : obj.items)
+						if (d.type == Definition || d.type == DefinitionSequence)
+							declarations(symbol, d.items);
+				}
+			};
+
+			// entry ----------------------------------------------------------
+			declarations("", module.items);
+			interface face;
+			face.definitions.assign(_definitions.begin(), _definitions.end());
+			std::set_difference(_used.begin(), _used.end(), _declared.begin(), _declared.end(),
+				std::back_inserter(face.references));
+			face.hash = text::hash(_shown.data(), _shown.size());
+			return face;
+		}
+
+		std::vector<std::vector<size_t>> dependencies(const std::vector<interface>& modules) {
+			std::map<std::string, std::vector<size_t>> declaring;
+			for (size_t i = 0; i < modules.size(); i++)
+				for (auto& name : modules[i].definitions)
+					declaring[name].push_back(i);
+
+			std::vector<std::vector<size_t>> out(modules.size());
+			for (size_t i = 0; i < modules.size(); i++) {
+				std::set<size_t> on;
+				auto depend = [&](const std::vector<std::string>& names) {
+					for (auto& name : names) {
+						auto it = declaring.find(name);
+						if (it == declaring.end())
+							continue;
+						for (auto j : it->second)
+							if (j != i)
+								on.insert(j);
+					}
+				};
+				depend(modules[i].references);
+				depend(modules[i].definitions);
+				out[i].assign(on.begin(), on.end());
+			}
+			return out;
+		}
+
+	}
+}
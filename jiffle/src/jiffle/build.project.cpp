@@ -0,0 +1,122 @@
+#include "build.h"
+#include "text.h"
+#include "trace.h"
+
+#include <atomic>
+#include <functional>
+#include <set>
+#include <thread>
+
+namespace jiffle {
+	namespace build {
+
+		// calls f for every index below n, on up to threads threads
+		static void parallel(size_t threads, size_t n, const std::function<void(size_t)>& f) {
+			std::atomic<size_t> next(0);
+			auto work = [&]() {
+				for (size_t i; (i = next.fetch_add(1)) < n;)
+					f(i);
+			};
+			std::vector<std::thread> workers;
+			for (size_t t = 1; t < threads && t < n; t++)
+				workers.emplace_back(work);
+			work();
+			for (auto& w : workers)
+				w.join();
+		}
+
+		// root table of a module, a symbol no name of the language spells
+		static std::string rootOf(const std::string& path) {
+			auto symbol = "@" + path;
+			for (auto& c : symbol)
+				if (c == '.' || c == '#')
+					c = ':';
+			return symbol;
+		}
+
+		project::project(size_t threads) : _stats() {
+			_threads = threads ? threads : std::thread::hardware_concurrency();
+			if (!_threads)
+				_threads = 1;
+		}
+
+		std::vector<vm::table> project::build(const std::vector<std::pair<std::string, std::string>>& sources,
+			std::vector<std::string>& unresolved) {
+			trace::scope span("build", "compile");
+
+			// modules of these sources only, changed ones parsed again
+			std::set<std::string> paths;
+			std::vector<module*> modules;
+			std::vector<size_t> changed;
+			for (auto& s : sources) {
+				paths.insert(s.first);
+				auto hash = text::hash(s.second.data(), s.second.size());
+				auto found = _modules.find(s.first);
+				if (found == _modules.end() || found->second.hash != hash) {
+					found = _modules.insert(std::make_pair(s.first, module())).first;
+					found->second.hash = hash;
+					found->second.current = false;
+					changed.push_back(modules.size());
+				}
+				modules.push_back(&found->second);
+			}
+			for (auto it = _modules.begin(); it != _modules.end();)
+				it = paths.count(it->first) ? std::next(it) : _modules.erase(it);
+
+			parallel(_threads, changed.size(), [&](size_t i) {
+				auto& code = sources[changed[i]].second;
+				auto& m = *modules[changed[i]];
+				m.tree = expr::parse(syntax::tokenize(code), code);
+				m.face = scan(m.tree);
+			});
+			_stats.parsed += changed.size();
+
+			// generated again when parsed again, or when what it sees
+			// of the modules it depends on changed
+			std::vector<interface> faces;
+			std::vector<const expr::node*> trees;
+			for (auto m : modules) {
+				faces.push_back(m->face);
+				trees.push_back(&m->tree);
+			}
+			auto graph = dependencies(faces);
+			std::vector<size_t> stale;
+			std::vector<std::vector<std::pair<std::string, size_t>>> seen(modules.size());
+			for (size_t i = 0; i < modules.size(); i++) {
+				for (auto j : graph[i])
+					seen[i].push_back({ sources[j].first, faces[j].hash });
+				if (!modules[i]->current || modules[i]->seen != seen[i])
+					stale.push_back(i);
+			}
+			parallel(_threads, stale.size(), [&](size_t i) {
+				auto& m = *modules[stale[i]];
+				// the module's own calls inlined, as unfold of the program would
+				expr::node unfolded;
+				vm::unfold(trees, stale[i], unfolded);
+				auto view = trees;
+				view[stale[i]] = &unfolded;
+				m.tables = vm::generate(view, stale[i], rootOf(sources[stale[i]].first));
+				m.seen = seen[stale[i]];
+				m.current = true;
+			});
+			_stats.generated += stale.size();
+			_stats.kept += modules.size() - stale.size();
+
+			// root calling module roots in order, then every table
+			std::vector<vm::table> tables;
+			auto empty = true;
+			for (auto m : modules)
+				empty = empty && m->tree.items.empty();
+			if (empty)
+				return tables;
+			tables.push_back(vm::table{ "", {}, {}, {}, 0, 0, false, {}, {}, {} });
+			for (auto& s : sources)
+				tables[0].start.push_back(vm::instruction{ vm::CALL, vm::Output, 0, 0, { rootOf(s.first), 0, 0 } });
+			for (auto m : modules)
+				tables.insert(tables.end(), m->tables.begin(), m->tables.end());
+			unresolved = vm::link(tables);
+			return tables;
+		}
+
+	}
+}
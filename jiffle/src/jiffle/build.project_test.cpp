@@ -0,0 +1,127 @@
+#include "build.h"
+#include <assert.h>
+#include <algorithm>
+
+namespace jiffle {
+	namespace build {
+
+		void project_test() {
+			typedef std::vector<std::pair<std::string, std::string>> sources;
+
+			// methods --------------------------------------------------------
+			auto parsed = [](const std::string& code) {
+				return expr::parse(syntax::tokenize(code), code);
+			};
+			auto has = [](const std::vector<std::string>& names, const std::string& name) {
+				return std::find(names.begin(), names.end(), name) != names.end();
+			};
+			auto integers = [](const std::vector<vm::value>& out) {
+				std::vector<data::integer_t> v;
+				for (auto& o : out)
+					v.push_back(o.type == data::Integer ? o.integer : -1);
+				return v;
+			};
+			// outputs of the same sources generated as one program
+			auto whole = [&](const sources& s) {
+				std::vector<expr::node> modules;
+				for (auto& m : s)
+					modules.push_back(parsed(m.second));
+				auto tables = vm::generate(modules);
+				vm::link(tables);
+				return tables.empty() ? std::vector<vm::value>() : vm::execute(tables);
+			};
+			auto run = [&](project& p, const sources& s) {
+				std::vector<std::string> unresolved;
+				auto tables = p.build(s, unresolved);
+				assert(unresolved.empty());
+				auto out = tables.empty() ? std::vector<vm::value>() : vm::execute(tables);
+				assert(integers(out) == integers(whole(s)));
+				return integers(out);
+			};
+
+			// tests ----------------------------------------------------------
+
+			{ // interfaces
+				auto face = scan(parsed("inc [x] = x + 1\nadd3 = add 3\ns.m [a] { inc a }\ninc 2\nf.g"));
+				assert(face.definitions == std::vector<std::string>({ "add3", "inc", "s" }));
+				assert(has(face.references, "add") && has(face.references, "f"));
+				assert(!has(face.references, "x") && !has(face.references, "a") && !has(face.references, "inc"));
+
+				// what others see changes the hash, the rest doesn't
+				auto a = scan(parsed("inc [x] = x + 1\n1, 2")).hash;
+				assert(scan(parsed("inc [x] = x + 1\n3")).hash == a);
+				assert(scan(parsed("inc [x] = x + 2\n1, 2")).hash != a);
+				assert(scan(parsed("inc [x] [y] = x + 1\n1, 2")).hash != a);
+				assert(scan(parsed("inc [x] { 1\n x + 1 }")).hash == scan(parsed("inc [x] { 2\n x + 1 }")).hash);
+
+				auto graph = dependencies({ scan(parsed("inc [x] = x + 1")), scan(parsed("inc 1")),
+					scan(parsed("s { .v = 1 }")), scan(parsed("s.w = 2")), scan(parsed("1")) });
+				assert(graph[0].empty() && graph[1] == std::vector<size_t>({ 0 }));
+				assert(graph[2] == std::vector<size_t>({ 3 }) && graph[3] == std::vector<size_t>({ 2 }));
+				assert(graph[4].empty());
+			}
+			{ // builds as one program, modules rebuilt only when needed
+				project p(2);
+				sources s = { { "lib", "add [a] [b] = a + b\nadd3 = add 3\n" }, { "main", "add3 4, add 1 2\n" } };
+				assert(run(p, s) == std::vector<data::integer_t>({ 7, 3 }));
+				assert(p.stats().parsed == 2 && p.stats().generated == 2);
+				run(p, s);
+				assert(p.stats().parsed == 2 && p.stats().kept == 2);
+
+				s[1].second = "add3 10\n";
+				assert(run(p, s) == std::vector<data::integer_t>({ 13 }));
+				assert(p.stats().parsed == 3 && p.stats().generated == 3 && p.stats().kept == 3);
+
+				// the library's own statements aren't part of its interface
+				s[0].second += "100\n";
+				assert(run(p, s) == std::vector<data::integer_t>({ 100, 13 }));
+				assert(p.stats().parsed == 4 && p.stats().generated == 4 && p.stats().kept == 4);
+
+				s[0].second = "add [a] [b] = a + b\nadd3 = add 30\n";
+				assert(run(p, s) == std::vector<data::integer_t>({ 40 }));
+				assert(p.stats().parsed == 5 && p.stats().generated == 6);
+			}
+			{ // sets extended by other modules, order of modules kept
+				project p(3);
+				sources s = {
+					{ "a.jfl", "counter { get = start \n .start = 5 }\n1" },
+					{ "b.jfl", "2\ncounter.start2 = 6\ncounter.get" },
+					{ "c.jfl", "f = { 3 }\nf" },
+				};
+				assert(run(p, s) == std::vector<data::integer_t>({ 1, 2, 5, 3 }));
+				s.erase(s.begin() + 1);
+				run(p, s);
+				assert(run(p, sources{ { "empty", "" } }).empty());
+			}
+			{ // modules inline their own definitions, not those of others
+				project p(2);
+				sources s = { { "lib", "inc [x] = x + 1\n" }, { "main", "sq [x] = x * x\nsq 3, inc 4\ng [x] = (x / 0) + 5\ng 3\n" } };
+				assert(run(p, s) == std::vector<data::integer_t>({ 9, 5, -1 }));
+				std::vector<std::string> unresolved;
+				size_t calls = 0;
+				for (auto& t : p.build(s, unresolved))
+					if (t.symbol == "@main")
+						for (auto& in : t.start)
+							calls += in.opcode == vm::CALL || in.opcode == vm::TAILCALL;
+				assert(calls == 1);
+			}
+			{ // many modules in parallel
+				project p(4);
+				sources s;
+				for (int i = 0; i < 40; i++) {
+					auto name = "m" + std::to_string(i);
+					auto code = "f" + std::to_string(i) + " [x] = x + " + std::to_string(i) + "\n";
+					if (i > 0)
+						code += "f" + std::to_string(i - 1) + " " + std::to_string(i) + "\n";
+					s.push_back({ name, code + "(" + std::to_string(i) + ", 'text')\n" });
+				}
+				run(p, s);
+				assert(p.stats().generated == 40);
+				s[20].second += "f20 1\n";
+				run(p, s);
+				assert(p.stats().generated == 41);
+			}
+		}
+
+	}
+}
@@ -22,14 +22,18 @@ namespace jiffle {
 			Real,
 			String,
 			Error,
+			Sequence,
+			Object,
+			BigInteger,
+			Closure,
 
 			Address,
 			Instruction,
 		};
 
 		struct type_info {
-			size_t type : 3;
-			size_t bytelen : 29;
+			size_t type : 4;
+			size_t bytelen : 28;
 		};
 		
 		// data values --------------------------------------------------------
@@ -3,6 +3,8 @@
 #include "syntax.h"
 
 #include <list>
+#include <unordered_map>
+#include <vector>
 
 namespace jiffle {
 	namespace expr {
@@ -51,14 +53,54 @@ namespace jiffle {
 			std::list<node> items;		// for structures
 		};
 
+		// identical subtrees share one id: nodes are interned bottom-up by their
+		// type, flags, text and the ids of their items, positions are ignored.
+		// interned nodes must outlive the pool and stay unchanged
+		class pool {
+		public:
+			static constexpr size_t npos = (size_t)-1;
+
+			// id of a tree, interning it and every subtree
+			size_t intern(const node& n);
+
+			// id of an interned node, npos when it wasn't interned
+			size_t id(const node& n) const;
+
+			// first node interned with an id
+			const node& representative(size_t id) const { return *_nodes[id]; }
+
+			// distinct subtrees, and nodes interned
+			size_t size() const { return _nodes.size(); }
+			size_t interned() const { return _ids.size(); }
+
+		private:
+			struct key {
+				const node* n;				// type, flags and text
+				std::vector<size_t> items;	// ids of items
+				bool operator==(const key& other) const;
+			};
+			struct hasher {
+				size_t operator()(const key& k) const;
+			};
+			size_t insert(const node& n);
+			std::unordered_map<key, size_t, hasher> _shapes;	// structure to id
+			std::unordered_map<const node*, size_t> _ids;		// interned node to id
+			std::vector<const node*> _nodes;					// id to representative
+		};
+
 		// functions ----------------------------------------------------------
 
 		// converts tokens to an expression tree
 		node parse(const std::vector<syntax::token>& tokens, const std::string& code);
 
+		// structural hash and equality, positions are ignored
+		size_t hash(const node& n);
+		bool equal(const node& a, const node& b);
+
 		// tests --------------------------------------------------------------
 
 		void parse_test();
+		void pool_test();
 
 	}
 }
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "expr.h"
+#include "trace.h"
 
 #include <stack>
 
@@ -7,6 +8,7 @@ namespace jiffle {
 
 		node parse(const std::vector<syntax::token> & tokens, const std::string & code) {
 			using namespace syntax;
+			trace::scope span("parse", "compile");
 
 			// internal state -------------------------------------------------
 			node _module = { Module }, *_node = &_module;
@@ -0,0 +1,87 @@
+#include "expr.h"
+#include "text.h"
+
+namespace jiffle {
+	namespace expr {
+
+		// node fields that aren't its items, continued from seed
+		static size_t shallow(const node& n, size_t seed) {
+			unsigned char head[] = { n.type, n.flags };
+			seed = text::hash((const char*)head, sizeof(head), seed);
+			return text::hash(n.text.data(), n.text.size(), seed);
+		}
+
+		size_t hash(const node& n) {
+			auto h = shallow(n, 14695981039346656037ull);
+			for (auto& item : n.items) {
+				auto sub = hash(item);
+				h = text::hash((const char*)&sub, sizeof(sub), h);
+			}
+			return h;
+		}
+
+		bool equal(const node& a, const node& b) {
+			if (a.type != b.type || a.flags != b.flags || a.text != b.text || a.items.size() != b.items.size())
+				return false;
+			for (auto i = a.items.begin(), j = b.items.begin(); i != a.items.end(); i++, j++)
+				if (!equal(*i, *j))
+					return false;
+			return true;
+		}
+
+		bool pool::key::operator==(const key& other) const {
+			return n->type == other.n->type && n->flags == other.n->flags
+				&& n->text == other.n->text && items == other.items;
+		}
+
+		size_t pool::hasher::operator()(const key& k) const {
+			auto h = shallow(*k.n, 14695981039346656037ull);
+			return k.items.empty() ? h : text::hash((const char*)k.items.data(), k.items.size() * sizeof(size_t), h);
+		}
+
+		// nodes of a tree
+		static size_t count(const node& n) {
+			size_t total = 1;
+			for (auto& item : n.items)
+				total += count(item);
+			return total;
+		}
+
+		size_t pool::intern(const node& n) {
+			auto known = _ids.find(&n);
+			if (known != _ids.end())
+				return known->second;
+
+			// room for every node up front, most trees repeat little
+			auto total = _ids.size() + count(n);
+			if (total > _ids.bucket_count() * _ids.max_load_factor()) {
+				_ids.reserve(total * 2);
+				_shapes.reserve(total * 2);
+			}
+			return insert(n);
+		}
+
+		size_t pool::insert(const node& n) {
+			auto known = _ids.find(&n);
+			if (known != _ids.end())
+				return known->second;
+
+			key k = { &n, {} };
+			k.items.reserve(n.items.size());
+			for (auto& item : n.items)
+				k.items.push_back(insert(item));
+
+			auto shape = _shapes.emplace(std::move(k), _nodes.size());
+			if (shape.second)
+				_nodes.push_back(&n);
+			_ids.emplace(&n, shape.first->second);
+			return shape.first->second;
+		}
+
+		size_t pool::id(const node& n) const {
+			auto it = _ids.find(&n);
+			return it == _ids.end() ? npos : it->second;
+		}
+
+	}
+}
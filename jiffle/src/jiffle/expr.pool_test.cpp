@@ -0,0 +1,51 @@
+#include "expr.h"
+#include <assert.h>
+#include <iterator>
+
+namespace jiffle {
+	namespace expr {
+
+		void pool_test() {
+			// methods --------------------------------------------------------
+			auto parsed = [](const std::string& code) {
+				return parse(syntax::tokenize(code), code);
+			};
+			auto nth = [](const node& n, size_t i) -> const node& {
+				auto it = n.items.begin();
+				std::advance(it, i);
+				return *it;
+			};
+
+			// tests ----------------------------------------------------------
+
+			{ // structure, not position
+				auto a = parsed("f (g 1) 'x'");
+				auto b = parsed("f  (g   1)\t'x'");
+				assert(equal(a, b) && hash(a) == hash(b));
+				assert(!equal(a, parsed("f (g 2) 'x'")));
+				assert(!equal(a, parsed("f (g 1) \"x\" 1")));
+				assert(!equal(parsed("(1)"), parsed("(1,)")));
+				assert(hash(parsed("(1)")) != hash(parsed("(1,)")));
+			}
+			{ // identical subtrees interned once
+				auto ast = parsed("f (g 1) (g 1)\nh (g 1), 1");
+				pool p;
+				auto root = p.intern(ast);
+				assert(p.intern(ast) == root && p.id(ast) == root);
+
+				auto& first = nth(ast, 0);
+				auto& second = nth(ast, 1);
+				auto a = p.id(nth(first, 1)), b = p.id(nth(first, 2)), c = p.id(nth(second, 1));
+				assert(a != pool::npos && a == b && b == c);
+				assert(&p.representative(a) == &nth(first, 1));
+				assert(p.id(nth(first, 0)) != p.id(nth(second, 0)));
+
+				// '1' inside every '(g 1)' and the last '1' share one id
+				assert(p.id(nth(nth(ast, 2), 0)) == p.id(nth(nth(nth(first, 1), 0), 1)));
+				assert(p.size() < p.interned());
+				assert(p.id(parsed("1")) == pool::npos);
+			}
+		}
+
+	}
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "data.h"
+
+#include <string>
+#include <vector>
+
+namespace jiffle {
+	namespace number {
+
+		// big integers -------------------------------------------------------
+
+		// Arbitrary precision integer, sign and magnitude.
+		// Limbs are base 2^32, least significant first, without leading zeros
+		// (zero has no limbs and is never negative).
+		struct integer {
+			bool negative;
+			std::vector<uint32_t> limbs;
+		};
+
+		// Multiplications from this many limbs split recursively (Karatsuba),
+		// smaller ones are schoolbook.
+		constexpr static size_t KaratsubaLimbs = 32;
+
+		// functions ----------------------------------------------------------
+
+		integer from(data::integer_t i);
+
+		// true when the value fits a 64 bit integer, stored into out
+		bool small(const integer& a, data::integer_t& out);
+
+		// digits in base 2, 8, 10 or 16 (optional leading '-'),
+		// power of two bases are packed directly into limbs
+		integer parse(const std::string& digits, int base);
+		std::string format(const integer& a, int base = 10);
+
+		// -1, 0, 1
+		int compare(const integer& a, const integer& b);
+
+		integer negate(const integer& a);
+		integer add(const integer& a, const integer& b);
+		integer sub(const integer& a, const integer& b);
+		integer mul(const integer& a, const integer& b);
+		integer pow(const integer& base, uint64_t exp);
+
+		// truncated division (like C++), divisor must not be zero
+		integer div(const integer& a, const integer& b, integer* remainder = nullptr);
+
+		data::real_t real(const integer& a);
+
+		// tests --------------------------------------------------------------
+
+		void integer_test();
+
+	}
+}
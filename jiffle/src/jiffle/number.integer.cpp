@@ -0,0 +1,338 @@
+#include "number.h"
+
+#include <algorithm>
+
+namespace jiffle {
+	namespace number {
+
+		typedef std::vector<uint32_t> limbs;
+
+		// magnitudes ---------------------------------------------------------
+
+		static void trim(limbs& a) {
+			while (!a.empty() && a.back() == 0)
+				a.pop_back();
+		}
+
+		static int compareMagnitude(const limbs& a, const limbs& b) {
+			if (a.size() != b.size())
+				return a.size() < b.size() ? -1 : 1;
+			for (size_t i = a.size(); i-- > 0;)
+				if (a[i] != b[i])
+					return a[i] < b[i] ? -1 : 1;
+			return 0;
+		}
+
+		static limbs addMagnitude(const limbs& a, const limbs& b) {
+			auto& longer = a.size() >= b.size() ? a : b;
+			auto& shorter = a.size() >= b.size() ? b : a;
+			limbs out(longer.size() + 1);
+			uint64_t carry = 0;
+			for (size_t i = 0; i < longer.size(); i++) {
+				carry += (uint64_t)longer[i] + (i < shorter.size() ? shorter[i] : 0);
+				out[i] = (uint32_t)carry;
+				carry >>= 32;
+			}
+			out[longer.size()] = (uint32_t)carry;
+			trim(out);
+			return out;
+		}
+
+		// a - b, a must not be smaller than b
+		static limbs subMagnitude(const limbs& a, const limbs& b) {
+			limbs out(a.size());
+			int64_t borrow = 0;
+			for (size_t i = 0; i < a.size(); i++) {
+				int64_t d = (int64_t)a[i] - (i < b.size() ? b[i] : 0) - borrow;
+				borrow = d < 0;
+				out[i] = (uint32_t)(d + (borrow << 32));
+			}
+			trim(out);
+			return out;
+		}
+
+		static limbs schoolbook(const limbs& a, const limbs& b) {
+			limbs out(a.size() + b.size());
+			for (size_t i = 0; i < a.size(); i++) {
+				uint64_t carry = 0;
+				for (size_t j = 0; j < b.size(); j++) {
+					carry += (uint64_t)a[i] * b[j] + out[i + j];
+					out[i + j] = (uint32_t)carry;
+					carry >>= 32;
+				}
+				out[i + b.size()] = (uint32_t)carry;
+			}
+			trim(out);
+			return out;
+		}
+
+		static limbs shifted(const limbs& a, size_t n) {
+			if (a.empty())
+				return a;
+			limbs out(n, 0);
+			out.insert(out.end(), a.begin(), a.end());
+			return out;
+		}
+
+		// a*b = z2*B^2m + ((a0+a1)(b0+b1) - z2 - z0)*B^m + z0
+		static limbs karatsuba(const limbs& a, const limbs& b) {
+			if (a.size() < KaratsubaLimbs || b.size() < KaratsubaLimbs)
+				return schoolbook(a, b);
+			auto m = std::max(a.size(), b.size()) / 2;
+			auto low = [m](const limbs& x) {
+				limbs out(x.begin(), x.begin() + std::min(m, x.size()));
+				trim(out);
+				return out;
+			};
+			auto high = [m](const limbs& x) {
+				return x.size() > m ? limbs(x.begin() + m, x.end()) : limbs();
+			};
+			auto a0 = low(a), a1 = high(a), b0 = low(b), b1 = high(b);
+			auto z0 = karatsuba(a0, b0);
+			auto z2 = karatsuba(a1, b1);
+			auto z1 = subMagnitude(subMagnitude(karatsuba(addMagnitude(a0, a1), addMagnitude(b0, b1)), z2), z0);
+			return addMagnitude(addMagnitude(shifted(z2, 2 * m), shifted(z1, m)), z0);
+		}
+
+		// a / d with single limb divisor, returns remainder
+		static uint32_t divSmall(limbs& a, uint32_t d) {
+			uint64_t r = 0;
+			for (size_t i = a.size(); i-- > 0;) {
+				auto cur = (r << 32) | a[i];
+				a[i] = (uint32_t)(cur / d);
+				r = cur % d;
+			}
+			trim(a);
+			return (uint32_t)r;
+		}
+
+		static void mulSmall(limbs& a, uint32_t m, uint32_t add) {
+			uint64_t carry = add;
+			for (auto& l : a) {
+				carry += (uint64_t)l * m;
+				l = (uint32_t)carry;
+				carry >>= 32;
+			}
+			if (carry)
+				a.push_back((uint32_t)carry);
+		}
+
+		// long division (Knuth D), b has at least two limbs
+		static limbs divMagnitude(const limbs& a, const limbs& b, limbs& remainder) {
+			// normalize so the top divisor limb has its high bit set
+			int s = 0;
+			while (!(b.back() << s & 0x80000000u))
+				s++;
+			auto shl = [s](const limbs& x, size_t extra) {
+				limbs out(x.size() + extra, 0);
+				for (size_t i = 0; i < x.size(); i++) {
+					out[i] |= x[i] << s;
+					if (s && i + 1 < out.size())
+						out[i + 1] |= (uint32_t)((uint64_t)x[i] >> (32 - s));
+				}
+				return out;
+			};
+			auto u = shl(a, 1), v = shl(b, 0);
+			trim(v);
+			auto n = v.size(), m = u.size() - n;
+			limbs q(m, 0);
+			for (size_t j = m; j-- > 0;) {
+				auto num = ((uint64_t)u[j + n] << 32) | u[j + n - 1];
+				auto qhat = num / v[n - 1], rhat = num % v[n - 1];
+				while (qhat > 0xFFFFFFFFull || qhat * v[n - 2] > ((rhat << 32) | u[j + n - 2])) {
+					qhat--;
+					rhat += v[n - 1];
+					if (rhat > 0xFFFFFFFFull)
+						break;
+				}
+				// u[j..j+n] -= qhat * v
+				int64_t borrow = 0;
+				uint64_t carry = 0;
+				for (size_t i = 0; i < n; i++) {
+					carry += qhat * v[i];
+					int64_t d = (int64_t)u[i + j] - (uint32_t)carry - borrow;
+					carry >>= 32;
+					borrow = d < 0;
+					u[i + j] = (uint32_t)(d + (borrow << 32));
+				}
+				int64_t d = (int64_t)u[j + n] - (int64_t)carry - borrow;
+				borrow = d < 0;
+				u[j + n] = (uint32_t)(d + (borrow << 32));
+				if (borrow) {
+					// added back, qhat was one too large
+					qhat--;
+					uint64_t c = 0;
+					for (size_t i = 0; i < n; i++) {
+						c += (uint64_t)u[i + j] + v[i];
+						u[i + j] = (uint32_t)c;
+						c >>= 32;
+					}
+					u[j + n] += (uint32_t)c;
+				}
+				q[j] = (uint32_t)qhat;
+			}
+			// unnormalize remainder
+			remainder.assign(n, 0);
+			for (size_t i = 0; i < n; i++)
+				remainder[i] = (u[i] >> s) | (s && i + 1 < u.size() ? (uint32_t)((uint64_t)u[i + 1] << (32 - s)) : 0);
+			trim(remainder);
+			trim(q);
+			return q;
+		}
+
+		static integer make(bool negative, limbs&& l) {
+			trim(l);
+			return integer{ negative && !l.empty(), std::move(l) };
+		}
+
+		// integers -----------------------------------------------------------
+
+		integer from(data::integer_t i) {
+			auto m = i < 0 ? 0 - (uint64_t)i : (uint64_t)i;
+			return make(i < 0, { (uint32_t)m, (uint32_t)(m >> 32) });
+		}
+
+		bool small(const integer& a, data::integer_t& out) {
+			if (a.limbs.size() > 2)
+				return false;
+			uint64_t m = 0;
+			for (size_t i = a.limbs.size(); i-- > 0;)
+				m = (m << 32) | a.limbs[i];
+			if (a.negative ? m > (uint64_t)1 << 63 : m >= (uint64_t)1 << 63)
+				return false;
+			out = a.negative ? (data::integer_t)(0 - m) : (data::integer_t)m;
+			return true;
+		}
+
+		integer parse(const std::string& digits, int base) {
+			auto negative = !digits.empty() && digits[0] == '-';
+			auto value = [](char c) {
+				return c >= '0' && c <= '9' ? c - '0'
+					: c >= 'a' && c <= 'f' ? c - 'a' + 10
+					: c >= 'A' && c <= 'F' ? c - 'A' + 10 : 0;
+			};
+			limbs out;
+			if (base == 2 || base == 8 || base == 16) {
+				// bits are packed from the last digit
+				auto bits = base == 2 ? 1 : base == 8 ? 3 : 4;
+				size_t pos = 0;
+				for (size_t i = digits.size(); i-- > (negative ? 1u : 0u);) {
+					auto d = (uint64_t)value(digits[i]);
+					if (pos / 32 + 1 >= out.size())
+						out.resize(pos / 32 + 2, 0);
+					out[pos / 32] |= (uint32_t)(d << (pos % 32));
+					if (pos % 32 + bits > 32)
+						out[pos / 32 + 1] |= (uint32_t)(d >> (32 - pos % 32));
+					pos += bits;
+				}
+				return make(negative, std::move(out));
+			}
+			// decimal, nine digits per limb multiplication
+			for (size_t i = negative ? 1 : 0; i < digits.size();) {
+				uint32_t chunk = 0, scale = 1;
+				for (size_t n = 0; n < 9 && i < digits.size(); n++, i++) {
+					chunk = chunk * 10 + value(digits[i]);
+					scale *= 10;
+				}
+				mulSmall(out, scale, chunk);
+			}
+			return make(negative, std::move(out));
+		}
+
+		std::string format(const integer& a, int base) {
+			if (a.limbs.empty())
+				return "0";
+			static const char* digits = "0123456789abcdef";
+			std::string out;
+			if (base == 2 || base == 8 || base == 16) {
+				auto bits = base == 2 ? 1 : base == 8 ? 3 : 4;
+				auto total = a.limbs.size() * 32;
+				for (size_t pos = 0; pos < total; pos += bits) {
+					uint64_t w = a.limbs[pos / 32];
+					if (pos / 32 + 1 < a.limbs.size())
+						w |= (uint64_t)a.limbs[pos / 32 + 1] << 32;
+					out.push_back(digits[(w >> (pos % 32)) & (base - 1)]);
+				}
+			}
+			else {
+				auto m = a.limbs;
+				while (!m.empty()) {
+					auto r = divSmall(m, 1000000000u);
+					for (int n = 0; n < 9; n++, r /= 10)
+						out.push_back(digits[r % 10]);
+				}
+			}
+			while (out.size() > 1 && out.back() == '0')
+				out.pop_back();
+			if (a.negative)
+				out.push_back('-');
+			std::reverse(out.begin(), out.end());
+			return out;
+		}
+
+		int compare(const integer& a, const integer& b) {
+			if (a.negative != b.negative)
+				return a.negative ? -1 : 1;
+			auto c = compareMagnitude(a.limbs, b.limbs);
+			return a.negative ? -c : c;
+		}
+
+		integer negate(const integer& a) {
+			return integer{ !a.negative && !a.limbs.empty(), a.limbs };
+		}
+
+		integer add(const integer& a, const integer& b) {
+			if (a.negative == b.negative)
+				return make(a.negative, addMagnitude(a.limbs, b.limbs));
+			if (compareMagnitude(a.limbs, b.limbs) >= 0)
+				return make(a.negative, subMagnitude(a.limbs, b.limbs));
+			return make(b.negative, subMagnitude(b.limbs, a.limbs));
+		}
+
+		integer sub(const integer& a, const integer& b) {
+			return add(a, negate(b));
+		}
+
+		integer mul(const integer& a, const integer& b) {
+			return make(a.negative != b.negative, karatsuba(a.limbs, b.limbs));
+		}
+
+		integer pow(const integer& base, uint64_t exp) {
+			auto result = from(1), b = base;
+			for (; exp > 0; exp >>= 1) {
+				if (exp & 1)
+					result = mul(result, b);
+				if (exp > 1)
+					b = mul(b, b);
+			}
+			return result;
+		}
+
+		integer div(const integer& a, const integer& b, integer* remainder) {
+			limbs q, r;
+			if (compareMagnitude(a.limbs, b.limbs) < 0) {
+				r = a.limbs;
+			}
+			else if (b.limbs.size() == 1) {
+				q = a.limbs;
+				auto rem = divSmall(q, b.limbs[0]);
+				if (rem)
+					r.push_back(rem);
+			}
+			else {
+				q = divMagnitude(a.limbs, b.limbs, r);
+			}
+			if (remainder)
+				*remainder = make(a.negative, std::move(r));
+			return make(a.negative != b.negative, std::move(q));
+		}
+
+		data::real_t real(const integer& a) {
+			data::real_t r = 0;
+			for (size_t i = a.limbs.size(); i-- > 0;)
+				r = r * 4294967296.0L + a.limbs[i];
+			return a.negative ? -r : r;
+		}
+
+	}
+}
@@ -0,0 +1,79 @@
+#include "number.h"
+#include <assert.h>
+
+namespace jiffle {
+	namespace number {
+
+		void integer_test() {
+			// internal state -------------------------------------------------
+			uint32_t _seed = 12345;
+
+			// methods --------------------------------------------------------
+			auto dec = [](const std::string& s) {
+				return parse(s, 10);
+			};
+			auto equal = [](const integer& a, const integer& b) {
+				return compare(a, b) == 0;
+			};
+			auto random = [&](size_t n) {
+				integer out = { false, {} };
+				for (size_t i = 0; i < n; i++) {
+					_seed = _seed * 1103515245 + 12345;
+					out.limbs.push_back(_seed ^ (_seed << 13));
+				}
+				while (!out.limbs.empty() && out.limbs.back() == 0)
+					out.limbs.pop_back();
+				return out;
+			};
+
+			// tests ----------------------------------------------------------
+
+			{ // small values
+				data::integer_t i;
+				assert(small(from(0), i) && i == 0);
+				assert(small(from(INT64_MIN), i) && i == INT64_MIN);
+				assert(small(from(INT64_MAX), i) && i == INT64_MAX);
+				assert(!small(add(from(INT64_MAX), from(1)), i));
+				assert(!small(sub(from(INT64_MIN), from(1)), i));
+				assert(from(0).limbs.empty() && !negate(from(0)).negative);
+			}
+			{ // base conversion
+				auto big = "340282366920938463463374607431768211456"; // 2^128
+				assert(format(dec(big)) == big);
+				assert(format(dec(big), 16) == "100000000000000000000000000000000");
+				assert(equal(parse("100000000000000000000000000000000", 16), dec(big)));
+				assert(equal(parse("1" + std::string(128, '0'), 2), dec(big)));
+				assert(format(parse("7777777777777777777777777", 8), 8) == "7777777777777777777777777");
+				assert(format(dec("-12345678901234567890123")) == "-12345678901234567890123");
+				assert(format(dec("000")) == "0");
+			}
+			{ // arithmetics
+				assert(format(pow(from(3), 100)) == "515377520732011331036461129765621272702107522001");
+				assert(format(mul(from(INT64_MIN), from(-1))) == "9223372036854775808");
+				assert(format(add(dec("-100000000000000000000"), dec("1"))) == "-99999999999999999999");
+				assert(format(sub(from(5), dec("100000000000000000000"))) == "-99999999999999999995");
+
+				integer r;
+				assert(format(div(dec("-100000000000000000007"), from(10), &r)) == "-10000000000000000000");
+				assert(format(r) == "-7");
+				assert(format(div(pow(from(10), 40), pow(from(10), 20), &r)) == "100000000000000000000");
+				assert(r.limbs.empty());
+			}
+			{ // karatsuba agrees with division
+				for (size_t n = KaratsubaLimbs - 1; n < KaratsubaLimbs * 5; n += 17) {
+					auto a = random(n), b = random(n + 3), c = random(n / 2 + 2);
+					auto p = mul(a, b);
+					integer r;
+					assert(equal(div(p, b, &r), a) && r.limbs.empty());
+					assert(equal(div(add(p, c), b, &r), a) && equal(r, c));
+					assert(equal(mul(a, add(b, c)), add(p, mul(a, c))));
+				}
+			}
+			{ // real
+				assert(real(pow(from(2), 70)) == 1180591620717411303424.0L);
+				assert(real(from(-3)) == -3);
+			}
+		}
+
+	}
+}
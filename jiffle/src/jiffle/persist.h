@@ -0,0 +1,409 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace jiffle {
+	namespace persist {
+
+		// Immutable data structures, every update returns a new version
+		// sharing all untouched nodes with the previous one.
+		// The past is never modified, old versions stay valid.
+
+		// vector -------------------------------------------------------------
+
+		// Sequence as a height balanced tree over chunks of elements.
+		// index, push_back, set, slice and concat are O(log n),
+		// copying only the chunk and path that changed.
+		template<typename T>
+		class vector {
+		public:
+			static constexpr size_t Chunk = 32;
+
+			vector() {}
+			vector(std::initializer_list<T> items) : vector(std::vector<T>(items)) {}
+			explicit vector(const std::vector<T>& items) {
+				// leaves, then pair up levels (balanced by construction)
+				std::vector<ptr> level;
+				for (size_t i = 0; i < items.size(); i += Chunk) {
+					auto end = i + Chunk < items.size() ? i + Chunk : items.size();
+					level.push_back(leaf(std::vector<T>(items.begin() + i, items.begin() + end)));
+				}
+				while (level.size() > 1) {
+					std::vector<ptr> up;
+					for (size_t i = 0; i + 1 < level.size(); i += 2)
+						up.push_back(inner(level[i], level[i + 1]));
+					if (level.size() % 2)
+						up.back() = join(up.back(), level.back());
+					level.swap(up);
+				}
+				if (!level.empty())
+					_root = level[0];
+			}
+
+			size_t size() const { return count(_root); }
+			bool empty() const { return !_root; }
+
+			const T& operator[](size_t i) const {
+				auto n = _root.get();
+				while (!n->leaf) {
+					auto left = count(n->left);
+					if (i < left) {
+						n = n->left.get();
+					} else {
+						i -= left;
+						n = n->right.get();
+					}
+				}
+				return n->items[i];
+			}
+
+			vector push_back(const T& v) const {
+				return vector(join(_root, leaf({ v })));
+			}
+
+			vector set(size_t i, const T& v) const {
+				return vector(update(_root, i, v));
+			}
+
+			// elements in [from, to)
+			vector slice(size_t from, size_t to) const {
+				auto head = split(_root, to).first;
+				return vector(split(head, from).second);
+			}
+
+			vector concat(const vector& other) const {
+				return vector(join(_root, other._root));
+			}
+
+			template<typename F>
+			void for_each(F f) const {
+				visit(_root, f);
+			}
+
+			std::vector<T> materialize() const {
+				std::vector<T> out;
+				out.reserve(size());
+				for_each([&](const T& v) { out.push_back(v); });
+				return out;
+			}
+
+			// tree height, for balance checks
+			size_t height() const { return depth(_root); }
+
+		private:
+			struct node;
+			typedef std::shared_ptr<const node> ptr;
+
+			struct node {
+				bool leaf;
+				unsigned char height;
+				size_t size;
+				ptr left, right;			// inner node
+				std::vector<T> items;		// leaf chunk
+			};
+
+			ptr _root;
+
+			explicit vector(ptr root) : _root(root) {}
+
+			static size_t count(const ptr& n) { return n ? n->size : 0; }
+			static size_t depth(const ptr& n) { return n ? n->height : 0; }
+
+			static ptr leaf(std::vector<T>&& items) {
+				if (items.empty())
+					return nullptr;
+				auto n = std::make_shared<node>();
+				n->leaf = true;
+				n->height = 1;
+				n->size = items.size();
+				n->items = std::move(items);
+				return n;
+			}
+
+			static ptr inner(const ptr& l, const ptr& r) {
+				auto n = std::make_shared<node>();
+				n->leaf = false;
+				n->height = (unsigned char)((depth(l) > depth(r) ? depth(l) : depth(r)) + 1);
+				n->size = count(l) + count(r);
+				n->left = l;
+				n->right = r;
+				return n;
+			}
+
+			// joins subtrees whose heights differ by at most 2
+			static ptr balance(const ptr& l, const ptr& r) {
+				if (depth(l) > depth(r) + 1) {
+					if (depth(l->left) >= depth(l->right))
+						return inner(l->left, inner(l->right, r));
+					return inner(inner(l->left, l->right->left), inner(l->right->right, r));
+				}
+				if (depth(r) > depth(l) + 1) {
+					if (depth(r->right) >= depth(r->left))
+						return inner(inner(l, r->left), r->right);
+					return inner(inner(l, r->left->left), inner(r->left->right, r->right));
+				}
+				return inner(l, r);
+			}
+
+			// concatenation, descends the spine of the taller tree
+			static ptr join(const ptr& l, const ptr& r) {
+				if (!l)
+					return r;
+				if (!r)
+					return l;
+				if (l->leaf && r->leaf && l->size + r->size <= Chunk) {
+					auto items = l->items;
+					items.insert(items.end(), r->items.begin(), r->items.end());
+					return leaf(std::move(items));
+				}
+				if (depth(l) > depth(r) + 1)
+					return balance(l->left, join(l->right, r));
+				if (depth(r) > depth(l) + 1)
+					return balance(join(l, r->left), r->right);
+				return inner(l, r);
+			}
+
+			// first i elements, and the rest
+			static std::pair<ptr, ptr> split(const ptr& n, size_t i) {
+				if (!n || i == 0)
+					return { nullptr, n };
+				if (i >= n->size)
+					return { n, nullptr };
+				if (n->leaf) {
+					return {
+						leaf(std::vector<T>(n->items.begin(), n->items.begin() + i)),
+						leaf(std::vector<T>(n->items.begin() + i, n->items.end()))
+					};
+				}
+				auto left = count(n->left);
+				if (i <= left) {
+					auto s = split(n->left, i);
+					return { s.first, join(s.second, n->right) };
+				}
+				auto s = split(n->right, i - left);
+				return { join(n->left, s.first), s.second };
+			}
+
+			static ptr update(const ptr& n, size_t i, const T& v) {
+				if (n->leaf) {
+					auto items = n->items;
+					items[i] = v;
+					return leaf(std::move(items));
+				}
+				auto left = count(n->left);
+				if (i < left)
+					return inner(update(n->left, i, v), n->right);
+				return inner(n->left, update(n->right, i - left, v));
+			}
+
+			template<typename F>
+			static void visit(const ptr& n, F& f) {
+				if (!n)
+					return;
+				if (n->leaf) {
+					for (auto& v : n->items)
+						f(v);
+					return;
+				}
+				visit(n->left, f);
+				visit(n->right, f);
+			}
+		};
+
+		// map ----------------------------------------------------------------
+
+		// Hash array mapped trie, 32-way nodes indexed by 5 bits of hash
+		// per level, children stored densely by population bitmap.
+		// find, set and erase are O(log32 n), copying only the path.
+		template<typename K, typename V, typename H = std::hash<K>>
+		class map {
+		public:
+			map() : _size(0) {}
+
+			size_t size() const { return _size; }
+			bool empty() const { return _size == 0; }
+
+			// value of key, null when missing
+			const V* find(const K& key) const {
+				auto h = H()(key);
+				auto n = _root.get();
+				for (size_t shift = 0; n; shift += Bits) {
+					if (shift >= HashBits) {
+						for (auto& e : n->entries)
+							if (e.key == key)
+								return &e.value;
+						return nullptr;
+					}
+					auto bit = (uint32_t)1 << ((h >> shift) & Mask);
+					if (!(n->bitmap & bit))
+						return nullptr;
+					auto& e = n->entries[index(n->bitmap, bit)];
+					if (!e.child)
+						return e.key == key ? &e.value : nullptr;
+					n = e.child.get();
+				}
+				return nullptr;
+			}
+
+			map set(const K& key, const V& value) const {
+				bool added = false;
+				auto root = insert(_root, H()(key), 0, key, value, added);
+				return map(root, _size + (added ? 1 : 0));
+			}
+
+			map erase(const K& key) const {
+				bool removed = false;
+				auto root = remove(_root, H()(key), 0, key, removed);
+				if (!removed)
+					return *this;
+				return map(root, _size - 1);
+			}
+
+			template<typename F>
+			void for_each(F f) const {
+				visit(_root, f);
+			}
+
+		private:
+			static constexpr size_t Bits = 5;
+			static constexpr size_t Mask = (1 << Bits) - 1;
+			static constexpr size_t HashBits = sizeof(size_t) * 8;
+
+			struct node;
+			typedef std::shared_ptr<const node> ptr;
+
+			struct entry {
+				ptr child;		// sub trie, or key/value when null
+				K key;
+				V value;
+			};
+
+			// collision nodes (hash exhausted) ignore bitmap
+			struct node {
+				uint32_t bitmap;
+				std::vector<entry> entries;
+			};
+
+			ptr _root;
+			size_t _size;
+
+			map(ptr root, size_t size) : _root(root), _size(size) {}
+
+			static size_t popcount(uint32_t v) {
+				v = v - ((v >> 1) & 0x55555555);
+				v = (v & 0x33333333) + ((v >> 2) & 0x33333333);
+				return (((v + (v >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24;
+			}
+
+			static size_t index(uint32_t bitmap, uint32_t bit) {
+				return popcount(bitmap & (bit - 1));
+			}
+
+			static ptr insert(const ptr& n, size_t h, size_t shift, const K& key, const V& value, bool& added) {
+				auto out = n ? std::make_shared<node>(*n) : std::make_shared<node>(node{ 0, {} });
+				if (shift >= HashBits) {
+					for (auto& e : out->entries) {
+						if (e.key == key) {
+							e.value = value;
+							return out;
+						}
+					}
+					out->entries.push_back({ nullptr, key, value });
+					added = true;
+					return out;
+				}
+				auto bit = (uint32_t)1 << ((h >> shift) & Mask);
+				auto i = index(out->bitmap, bit);
+				if (!(out->bitmap & bit)) {
+					out->bitmap |= bit;
+					out->entries.insert(out->entries.begin() + i, entry{ nullptr, key, value });
+					added = true;
+					return out;
+				}
+				auto& e = out->entries[i];
+				if (e.child) {
+					e.child = insert(e.child, h, shift + Bits, key, value, added);
+				}
+				else if (e.key == key) {
+					e.value = value;
+				}
+				else {
+					// push both leaves one level down
+					bool ignore = false;
+					auto sub = insert(nullptr, H()(e.key), shift + Bits, e.key, e.value, ignore);
+					e.child = insert(sub, h, shift + Bits, key, value, added);
+					e.key = K();
+					e.value = V();
+				}
+				return out;
+			}
+
+			static ptr remove(const ptr& n, size_t h, size_t shift, const K& key, bool& removed) {
+				if (!n)
+					return n;
+				if (shift >= HashBits) {
+					for (size_t i = 0; i < n->entries.size(); i++) {
+						if (n->entries[i].key == key) {
+							auto out = std::make_shared<node>(*n);
+							out->entries.erase(out->entries.begin() + i);
+							removed = true;
+							return out->entries.empty() ? nullptr : out;
+						}
+					}
+					return n;
+				}
+				auto bit = (uint32_t)1 << ((h >> shift) & Mask);
+				if (!(n->bitmap & bit))
+					return n;
+				auto i = index(n->bitmap, bit);
+				auto& e = n->entries[i];
+				ptr child;
+				if (e.child) {
+					child = remove(e.child, h, shift + Bits, key, removed);
+					if (!removed)
+						return n;
+				}
+				else if (e.key == key) {
+					removed = true;
+				}
+				else {
+					return n;
+				}
+				auto out = std::make_shared<node>(*n);
+				if (!child) {
+					out->bitmap &= ~bit;
+					out->entries.erase(out->entries.begin() + i);
+				}
+				else if (child->entries.size() == 1 && !child->entries[0].child) {
+					out->entries[i] = child->entries[0]; // pull single leaf up
+				}
+				else {
+					out->entries[i].child = child;
+				}
+				return out->entries.empty() ? nullptr : out;
+			}
+
+			template<typename F>
+			static void visit(const ptr& n, F& f) {
+				if (!n)
+					return;
+				for (auto& e : n->entries) {
+					if (e.child)
+						visit(e.child, f);
+					else
+						f(e.key, e.value);
+				}
+			}
+		};
+
+		// tests --------------------------------------------------------------
+
+		void vector_test();
+		void map_test();
+
+	}
+}
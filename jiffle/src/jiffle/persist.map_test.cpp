@@ -0,0 +1,85 @@
+#include "persist.h"
+#include <assert.h>
+#include <string>
+
+namespace jiffle {
+	namespace persist {
+
+		// every key collides, exercises collision nodes
+		struct collide {
+			size_t operator()(const std::string&) const { return 42; }
+		};
+
+		void map_test() {
+			// internal state -------------------------------------------------
+			map<std::string, int> _m;
+
+			// methods --------------------------------------------------------
+			auto key = [](int i) { return std::string("sym") + std::to_string(i); };
+			auto assert_value = [&](const map<std::string, int>& m, const std::string& k, int v) {
+				auto found = m.find(k);
+				assert(found && *found == v);
+			};
+			auto assert_missing = [&](const map<std::string, int>& m, const std::string& k) {
+				assert(m.find(k) == nullptr);
+			};
+
+			// tests ----------------------------------------------------------
+
+			// empty
+			assert(_m.empty());
+			assert_missing(_m, "foo");
+
+			// insert, every version remains valid
+			auto before = _m;
+			for (int i = 0; i < 2000; i++)
+				_m = _m.set(key(i), i);
+			assert(_m.size() == 2000);
+			for (int i = 0; i < 2000; i++)
+				assert_value(_m, key(i), i);
+			assert(before.empty());
+
+			// overwrite
+			auto changed = _m.set(key(7), -7);
+			assert(changed.size() == 2000);
+			assert_value(changed, key(7), -7);
+			assert_value(_m, key(7), 7);
+
+			// erase
+			auto erased = _m;
+			for (int i = 0; i < 2000; i += 2)
+				erased = erased.erase(key(i));
+			assert(erased.size() == 1000);
+			for (int i = 0; i < 2000; i++) {
+				if (i % 2)
+					assert_value(erased, key(i), i);
+				else
+					assert_missing(erased, key(i));
+			}
+			assert(erased.erase("missing").size() == 1000);
+			assert_value(_m, key(0), 0);
+
+			// iteration
+			size_t count = 0;
+			erased.for_each([&](const std::string& k, int v) {
+				assert(k == key(v));
+				count++;
+			});
+			assert(count == 1000);
+
+			// collisions
+			map<std::string, int, collide> c;
+			for (int i = 0; i < 10; i++)
+				c = c.set(key(i), i);
+			assert(c.size() == 10);
+			for (int i = 0; i < 10; i++)
+				assert(*c.find(key(i)) == i);
+			c = c.erase(key(3));
+			assert(c.size() == 9 && !c.find(key(3)) && *c.find(key(4)) == 4);
+			for (int i = 0; i < 10; i++)
+				c = c.erase(key(i));
+			assert(c.empty() && !c.find(key(0)));
+		}
+
+	}
+}
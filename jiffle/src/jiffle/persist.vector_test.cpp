@@ -0,0 +1,81 @@
+#include "persist.h"
+#include <assert.h>
+
+namespace jiffle {
+	namespace persist {
+
+		void vector_test() {
+			// internal state -------------------------------------------------
+			vector<int> _v;
+
+			// methods --------------------------------------------------------
+			auto assert_range = [&](const vector<int>& v, int first, int last) {
+				assert(v.size() == (size_t)(last - first));
+				for (int i = first; i < last; i++)
+					assert(v[i - first] == i);
+			};
+			auto assert_balanced = [&](const vector<int>& v) {
+				// chunks of 1 worst case, AVL height bound ~1.44 log2 n
+				size_t bound = 2;
+				for (auto n = v.size(); n; n >>= 1)
+					bound += 2;
+				assert(v.height() <= bound);
+			};
+
+			// tests ----------------------------------------------------------
+
+			// empty
+			assert(_v.empty() && _v.size() == 0);
+
+			// append, every version remains valid
+			std::vector<vector<int>> versions;
+			for (int i = 0; i < 1000; i++) {
+				versions.push_back(_v);
+				_v = _v.push_back(i);
+			}
+			assert_range(_v, 0, 1000);
+			for (int i = 0; i < 1000; i += 97)
+				assert_range(versions[i], 0, i);
+			assert_balanced(_v);
+
+			// update
+			auto updated = _v.set(500, -1);
+			assert(updated[500] == -1 && _v[500] == 500);
+			assert(updated[499] == 499 && updated[501] == 501);
+
+			// slice
+			assert_range(_v.slice(0, 0), 0, 0);
+			assert_range(_v.slice(10, 20), 10, 20);
+			assert_range(_v.slice(31, 33), 31, 33);
+			assert_range(_v.slice(0, 1000), 0, 1000);
+			assert_range(_v.slice(999, 1000), 999, 1000);
+
+			// concat
+			auto joined = _v.slice(0, 300).concat(_v.slice(300, 1000));
+			assert_range(joined, 0, 1000);
+			assert_balanced(joined);
+
+			// many small pieces stay balanced
+			vector<int> pieces;
+			for (int i = 0; i < 2000; i++)
+				pieces = pieces.concat(vector<int>({ i }));
+			assert_range(pieces, 0, 2000);
+			assert_balanced(pieces);
+			vector<int> reversed;
+			for (int i = 1999; i >= 0; i--)
+				reversed = vector<int>({ i }).concat(reversed);
+			assert_range(reversed, 0, 2000);
+			assert_balanced(reversed);
+
+			// bulk construction and materialization
+			std::vector<int> items;
+			for (int i = 0; i < 777; i++)
+				items.push_back(i);
+			vector<int> bulk(items);
+			assert_range(bulk, 0, 777);
+			assert(bulk.materialize() == items);
+			assert_range(bulk.slice(100, 700).slice(50, 60), 150, 160);
+		}
+
+	}
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "vm.h"
+
+#include <atomic>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace jiffle {
+	namespace serve {
+
+		// Compile server: a long running process keeps the trees of parsed
+		// modules and the linked tables of whole programs between requests,
+		// so a compile of unchanged sources costs reading and hashing them.
+		// Entries are keyed by path and checked against the hash of the
+		// file content on every request. Interned strings (text::intern)
+		// and keyword tables stay warm for the life of the process.
+		//
+		// Requests are one line, words separated by tabs:
+		//   compile <path>...   parse, generate and link
+		//   run <path>...       the same, then execute
+		//   stats               cache counters
+		//   drop                forget every cached module and program
+		//   stop                ends listen once answered
+		// Responses are lines on channels, '1 ' for output and '2 ' for
+		// diagnostics, then '= <exit code>' as the last line.
+
+		class server {
+		public:
+			typedef std::function<std::string(const vm::value&)> printer;
+
+			struct counters {
+				size_t requests;
+				size_t parsed;		// modules tokenized and parsed
+				size_t reused;		// modules whose cached tree was current
+				size_t generated;	// programs generated and linked
+				size_t hits;		// programs whose cached tables were current
+			};
+
+			explicit server(printer print);
+
+			// response to one request line, requests may be handled
+			// concurrently (they share the caches, not execution)
+			std::string handle(const std::string& request);
+
+			// answers connections on a Unix domain socket, one request each
+			// on its own thread, until a stop request. Runs still going are
+			// cut short by a stop. False when the socket can't be created
+			// or another server is answering on it.
+			bool listen(const std::string& path);
+
+			// cache counters as of now, requests may be going on
+			counters stats() const;
+
+		private:
+			struct module {
+				size_t hash;
+				expr::node tree;
+			};
+			struct program {
+				std::string key;	// paths and hashes of its modules
+				std::vector<vm::table> tables;
+				std::vector<std::string> unresolved;
+			};
+			static const size_t Programs = 8;	// most recently used kept
+
+			std::shared_ptr<const program> compile(const std::vector<std::string>& paths, std::string& failure);
+
+			printer _print;
+			mutable std::mutex _mutex;	// guards modules, programs and stats
+			std::map<std::string, module> _modules;
+			std::list<std::shared_ptr<const program>> _programs;	// most recent first
+			counters _stats;
+			std::atomic<bool> _stopping;	// runs end early
+		};
+
+		// sends a request to the server on a socket, writes its channels to
+		// out and err and returns the exit code, -1 when it can't connect.
+		// Paths are made absolute, the server may run in another directory.
+		int request(const std::string& path, const std::string& command, const std::vector<std::string>& paths,
+			std::string& out, std::string& err);
+
+		// tests --------------------------------------------------------------
+
+		void server_test();
+
+	}
+}
@@ -0,0 +1,145 @@
+#include "serve.h"
+#include "text.h"
+
+#include <fstream>
+#include <iterator>
+#include <mutex>
+
+namespace jiffle {
+	namespace serve {
+
+		server::server(printer print) : _print(print), _stats(), _stopping(false) {}
+
+		std::shared_ptr<const server::program> server::compile(const std::vector<std::string>& paths, std::string& failure) {
+			std::string key;
+			std::vector<const expr::node*> trees;
+			for (auto& path : paths) {
+				std::ifstream input(path, std::ios::binary);
+				if (!input) {
+					failure = "jiffle: cannot read '" + path + "'";
+					return nullptr;
+				}
+				std::string code((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+				auto hash = text::hash(code.data(), code.size());
+
+				// a module is parsed again only when its content changed
+				auto found = _modules.find(path);
+				if (found != _modules.end() && found->second.hash == hash)
+					_stats.reused++;
+				else {
+					_stats.parsed++;
+					auto tree = expr::parse(syntax::tokenize(code), code);
+					found = _modules.insert(std::make_pair(path, module())).first;
+					found->second = { hash, std::move(tree) };
+				}
+				key += path + "\t" + std::to_string(hash) + "\n";
+				trees.push_back(&found->second.tree);
+			}
+
+			for (auto i = _programs.begin(); i != _programs.end(); ++i) {
+				if ((*i)->key != key)
+					continue;
+				_stats.hits++;
+				_programs.splice(_programs.begin(), _programs, i);
+				return _programs.front();
+			}
+			_stats.generated++;
+			auto p = std::make_shared<program>();
+			p->key = key;
+			p->tables = vm::compile(trees, p->unresolved);
+			_programs.push_front(p);
+			if (_programs.size() > Programs)
+				_programs.pop_back();
+			return p;
+		}
+
+		server::counters server::stats() const {
+			std::lock_guard<std::mutex> lock(_mutex);
+			return _stats;
+		}
+
+		std::string server::handle(const std::string& request) {
+			// internal state -------------------------------------------------
+			std::vector<std::string> _words;
+			std::string _out;
+			int _code = 0;
+
+			// methods --------------------------------------------------------
+			auto line = [&](char channel, const std::string& text) {
+				// multiline values keep the channel on every line
+				size_t from = 0;
+				for (;;) {
+					auto to = text.find('\n', from);
+					_out += channel;
+					_out += ' ';
+					_out.append(text, from, to == std::string::npos ? std::string::npos : to - from);
+					_out += '\n';
+					if (to == std::string::npos)
+						break;
+					from = to + 1;
+				}
+			};
+			auto fail = [&](const std::string& text) {
+				line('2', text);
+				_code = 1;
+			};
+
+			// entry ----------------------------------------------------------
+			std::unique_lock<std::mutex> lock(_mutex);	// caches, not execution
+			_stats.requests++;
+			auto end = request.find_last_not_of("\r\n");
+			for (size_t from = 0; end != std::string::npos && from <= end;) {
+				auto tab = request.find('\t', from);
+				auto to = tab == std::string::npos || tab > end ? end + 1 : tab;
+				_words.push_back(request.substr(from, to - from));
+				from = to + 1;
+			}
+
+			auto command = _words.empty() ? std::string() : _words[0];
+			std::vector<std::string> paths(_words.size() > 1 ? _words.begin() + 1 : _words.end(), _words.end());
+			if (command == "compile" || command == "run") {
+				std::string failure;
+				auto p = paths.empty() ? nullptr : compile(paths, failure);
+				if (paths.empty())
+					fail("jiffle: no sources");
+				else if (!p)
+					fail(failure);
+				else {
+					lock.unlock();
+					for (auto& symbol : p->unresolved)
+						fail("jiffle: unresolved symbol '" + symbol + "'");
+					if (command == "run" && !p->tables.empty()) {
+						// in slices, a program that never ends is cut when the server stops
+						auto process = vm::start(p->tables);
+						process.closed = true;
+						auto s = vm::Suspended;
+						while (!_stopping && (s = vm::resume(process, vm::scheduler::Slice)) == vm::Suspended)
+							;
+						if (s == vm::Finished)
+							for (auto& v : process.outputs[0])
+								line('1', _print(v));
+						else
+							fail("jiffle: server stopped");
+					}
+				}
+			}
+			else if (command == "stats") {
+				line('1', "requests " + std::to_string(_stats.requests));
+				line('1', "parsed " + std::to_string(_stats.parsed));
+				line('1', "reused " + std::to_string(_stats.reused));
+				line('1', "generated " + std::to_string(_stats.generated));
+				line('1', "hits " + std::to_string(_stats.hits));
+			}
+			else if (command == "drop") {
+				_modules.clear();
+				_programs.clear();
+			}
+			else if (command != "stop")
+				fail("jiffle: unknown request '" + command + "'");
+
+			_out += "= " + std::to_string(_code) + "\n";
+			return _out;
+		}
+
+	}
+}
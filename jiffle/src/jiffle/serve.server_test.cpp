@@ -0,0 +1,158 @@
+#include "serve.h"
+#include <assert.h>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <thread>
+
+#ifdef _WIN32
+#include <direct.h>
+#include <windows.h>
+#else
+#include <stdlib.h>
+#include <unistd.h>
+#endif
+
+namespace jiffle {
+	namespace serve {
+
+		namespace {
+			// new empty directory of its own, with a trailing separator
+#ifdef _WIN32
+			std::string temporary() {
+				char base[MAX_PATH + 1];
+				auto n = GetTempPathA(sizeof(base), base);
+				for (unsigned i = 0;; i++) {
+					auto path = std::string(base, n) + "jiffle_serve_" + std::to_string(GetCurrentProcessId()) + "_" + std::to_string(i);
+					if (_mkdir(path.c_str()) == 0)
+						return path + "\\";
+				}
+			}
+			void removeDirectory(const std::string& path) { _rmdir(path.c_str()); }
+#else
+			std::string temporary() {
+				char path[] = "/tmp/jiffle_serve_XXXXXX";
+				return std::string(mkdtemp(path)) + "/";
+			}
+			void removeDirectory(const std::string& path) { rmdir(path.c_str()); }
+#endif
+		}
+
+		void server_test() {
+			// internal state -------------------------------------------------
+			auto _folder = temporary();
+			auto _library = _folder + "library.jfl";
+			auto _main = _folder + "main.jfl";
+			auto _none = _folder + "none.jfl";
+			auto _socket = _folder + "test.sock";
+			auto Library = _library.c_str();
+			auto Main = _main.c_str();
+			auto Socket = _socket.c_str();
+			server _server([](const vm::value& v) {
+				return v.type == data::String || v.type == data::Error ? v.text.str() : std::to_string(v.integer);
+			});
+
+			// methods --------------------------------------------------------
+			auto write = [](const char* path, const std::string& code) {
+				std::ofstream(path, std::ios::binary) << code;
+			};
+			auto run = [&]() {
+				return _server.handle(std::string("run\t") + Library + "\t" + Main + "\n");
+			};
+
+			// tests ----------------------------------------------------------
+
+			{ // cached until a file changes
+				write(Library, "inc [x] = x + 1\n");
+				write(Main, "inc 1, inc 2\n");
+				assert(run() == "1 2\n1 3\n= 0\n");
+				assert(_server.stats().parsed == 2 && _server.stats().generated == 1);
+				assert(run() == "1 2\n1 3\n= 0\n");
+				assert(_server.stats().reused == 2 && _server.stats().hits == 1 && _server.stats().generated == 1);
+
+				write(Main, "inc 10\n");
+				assert(run() == "1 11\n= 0\n");
+				assert(_server.stats().parsed == 3 && _server.stats().reused == 3 && _server.stats().generated == 2);
+
+				// the earlier program is still cached
+				write(Main, "inc 1, inc 2\n");
+				assert(run() == "1 2\n1 3\n= 0\n");
+				assert(_server.stats().parsed == 4 && _server.stats().hits == 2);
+
+				assert(_server.handle(std::string("compile\t") + Library + "\t" + Main) == "= 0\n");
+				assert(_server.handle("stats").find("1 requests 6\n") == 0);
+				assert(_server.handle("drop\r\n") == "= 0\n");
+				assert(run() == "1 2\n1 3\n= 0\n");
+				assert(_server.stats().parsed == 6);
+			}
+			{ // diagnostics and failures
+				write(Main, "missing 1\n'a\nb'\n");
+				assert(run() == "2 jiffle: unresolved symbol 'missing'\n1 unresolved symbol 'missing'\n1 a\n1 b\n= 1\n");
+				assert(_server.handle("run\t" + _none) == "2 jiffle: cannot read '" + _none + "'\n= 1\n");
+				assert(_server.handle("run") == "2 jiffle: no sources\n= 1\n");
+				assert(_server.handle("") == "2 jiffle: unknown request ''\n= 1\n");
+			}
+			{ // over a socket
+				write(Main, "inc 41\n");
+				std::thread daemon([&]() { assert(_server.listen(Socket)); });
+				std::string out, err;
+				auto code = -1;
+				for (int i = 0; i < 2000 && code < 0; i++) {
+					code = request(Socket, "run", { Library, Main }, out, err);
+					if (code < 0)
+						std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				}
+				assert(code == 0 && out == "42\n" && err.empty());
+				assert(!server([](const vm::value&) { return std::string(); }).listen(Socket));
+
+				out.clear();
+				assert(request(Socket, "run", { _none }, out, err) == 1);
+				assert(out.empty() && err == "jiffle: cannot read '" + _none + "'\n");
+
+				// relative paths are made absolute by the client
+				err.clear();
+				assert(request(Socket, "run", { "jiffle_serve_none.jfl" }, out, err) == 1);
+				assert(err.find("jiffle: cannot read 'jiffle_serve_none.jfl'") == std::string::npos);
+
+				// responses of any length
+				std::string many;
+				for (int i = 0; i < 200000; i++)
+					many += std::to_string(i) + "\n";
+				write(Main, many);
+				out.clear();
+				err.clear();
+				assert(request(Socket, "run", { Main }, out, err) == 0);
+				assert(out == many && err.empty());
+
+				// a run that never ends holds neither other requests nor a stop
+				write(Library, "loop [x] = loop x\nloop 1\n");
+				write(Main, "inc [x] = x + 1\ninc 1\n");
+				auto requests = _server.stats().requests;
+				std::string endless, reason;
+				std::thread hung([&]() { assert(request(Socket, "run", { Library }, endless, reason) == 1); });
+				for (int i = 0; i < 3; i++) {
+					out.clear();
+					assert(request(Socket, "run", { Main }, out, err) == 0 && out == "2\n");
+				}
+				// the endless run was taken before the stop
+				for (size_t asked = 1;; asked++) {
+					out.clear();
+					assert(request(Socket, "stats", {}, out, err) == 0);
+					if (std::stoul(out.substr(out.find(' ') + 1)) == requests + 1 + 3 + asked)
+						break;
+					std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				}
+				assert(request(Socket, "stop", {}, out, err) == 0);
+				hung.join();
+				assert(endless.empty() && reason == "jiffle: server stopped\n");
+				daemon.join();
+				assert(request(Socket, "stats", {}, out, err) == -1);
+			}
+			std::remove(Library);
+			std::remove(Main);
+			removeDirectory(_folder);
+		}
+
+	}
+}
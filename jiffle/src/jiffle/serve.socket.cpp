@@ -0,0 +1,220 @@
+#include "serve.h"
+
+#include <cerrno>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <afunix.h>
+#include <io.h>
+#pragma comment(lib, "Ws2_32.lib")
+#else
+#include <limits.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace jiffle {
+	namespace serve {
+
+		namespace {
+#ifdef _WIN32
+			typedef SOCKET descriptor;
+			static const descriptor None = INVALID_SOCKET;
+			void closeSocket(descriptor s) { closesocket(s); }
+			void removeFile(const std::string& path) { _unlink(path.c_str()); }
+			bool startup() {
+				static bool ready = [] {
+					WSADATA data;
+					return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+				}();
+				return ready;
+			}
+			bool interrupted() { return WSAGetLastError() == WSAEINTR; }
+#else
+			typedef int descriptor;
+			static const descriptor None = -1;
+			void closeSocket(descriptor s) { close(s); }
+			void removeFile(const std::string& path) { unlink(path.c_str()); }
+			bool startup() { return true; }
+			bool interrupted() { return errno == EINTR; }
+#endif
+#ifdef MSG_NOSIGNAL
+			static const int SendFlags = MSG_NOSIGNAL;	// a closed peer is an error, not a signal
+#else
+			static const int SendFlags = 0;
+#endif
+			static const size_t MaxRequest = 1 << 20;
+
+			descriptor open(const std::string& path, sockaddr_un& address) {
+				if (!startup() || path.size() >= sizeof(address.sun_path))
+					return None;
+				memset(&address, 0, sizeof(address));
+				address.sun_family = AF_UNIX;
+				memcpy(address.sun_path, path.c_str(), path.size());
+				return socket(AF_UNIX, SOCK_STREAM, 0);
+			}
+
+			descriptor connectTo(const std::string& path) {
+				sockaddr_un address;
+				auto s = open(path, address);
+				if (s == None)
+					return None;
+				if (connect(s, (sockaddr*)&address, sizeof(address)) != 0) {
+					closeSocket(s);
+					return None;
+				}
+				return s;
+			}
+
+			bool sendAll(descriptor s, const std::string& data) {
+				for (size_t sent = 0; sent < data.size();) {
+					auto n = send(s, data.data() + sent, (int)(data.size() - sent), SendFlags);
+					if (n <= 0)
+						return false;
+					sent += (size_t)n;
+				}
+				return true;
+			}
+
+			// up to the first newline of a request (line, MaxRequest at most),
+			// or a whole response until closed
+			std::string receive(descriptor s, bool line) {
+				std::string data;
+				char chunk[4096];
+				while (!line || data.size() < MaxRequest) {
+					auto n = recv(s, chunk, sizeof(chunk), 0);
+					if (n <= 0)
+						break;
+					data.append(chunk, (size_t)n);
+					if (line && data.find('\n') != std::string::npos)
+						break;
+				}
+				return data;
+			}
+
+			std::string absolute(const std::string& path) {
+#ifdef _WIN32
+				char full[_MAX_PATH];
+				return _fullpath(full, path.c_str(), sizeof(full)) ? full : path;
+#else
+				char full[PATH_MAX];
+				if (realpath(path.c_str(), full))
+					return full;
+				// missing files are reported by the server
+				char cwd[PATH_MAX];
+				return path.empty() || path[0] == '/' || !getcwd(cwd, sizeof(cwd)) ? path : std::string(cwd) + "/" + path;
+#endif
+			}
+		}
+
+		bool server::listen(const std::string& path) {
+			// a socket file left by a server that ended is replaced,
+			// one that is still answered is not
+			auto live = connectTo(path);
+			if (live != None) {
+				closeSocket(live);
+				return false;
+			}
+			sockaddr_un address;
+			auto s = open(path, address);
+			if (s == None)
+				return false;
+			removeFile(path);
+			if (bind(s, (sockaddr*)&address, sizeof(address)) != 0 || ::listen(s, 16) != 0) {
+				closeSocket(s);
+				return false;
+			}
+
+			// requests are answered on their own threads, a long run
+			// doesn't hold the others
+			std::mutex mutex;
+			std::condition_variable idle;
+			size_t running = 0;
+			_stopping = false;
+			for (;;) {
+				auto c = accept(s, nullptr, nullptr);
+				if (c == None && interrupted())
+					continue;
+				if (c == None)
+					break;
+				// a client that never completes its request doesn't hold the server
+#ifdef _WIN32
+				DWORD timeout = 5000;
+#else
+				timeval timeout = { 5, 0 };
+#endif
+				setsockopt(c, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
+				auto request = receive(c, true);
+				request = request.substr(0, request.find_first_of("\r\n"));
+				if (request == "stop") {
+					_stopping = true;
+					std::unique_lock<std::mutex> lock(mutex);
+					idle.wait(lock, [&]() { return running == 0; });
+					sendAll(c, handle(request));
+					closeSocket(c);
+					break;
+				}
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					running++;
+				}
+				std::thread([this, c, request, &mutex, &idle, &running]() {
+					sendAll(c, handle(request));
+					closeSocket(c);
+					std::lock_guard<std::mutex> lock(mutex);
+					if (--running == 0)
+						idle.notify_all();
+				}).detach();
+			}
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				idle.wait(lock, [&]() { return running == 0; });
+			}
+			_stopping = false;
+			closeSocket(s);
+			removeFile(path);
+			return true;
+		}
+
+		int request(const std::string& path, const std::string& command, const std::vector<std::string>& paths,
+			std::string& out, std::string& err) {
+			auto s = connectTo(path);
+			if (s == None)
+				return -1;
+			auto line = command;
+			for (auto& p : paths)
+				line += "\t" + absolute(p);
+			line += "\n";
+			auto sent = sendAll(s, line);
+			auto response = sent ? receive(s, false) : std::string();
+			closeSocket(s);
+
+			auto code = -1;
+			for (size_t from = 0; from < response.size();) {
+				auto to = response.find('\n', from);
+				if (to == std::string::npos)
+					break;	// cut short, no exit code
+				auto text = response.substr(from, to - from);
+				from = to + 1;
+				if (text.size() < 2 || text[1] != ' ')
+					continue;
+				auto rest = text.substr(2) + "\n";
+				if (text[0] == '1')
+					out += rest;
+				else if (text[0] == '2')
+					err += rest;
+				else if (text[0] == '=')
+					code = std::atoi(rest.c_str());
+			}
+			return code;
+		}
+
+	}
+}
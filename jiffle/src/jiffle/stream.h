@@ -0,0 +1,458 @@
+#pragma once
+
+#include "data.h"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace jiffle {
+	namespace stream {
+
+		// ranges -------------------------------------------------------------
+
+		// Inclusive arithmetic progression ('0..9', 'a'..'f'),
+		// characters are ranges over their codes.
+		// A range is only a description, elements are computed on access.
+		struct range {
+			data::integer_t first;
+			data::integer_t last;
+			data::integer_t step;
+		};
+
+		// number of elements in range
+		size_t size(const range& r);
+
+		// element at index, index must be lower than size
+		data::integer_t at(const range& r, size_t index);
+
+		// sequences ----------------------------------------------------------
+
+		// pulls the next element into output, false when exhausted
+		template<typename T>
+		using cursor = std::function<bool(T&)>;
+
+		// Lazy sequence, source followed by a fused chain of stages.
+		// Elements are pulled one at a time through all stages,
+		// no intermediate sequence is ever stored.
+		template<typename T>
+		struct sequence {
+			std::function<cursor<T>()> begin;	// fresh cursor from first element
+			std::function<T(size_t)> at;		// direct access (unset after filter)
+			size_t count;						// element count (valid when 'at' is set)
+		};
+
+		// functions ----------------------------------------------------------
+
+		// lazy sequence over range elements
+		sequence<data::integer_t> from(const range& r);
+
+		// fuses an element transformation into the sequence
+		template<typename T, typename F>
+		auto map(const sequence<T>& s, F f) -> sequence<decltype(f(std::declval<T>()))> {
+			typedef decltype(f(std::declval<T>())) U;
+			sequence<U> out;
+			auto begin = s.begin;
+			out.begin = [begin, f]() -> cursor<U> {
+				auto c = begin();
+				return [c, f](U& v) mutable {
+					T x;
+					if (!c(x))
+						return false;
+					v = f(x);
+					return true;
+				};
+			};
+			if (s.at) {
+				auto at = s.at;
+				out.at = [at, f](size_t i) { return f(at(i)); };
+			}
+			out.count = s.count;
+			return out;
+		}
+
+		// fuses an element predicate into the sequence,
+		// dropped elements never leave the cursor
+		template<typename T, typename P>
+		sequence<T> filter(const sequence<T>& s, P p) {
+			sequence<T> out;
+			auto begin = s.begin;
+			out.begin = [begin, p]() -> cursor<T> {
+				auto c = begin();
+				return [c, p](T& v) mutable {
+					while (c(v))
+						if (p(v))
+							return true;
+					return false;
+				};
+			};
+			out.count = 0;
+			return out;
+		}
+
+		// element at index, scans (without storing) when not directly accessible
+		template<typename T>
+		bool index(const sequence<T>& s, size_t i, T& v) {
+			if (s.at) {
+				if (i >= s.count)
+					return false;
+				v = s.at(i);
+				return true;
+			}
+			auto c = s.begin();
+			while (c(v))
+				if (i-- == 0)
+					return true;
+			return false;
+		}
+
+		// stores all elements, used only when the sequence is captured
+		template<typename T>
+		std::vector<T> materialize(const sequence<T>& s) {
+			std::vector<T> out;
+			if (s.at)
+				out.reserve(s.count);
+			T v;
+			auto c = s.begin();
+			while (c(v))
+				out.push_back(v);
+			return out;
+		}
+
+		// channels -----------------------------------------------------------
+
+		// Bounded lock-free queue between two stages, moving elements in
+		// batches. push and pop never block: they move as many elements as
+		// fit or are available, 0 is full (backpressure) or empty.
+		template<typename T>
+		class channel {
+		public:
+			channel() : _closed(false) {}
+			virtual ~channel() {}
+
+			virtual size_t push(T* items, size_t n) = 0;
+			virtual size_t pop(T* out, size_t n) = 0;
+
+			// after the last push, pop still drains what is left
+			void close() { _closed.store(true, std::memory_order_release); }
+			bool closed() const { return _closed.load(std::memory_order_acquire); }
+
+		protected:
+			static size_t round(size_t capacity) {
+				size_t n = 2;
+				while (n < capacity)
+					n <<= 1;
+				return n;
+			}
+
+		private:
+			std::atomic<bool> _closed;
+		};
+
+		// Single producer, single consumer ring. Each side caches the index
+		// of the other, shared indices are read only when the cache runs out.
+		template<typename T>
+		class ring : public channel<T> {
+		public:
+			explicit ring(size_t capacity)
+				: _items(channel<T>::round(capacity)), _mask(_items.size() - 1),
+				_head(0), _cachedTail(0), _tail(0), _cachedHead(0) {}
+
+			size_t push(T* items, size_t n) override {
+				auto tail = _tail.load(std::memory_order_relaxed);
+				if (_items.size() - (tail - _cachedHead) < n)
+					_cachedHead = _head.load(std::memory_order_acquire);
+				auto free = _items.size() - (tail - _cachedHead);
+				n = n < free ? n : free;
+				for (size_t i = 0; i < n; i++)
+					_items[(tail + i) & _mask] = std::move(items[i]);
+				_tail.store(tail + n, std::memory_order_release);
+				return n;
+			}
+
+			size_t pop(T* out, size_t n) override {
+				auto head = _head.load(std::memory_order_relaxed);
+				if (_cachedTail - head < n)
+					_cachedTail = _tail.load(std::memory_order_acquire);
+				auto available = _cachedTail - head;
+				n = n < available ? n : available;
+				for (size_t i = 0; i < n; i++)
+					out[i] = std::move(_items[(head + i) & _mask]);
+				_head.store(head + n, std::memory_order_release);
+				return n;
+			}
+
+		private:
+			std::vector<T> _items;
+			size_t _mask;
+			alignas(64) std::atomic<size_t> _head;	// consumer side
+			size_t _cachedTail;
+			alignas(64) std::atomic<size_t> _tail;	// producer side
+			size_t _cachedHead;
+		};
+
+		// Multiple producer, multiple consumer queue over sequenced cells.
+		// A batch claims consecutive ready cells with one compare and swap.
+		template<typename T>
+		class queue : public channel<T> {
+		public:
+			explicit queue(size_t capacity)
+				: _cells(channel<T>::round(capacity)), _mask(_cells.size() - 1), _enqueue(0), _dequeue(0) {
+				for (size_t i = 0; i < _cells.size(); i++)
+					_cells[i].sequence.store(i, std::memory_order_relaxed);
+			}
+
+			size_t push(T* items, size_t n) override {
+				auto pos = _enqueue.load(std::memory_order_relaxed);
+				for (;;) {
+					auto k = ready(pos, n, 0);
+					if (k == 0) {
+						auto seq = _cells[pos & _mask].sequence.load(std::memory_order_acquire);
+						if ((intptr_t)(seq - pos) < 0)
+							return 0; // full
+						pos = _enqueue.load(std::memory_order_relaxed);
+						continue;
+					}
+					if (_enqueue.compare_exchange_weak(pos, pos + k, std::memory_order_relaxed)) {
+						for (size_t i = 0; i < k; i++) {
+							auto& c = _cells[(pos + i) & _mask];
+							c.item = std::move(items[i]);
+							c.sequence.store(pos + i + 1, std::memory_order_release);
+						}
+						return k;
+					}
+				}
+			}
+
+			size_t pop(T* out, size_t n) override {
+				auto pos = _dequeue.load(std::memory_order_relaxed);
+				for (;;) {
+					auto k = ready(pos, n, 1);
+					if (k == 0) {
+						auto seq = _cells[pos & _mask].sequence.load(std::memory_order_acquire);
+						if ((intptr_t)(seq - (pos + 1)) < 0)
+							return 0; // empty
+						pos = _dequeue.load(std::memory_order_relaxed);
+						continue;
+					}
+					if (_dequeue.compare_exchange_weak(pos, pos + k, std::memory_order_relaxed)) {
+						for (size_t i = 0; i < k; i++) {
+							auto& c = _cells[(pos + i) & _mask];
+							out[i] = std::move(c.item);
+							c.sequence.store(pos + i + _cells.size(), std::memory_order_release);
+						}
+						return k;
+					}
+				}
+			}
+
+		private:
+			struct cell {
+				std::atomic<size_t> sequence;	// position + 1 once filled
+				T item;
+			};
+
+			std::vector<cell> _cells;
+			size_t _mask;
+			alignas(64) std::atomic<size_t> _enqueue;
+			alignas(64) std::atomic<size_t> _dequeue;
+
+			// consecutive cells from pos in the expected state, at most n
+			size_t ready(size_t pos, size_t n, size_t filled) const {
+				size_t k = 0;
+				while (k < n && k < _cells.size()
+					&& _cells[(pos + k) & _mask].sequence.load(std::memory_order_acquire) == pos + k + filled)
+					k++;
+				return k;
+			}
+		};
+
+		// pipelines ----------------------------------------------------------
+
+		// Transformations connected by bounded channels, every stage worker
+		// on its own thread. Elements flow in batches, and a full channel
+		// stalls the stages before it. Stages of one worker are joined by
+		// rings and keep element order, replicated stages share queues.
+		template<typename T>
+		class pipeline {
+		public:
+			// rewrites a batch in place, may drop or add elements
+			typedef std::function<void(std::vector<T>&)> transform;
+
+			static constexpr size_t Batch = 64;
+
+			explicit pipeline(size_t capacity = 1024) : _capacity(capacity) {}
+
+			pipeline& stage(transform f, size_t workers = 1) {
+				_stages.push_back({ f, workers ? workers : 1 });
+				return *this;
+			}
+
+			// pulls every source element through all stages into sink,
+			// sink is called on this thread in batch order of the last channel
+			void run(cursor<T> source, const std::function<void(const std::vector<T>&)>& sink) {
+				// channel i feeds stage i, the last one feeds sink
+				std::vector<std::unique_ptr<channel<T>>> links;
+				std::vector<std::unique_ptr<std::atomic<size_t>>> producers;
+				size_t from = 1;
+				for (size_t i = 0; i <= _stages.size(); i++) {
+					auto to = i < _stages.size() ? _stages[i].workers : 1;
+					if (from == 1 && to == 1)
+						links.emplace_back(new ring<T>(_capacity));
+					else
+						links.emplace_back(new queue<T>(_capacity));
+					producers.emplace_back(new std::atomic<size_t>(from));
+					from = to;
+				}
+				auto finish = [&](size_t i) {
+					if (producers[i]->fetch_sub(1) == 1)
+						links[i]->close();
+				};
+
+				std::vector<std::thread> threads;
+				threads.emplace_back([&]() {
+					std::vector<T> batch;
+					T v;
+					for (;;) {
+						batch.clear();
+						while (batch.size() < Batch && source(v))
+							batch.push_back(v);
+						if (batch.empty())
+							break;
+						send(*links[0], batch);
+					}
+					finish(0);
+				});
+				for (size_t i = 0; i < _stages.size(); i++) {
+					for (size_t w = 0; w < _stages[i].workers; w++) {
+						threads.emplace_back([&, i]() {
+							std::vector<T> batch;
+							while (receive(*links[i], batch)) {
+								_stages[i].f(batch);
+								send(*links[i + 1], batch);
+							}
+							finish(i + 1);
+						});
+					}
+				}
+				std::vector<T> batch;
+				while (receive(*links.back(), batch))
+					sink(batch);
+				for (auto& t : threads)
+					t.join();
+			}
+
+		private:
+			struct step {
+				transform f;
+				size_t workers;
+			};
+
+			size_t _capacity;
+			std::vector<step> _stages;
+
+			static void backoff(size_t& spins) {
+				if (++spins > 64)
+					std::this_thread::yield();
+			}
+
+			// pushes the whole batch, waiting while the channel is full
+			static void send(channel<T>& c, std::vector<T>& batch) {
+				size_t sent = 0, spins = 0;
+				while (sent < batch.size()) {
+					auto n = c.push(batch.data() + sent, batch.size() - sent);
+					if (n == 0)
+						backoff(spins);
+					sent += n;
+				}
+				batch.clear();
+			}
+
+			// next batch, false once the channel is closed and drained
+			static bool receive(channel<T>& c, std::vector<T>& batch) {
+				batch.resize(Batch);
+				size_t spins = 0;
+				for (;;) {
+					auto n = c.pop(batch.data(), Batch);
+					if (n == 0 && c.closed())
+						n = c.pop(batch.data(), Batch); // pushed before closing
+					if (n > 0) {
+						batch.resize(n);
+						return true;
+					}
+					if (c.closed()) {
+						batch.clear();
+						return false;
+					}
+					backoff(spins);
+				}
+			}
+		};
+
+		// kernels ------------------------------------------------------------
+
+		// Bulk operations over unboxed homogeneous sequences
+		// (integers, or reals stored as double), vectorized when supported.
+
+		// instruction set used by kernels
+		enum simd : unsigned char {
+			Scalar,
+			SSE2,
+			AVX2,
+		};
+
+		enum arithmetic : unsigned char {
+			Add,
+			Sub,
+			Mul,
+			Div,
+		};
+
+		enum comparison : unsigned char {
+			Equal,
+			Less,
+			LessEqual,
+			Greater,
+			GreaterEqual,
+		};
+
+		// current kernel instruction set, best supported by default
+		simd kernels();
+		// selects instruction set (capped to supported), returns selected
+		simd kernels(simd level);
+
+		// element-wise out[i] = a[i] op b[i], false on integer division by zero
+		bool apply(arithmetic op, const data::integer_t* a, const data::integer_t* b, data::integer_t* out, size_t n);
+		bool apply(arithmetic op, const double* a, const double* b, double* out, size_t n);
+		// dispatch by element type, false when type has no kernel (generic path)
+		bool apply(arithmetic op, data::type t, const void* a, const void* b, void* out, size_t n);
+
+		// element-wise out[i] = a[i] cmp b[i] ? 1 : 0
+		void compare(comparison cmp, const data::integer_t* a, const data::integer_t* b, data::byte* out, size_t n);
+		void compare(comparison cmp, const double* a, const double* b, data::byte* out, size_t n);
+
+		// reductions (integer sums wrap), minimum/maximum require n > 0
+		// and give NaN when any real element is
+		data::integer_t sum(const data::integer_t* a, size_t n);
+		double sum(const double* a, size_t n);
+		data::integer_t minimum(const data::integer_t* a, size_t n);
+		double minimum(const double* a, size_t n);
+		data::integer_t maximum(const data::integer_t* a, size_t n);
+		double maximum(const double* a, size_t n);
+
+		// range generation, writes size(r) elements
+		void fill(const range& r, data::integer_t* out);
+
+		// stores all range elements (range capture)
+		std::vector<data::integer_t> materialize(const range& r);
+
+		// tests --------------------------------------------------------------
+
+		void range_test();
+		void kernel_test();
+		void pipeline_test();
+
+	}
+}
@@ -0,0 +1,578 @@
+#include "stream.h"
+
+#include <limits>
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__) \
+	|| (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define JIFFLE_SSE2
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define JIFFLE_AVX2
+#define JIFFLE_TARGET_AVX2
+#elif defined(__GNUC__)
+#define JIFFLE_AVX2
+#define JIFFLE_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace jiffle {
+	namespace stream {
+
+		using data::integer_t;
+		typedef uint64_t uinteger_t; // wrapping integer arithmetic
+
+		// instruction set ----------------------------------------------------
+
+		static simd detect() {
+#if defined(JIFFLE_AVX2) && defined(_MSC_VER)
+			int info[4];
+			__cpuid(info, 0);
+			if (info[0] >= 7) {
+				__cpuid(info, 1);
+				auto osxsave = (info[2] & (1 << 27)) != 0;
+				auto avx = (info[2] & (1 << 28)) != 0;
+				__cpuidex(info, 7, 0);
+				auto avx2 = (info[1] & (1 << 5)) != 0;
+				if (osxsave && avx && avx2 && (_xgetbv(0) & 6) == 6)
+					return AVX2;
+			}
+#elif defined(JIFFLE_AVX2)
+			__builtin_cpu_init();
+			if (__builtin_cpu_supports("avx2"))
+				return AVX2;
+#endif
+#ifdef JIFFLE_SSE2
+			return SSE2;
+#else
+			return Scalar;
+#endif
+		}
+
+		static const simd _supported = detect();
+		static std::atomic<simd> _level(_supported);	// read by every kernel, set from any thread
+
+		simd kernels() {
+			return _level.load(std::memory_order_relaxed);
+		}
+
+		simd kernels(simd level) {
+			level = level < _supported ? level : _supported;
+			_level.store(level, std::memory_order_relaxed);
+			return level;
+		}
+
+		// scalar -------------------------------------------------------------
+		// (also finishes the tail left by vector kernels, from index i)
+
+		static bool apply_scalar(arithmetic op, const integer_t* a, const integer_t* b, integer_t* out, size_t n, size_t i) {
+			switch (op) {
+			case Add:
+				for (; i < n; i++)
+					out[i] = (integer_t)((uinteger_t)a[i] + (uinteger_t)b[i]);
+				break;
+			case Sub:
+				for (; i < n; i++)
+					out[i] = (integer_t)((uinteger_t)a[i] - (uinteger_t)b[i]);
+				break;
+			case Mul:
+				for (; i < n; i++)
+					out[i] = (integer_t)((uinteger_t)a[i] * (uinteger_t)b[i]);
+				break;
+			case Div:
+				for (; i < n; i++) {
+					if (b[i] == 0)
+						return false;
+					out[i] = b[i] == -1 ? (integer_t)(0 - (uinteger_t)a[i]) : a[i] / b[i];
+				}
+				break;
+			}
+			return true;
+		}
+
+		static bool apply_scalar(arithmetic op, const double* a, const double* b, double* out, size_t n, size_t i) {
+			switch (op) {
+			case Add: for (; i < n; i++) out[i] = a[i] + b[i]; break;
+			case Sub: for (; i < n; i++) out[i] = a[i] - b[i]; break;
+			case Mul: for (; i < n; i++) out[i] = a[i] * b[i]; break;
+			case Div: for (; i < n; i++) out[i] = a[i] / b[i]; break;
+			}
+			return true;
+		}
+
+		template<typename T>
+		static void compare_scalar(comparison cmp, const T* a, const T* b, data::byte* out, size_t n, size_t i) {
+			switch (cmp) {
+			case Equal:			for (; i < n; i++) out[i] = a[i] == b[i]; break;
+			case Less:			for (; i < n; i++) out[i] = a[i] < b[i]; break;
+			case LessEqual:		for (; i < n; i++) out[i] = a[i] <= b[i]; break;
+			case Greater:		for (; i < n; i++) out[i] = a[i] > b[i]; break;
+			case GreaterEqual:	for (; i < n; i++) out[i] = a[i] >= b[i]; break;
+			}
+		}
+
+		// SSE2 ---------------------------------------------------------------
+#ifdef JIFFLE_SSE2
+
+		static __m128i mul_sse2(__m128i x, __m128i y) {
+			// 64 bit product from 32 bit halves (high*high overflows away)
+			auto lo = _mm_mul_epu32(x, y);
+			auto cross = _mm_add_epi64(
+				_mm_mul_epu32(_mm_srli_epi64(x, 32), y),
+				_mm_mul_epu32(x, _mm_srli_epi64(y, 32)));
+			return _mm_add_epi64(lo, _mm_slli_epi64(cross, 32));
+		}
+
+		static size_t apply_sse2(arithmetic op, const integer_t* a, const integer_t* b, integer_t* out, size_t n) {
+			size_t i = 0;
+			if (op == Div)
+				return i; // no vector integer division
+			for (; i + 2 <= n; i += 2) {
+				auto x = _mm_loadu_si128((const __m128i*)(a + i));
+				auto y = _mm_loadu_si128((const __m128i*)(b + i));
+				__m128i r;
+				switch (op) {
+				case Add: r = _mm_add_epi64(x, y); break;
+				case Sub: r = _mm_sub_epi64(x, y); break;
+				default: r = mul_sse2(x, y); break;
+				}
+				_mm_storeu_si128((__m128i*)(out + i), r);
+			}
+			return i;
+		}
+
+		static size_t apply_sse2(arithmetic op, const double* a, const double* b, double* out, size_t n) {
+			size_t i = 0;
+			for (; i + 2 <= n; i += 2) {
+				auto x = _mm_loadu_pd(a + i);
+				auto y = _mm_loadu_pd(b + i);
+				__m128d r;
+				switch (op) {
+				case Add: r = _mm_add_pd(x, y); break;
+				case Sub: r = _mm_sub_pd(x, y); break;
+				case Mul: r = _mm_mul_pd(x, y); break;
+				default: r = _mm_div_pd(x, y); break;
+				}
+				_mm_storeu_pd(out + i, r);
+			}
+			return i;
+		}
+
+		static size_t compare_sse2(comparison cmp, const double* a, const double* b, data::byte* out, size_t n) {
+			size_t i = 0;
+			for (; i + 2 <= n; i += 2) {
+				auto x = _mm_loadu_pd(a + i);
+				auto y = _mm_loadu_pd(b + i);
+				__m128d m;
+				switch (cmp) {
+				case Equal: m = _mm_cmpeq_pd(x, y); break;
+				case Less: m = _mm_cmplt_pd(x, y); break;
+				case LessEqual: m = _mm_cmple_pd(x, y); break;
+				case Greater: m = _mm_cmpgt_pd(x, y); break;
+				default: m = _mm_cmpge_pd(x, y); break;
+				}
+				auto bits = _mm_movemask_pd(m);
+				out[i] = bits & 1;
+				out[i + 1] = (bits >> 1) & 1;
+			}
+			return i;
+		}
+
+		static size_t sum_sse2(const integer_t* a, size_t n, integer_t& acc) {
+			size_t i = 0;
+			auto v = _mm_setzero_si128();
+			for (; i + 2 <= n; i += 2)
+				v = _mm_add_epi64(v, _mm_loadu_si128((const __m128i*)(a + i)));
+			integer_t lanes[2];
+			_mm_storeu_si128((__m128i*)lanes, v);
+			acc = (integer_t)((uinteger_t)lanes[0] + (uinteger_t)lanes[1]);
+			return i;
+		}
+
+		static size_t sum_sse2(const double* a, size_t n, double& acc) {
+			size_t i = 0;
+			auto v = _mm_setzero_pd();
+			for (; i + 2 <= n; i += 2)
+				v = _mm_add_pd(v, _mm_loadu_pd(a + i));
+			double lanes[2];
+			_mm_storeu_pd(lanes, v);
+			acc = lanes[0] + lanes[1];
+			return i;
+		}
+
+		static size_t extreme_sse2(const double* a, size_t n, bool max, double& acc) {
+			if (n < 2)
+				return 0;
+			size_t i = 2;
+			auto v = _mm_loadu_pd(a);
+			auto nan = _mm_cmpunord_pd(v, v);
+			for (; i + 2 <= n; i += 2) {
+				auto x = _mm_loadu_pd(a + i);
+				nan = _mm_or_pd(nan, _mm_cmpunord_pd(x, x));
+				v = max ? _mm_max_pd(v, x) : _mm_min_pd(v, x);
+			}
+			double lanes[2];
+			_mm_storeu_pd(lanes, v);
+			acc = _mm_movemask_pd(nan) ? std::numeric_limits<double>::quiet_NaN()
+				: max ? (lanes[0] > lanes[1] ? lanes[0] : lanes[1])
+				: (lanes[0] < lanes[1] ? lanes[0] : lanes[1]);
+			return i;
+		}
+
+		static size_t fill_sse2(const range& r, integer_t* out, size_t n) {
+			size_t i = 0;
+			auto s = (uinteger_t)r.step;
+			auto v = _mm_set_epi64x((integer_t)((uinteger_t)r.first + s), r.first);
+			auto inc = _mm_set1_epi64x((integer_t)(s * 2));
+			for (; i + 2 <= n; i += 2) {
+				_mm_storeu_si128((__m128i*)(out + i), v);
+				v = _mm_add_epi64(v, inc);
+			}
+			return i;
+		}
+
+#endif
+		// AVX2 ---------------------------------------------------------------
+#ifdef JIFFLE_AVX2
+
+		JIFFLE_TARGET_AVX2 static __m256i mul_avx2(__m256i x, __m256i y) {
+			auto lo = _mm256_mul_epu32(x, y);
+			auto cross = _mm256_add_epi64(
+				_mm256_mul_epu32(_mm256_srli_epi64(x, 32), y),
+				_mm256_mul_epu32(x, _mm256_srli_epi64(y, 32)));
+			return _mm256_add_epi64(lo, _mm256_slli_epi64(cross, 32));
+		}
+
+		JIFFLE_TARGET_AVX2 static size_t apply_avx2(arithmetic op, const integer_t* a, const integer_t* b, integer_t* out, size_t n) {
+			size_t i = 0;
+			if (op == Div)
+				return i;
+			for (; i + 4 <= n; i += 4) {
+				auto x = _mm256_loadu_si256((const __m256i*)(a + i));
+				auto y = _mm256_loadu_si256((const __m256i*)(b + i));
+				__m256i r;
+				switch (op) {
+				case Add: r = _mm256_add_epi64(x, y); break;
+				case Sub: r = _mm256_sub_epi64(x, y); break;
+				default: r = mul_avx2(x, y); break;
+				}
+				_mm256_storeu_si256((__m256i*)(out + i), r);
+			}
+			return i;
+		}
+
+		JIFFLE_TARGET_AVX2 static size_t apply_avx2(arithmetic op, const double* a, const double* b, double* out, size_t n) {
+			size_t i = 0;
+			for (; i + 4 <= n; i += 4) {
+				auto x = _mm256_loadu_pd(a + i);
+				auto y = _mm256_loadu_pd(b + i);
+				__m256d r;
+				switch (op) {
+				case Add: r = _mm256_add_pd(x, y); break;
+				case Sub: r = _mm256_sub_pd(x, y); break;
+				case Mul: r = _mm256_mul_pd(x, y); break;
+				default: r = _mm256_div_pd(x, y); break;
+				}
+				_mm256_storeu_pd(out + i, r);
+			}
+			return i;
+		}
+
+		JIFFLE_TARGET_AVX2 static size_t compare_avx2(comparison cmp, const integer_t* a, const integer_t* b, data::byte* out, size_t n) {
+			size_t i = 0;
+			for (; i + 4 <= n; i += 4) {
+				auto x = _mm256_loadu_si256((const __m256i*)(a + i));
+				auto y = _mm256_loadu_si256((const __m256i*)(b + i));
+				__m256i m;
+				int invert = 0;
+				switch (cmp) {
+				case Equal: m = _mm256_cmpeq_epi64(x, y); break;
+				case Less: m = _mm256_cmpgt_epi64(y, x); break;
+				case LessEqual: m = _mm256_cmpgt_epi64(x, y); invert = 0xF; break;
+				case Greater: m = _mm256_cmpgt_epi64(x, y); break;
+				default: m = _mm256_cmpgt_epi64(y, x); invert = 0xF; break;
+				}
+				auto bits = _mm256_movemask_pd(_mm256_castsi256_pd(m)) ^ invert;
+				for (int k = 0; k < 4; k++)
+					out[i + k] = (bits >> k) & 1;
+			}
+			return i;
+		}
+
+		JIFFLE_TARGET_AVX2 static size_t compare_avx2(comparison cmp, const double* a, const double* b, data::byte* out, size_t n) {
+			size_t i = 0;
+			for (; i + 4 <= n; i += 4) {
+				auto x = _mm256_loadu_pd(a + i);
+				auto y = _mm256_loadu_pd(b + i);
+				__m256d m;
+				switch (cmp) {
+				case Equal: m = _mm256_cmp_pd(x, y, _CMP_EQ_OQ); break;
+				case Less: m = _mm256_cmp_pd(x, y, _CMP_LT_OQ); break;
+				case LessEqual: m = _mm256_cmp_pd(x, y, _CMP_LE_OQ); break;
+				case Greater: m = _mm256_cmp_pd(x, y, _CMP_GT_OQ); break;
+				default: m = _mm256_cmp_pd(x, y, _CMP_GE_OQ); break;
+				}
+				auto bits = _mm256_movemask_pd(m);
+				for (int k = 0; k < 4; k++)
+					out[i + k] = (bits >> k) & 1;
+			}
+			return i;
+		}
+
+		JIFFLE_TARGET_AVX2 static size_t sum_avx2(const integer_t* a, size_t n, integer_t& acc) {
+			size_t i = 0;
+			auto v = _mm256_setzero_si256();
+			for (; i + 4 <= n; i += 4)
+				v = _mm256_add_epi64(v, _mm256_loadu_si256((const __m256i*)(a + i)));
+			integer_t lanes[4];
+			_mm256_storeu_si256((__m256i*)lanes, v);
+			acc = (integer_t)((uinteger_t)lanes[0] + (uinteger_t)lanes[1]
+				+ (uinteger_t)lanes[2] + (uinteger_t)lanes[3]);
+			return i;
+		}
+
+		JIFFLE_TARGET_AVX2 static size_t sum_avx2(const double* a, size_t n, double& acc) {
+			size_t i = 0;
+			auto v = _mm256_setzero_pd();
+			for (; i + 4 <= n; i += 4)
+				v = _mm256_add_pd(v, _mm256_loadu_pd(a + i));
+			double lanes[4];
+			_mm256_storeu_pd(lanes, v);
+			acc = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+			return i;
+		}
+
+		JIFFLE_TARGET_AVX2 static size_t extreme_avx2(const integer_t* a, size_t n, bool max, integer_t& acc) {
+			if (n < 4)
+				return 0;
+			size_t i = 4;
+			auto v = _mm256_loadu_si256((const __m256i*)a);
+			for (; i + 4 <= n; i += 4) {
+				auto x = _mm256_loadu_si256((const __m256i*)(a + i));
+				auto gt = max ? _mm256_cmpgt_epi64(x, v) : _mm256_cmpgt_epi64(v, x);
+				v = _mm256_blendv_epi8(v, x, gt);
+			}
+			integer_t lanes[4];
+			_mm256_storeu_si256((__m256i*)lanes, v);
+			acc = lanes[0];
+			for (int k = 1; k < 4; k++)
+				if (max ? lanes[k] > acc : lanes[k] < acc)
+					acc = lanes[k];
+			return i;
+		}
+
+		JIFFLE_TARGET_AVX2 static size_t extreme_avx2(const double* a, size_t n, bool max, double& acc) {
+			if (n < 4)
+				return 0;
+			size_t i = 4;
+			auto v = _mm256_loadu_pd(a);
+			auto nan = _mm256_cmp_pd(v, v, _CMP_UNORD_Q);
+			for (; i + 4 <= n; i += 4) {
+				auto x = _mm256_loadu_pd(a + i);
+				nan = _mm256_or_pd(nan, _mm256_cmp_pd(x, x, _CMP_UNORD_Q));
+				v = max ? _mm256_max_pd(v, x) : _mm256_min_pd(v, x);
+			}
+			double lanes[4];
+			_mm256_storeu_pd(lanes, v);
+			acc = lanes[0];
+			for (int k = 1; k < 4; k++)
+				if (max ? lanes[k] > acc : lanes[k] < acc)
+					acc = lanes[k];
+			if (_mm256_movemask_pd(nan))
+				acc = std::numeric_limits<double>::quiet_NaN();
+			return i;
+		}
+
+		JIFFLE_TARGET_AVX2 static size_t fill_avx2(const range& r, integer_t* out, size_t n) {
+			size_t i = 0;
+			auto f = (uinteger_t)r.first, s = (uinteger_t)r.step;
+			auto v = _mm256_set_epi64x((integer_t)(f + s * 3), (integer_t)(f + s * 2), (integer_t)(f + s), (integer_t)f);
+			auto inc = _mm256_set1_epi64x((integer_t)(s * 4));
+			for (; i + 4 <= n; i += 4) {
+				_mm256_storeu_si256((__m256i*)(out + i), v);
+				v = _mm256_add_epi64(v, inc);
+			}
+			return i;
+		}
+
+#endif
+		// dispatch -----------------------------------------------------------
+
+		bool apply(arithmetic op, const integer_t* a, const integer_t* b, integer_t* out, size_t n) {
+			auto level = kernels();
+			size_t i = 0;
+#ifdef JIFFLE_AVX2
+			if (level == AVX2)
+				i = apply_avx2(op, a, b, out, n);
+#endif
+#ifdef JIFFLE_SSE2
+			if (level == SSE2)
+				i = apply_sse2(op, a, b, out, n);
+#endif
+			return apply_scalar(op, a, b, out, n, i);
+		}
+
+		bool apply(arithmetic op, const double* a, const double* b, double* out, size_t n) {
+			auto level = kernels();
+			size_t i = 0;
+#ifdef JIFFLE_AVX2
+			if (level == AVX2)
+				i = apply_avx2(op, a, b, out, n);
+#endif
+#ifdef JIFFLE_SSE2
+			if (level == SSE2)
+				i = apply_sse2(op, a, b, out, n);
+#endif
+			return apply_scalar(op, a, b, out, n, i);
+		}
+
+		bool apply(arithmetic op, data::type t, const void* a, const void* b, void* out, size_t n) {
+			switch (t) {
+			case data::Integer:
+				return apply(op, (const integer_t*)a, (const integer_t*)b, (integer_t*)out, n);
+			case data::Real:
+				return apply(op, (const double*)a, (const double*)b, (double*)out, n);
+			default:
+				return false;
+			}
+		}
+
+		void compare(comparison cmp, const integer_t* a, const integer_t* b, data::byte* out, size_t n) {
+			auto level = kernels();
+			size_t i = 0;
+#ifdef JIFFLE_AVX2
+			if (level == AVX2)
+				i = compare_avx2(cmp, a, b, out, n);
+#endif
+			compare_scalar(cmp, a, b, out, n, i); // no 64 bit compare in SSE2
+		}
+
+		void compare(comparison cmp, const double* a, const double* b, data::byte* out, size_t n) {
+			auto level = kernels();
+			size_t i = 0;
+#ifdef JIFFLE_AVX2
+			if (level == AVX2)
+				i = compare_avx2(cmp, a, b, out, n);
+#endif
+#ifdef JIFFLE_SSE2
+			if (level == SSE2)
+				i = compare_sse2(cmp, a, b, out, n);
+#endif
+			compare_scalar(cmp, a, b, out, n, i);
+		}
+
+		integer_t sum(const integer_t* a, size_t n) {
+			auto level = kernels();
+			size_t i = 0;
+			integer_t acc = 0;
+#ifdef JIFFLE_AVX2
+			if (level == AVX2)
+				i = sum_avx2(a, n, acc);
+#endif
+#ifdef JIFFLE_SSE2
+			if (level == SSE2)
+				i = sum_sse2(a, n, acc);
+#endif
+			for (; i < n; i++)
+				acc = (integer_t)((uinteger_t)acc + (uinteger_t)a[i]);
+			return acc;
+		}
+
+		double sum(const double* a, size_t n) {
+			auto level = kernels();
+			size_t i = 0;
+			double acc = 0;
+#ifdef JIFFLE_AVX2
+			if (level == AVX2)
+				i = sum_avx2(a, n, acc);
+#endif
+#ifdef JIFFLE_SSE2
+			if (level == SSE2)
+				i = sum_sse2(a, n, acc);
+#endif
+			for (; i < n; i++)
+				acc += a[i];
+			return acc;
+		}
+
+		template<typename T>
+		static T extreme(const T* a, size_t n, bool max) {
+			auto level = kernels();
+			size_t i = 1;
+			T acc = a[0];
+#ifdef JIFFLE_AVX2
+			if (level == AVX2 && n >= 4)
+				i = extreme_avx2(a, n, max, acc);
+#endif
+			for (; i < n; i++)
+				if (max ? a[i] > acc : a[i] < acc)
+					acc = a[i];
+			return acc;
+		}
+
+		// NaN anywhere gives NaN, on every instruction set
+		template<>
+		double extreme(const double* a, size_t n, bool max) {
+			auto level = kernels();
+			size_t i = 1;
+			double acc = a[0];
+#ifdef JIFFLE_AVX2
+			if (level == AVX2 && n >= 4)
+				i = extreme_avx2(a, n, max, acc);
+#endif
+#ifdef JIFFLE_SSE2
+			if (level == SSE2 && n >= 2)
+				i = extreme_sse2(a, n, max, acc);
+#endif
+			if (acc != acc)
+				return acc;
+			for (; i < n; i++) {
+				if (a[i] != a[i])
+					return a[i];
+				if (max ? a[i] > acc : a[i] < acc)
+					acc = a[i];
+			}
+			return acc;
+		}
+
+		integer_t minimum(const integer_t* a, size_t n) {
+			return extreme(a, n, false);
+		}
+
+		double minimum(const double* a, size_t n) {
+			return extreme(a, n, false);
+		}
+
+		integer_t maximum(const integer_t* a, size_t n) {
+			return extreme(a, n, true);
+		}
+
+		double maximum(const double* a, size_t n) {
+			return extreme(a, n, true);
+		}
+
+		void fill(const range& r, integer_t* out) {
+			auto level = kernels();
+			auto n = size(r);
+			size_t i = 0;
+#ifdef JIFFLE_AVX2
+			if (level == AVX2)
+				i = fill_avx2(r, out, n);
+#endif
+#ifdef JIFFLE_SSE2
+			if (level == SSE2)
+				i = fill_sse2(r, out, n);
+#endif
+			for (; i < n; i++)
+				out[i] = at(r, i);
+		}
+
+		std::vector<integer_t> materialize(const range& r) {
+			std::vector<integer_t> out(size(r));
+			if (!out.empty())
+				fill(r, &out[0]);
+			return out;
+		}
+
+	}
+}
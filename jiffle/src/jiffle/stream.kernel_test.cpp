@@ -0,0 +1,140 @@
+#include "stream.h"
+#include <assert.h>
+#include <limits>
+
+namespace jiffle {
+	namespace stream {
+
+		void kernel_test() {
+			using data::integer_t;
+
+			// internal state -------------------------------------------------
+			std::vector<integer_t> _ia, _ib, _iout;
+			std::vector<double> _ra, _rb, _rout;
+			std::vector<data::byte> _flags;
+			uint64_t _seed = 0x2545F4914F6CDD1D;
+
+			// methods --------------------------------------------------------
+			auto random = [&]() {
+				_seed ^= _seed << 13;
+				_seed ^= _seed >> 7;
+				_seed ^= _seed << 17;
+				return _seed;
+			};
+			auto set = [&](size_t n) {
+				_ia.resize(n); _ib.resize(n); _iout.resize(n + 1);
+				_ra.resize(n); _rb.resize(n); _rout.resize(n + 1);
+				_flags.resize(n + 1);
+				for (size_t i = 0; i < n; i++) {
+					_ia[i] = (integer_t)random();
+					_ib[i] = i % 3 ? (integer_t)random() : _ia[i]; // some equal pairs
+					_ra[i] = (double)(integer_t)(random() % 2001) - 1000.0;
+					_rb[i] = i % 3 ? (double)(integer_t)(random() % 2001) - 1000.5 : _ra[i];
+				}
+			};
+			auto wrap = [](uint64_t v) { return (integer_t)v; };
+
+			// tests ----------------------------------------------------------
+
+			simd levels[] = { Scalar, SSE2, AVX2 };
+			for (auto level : levels) {
+				kernels(level);
+				assert(kernels() <= level);
+
+				for (size_t n = 0; n < 38; n++) {
+					set(n);
+					auto ia = n ? &_ia[0] : nullptr;
+					auto ib = n ? &_ib[0] : nullptr;
+					auto ra = n ? &_ra[0] : nullptr;
+					auto rb = n ? &_rb[0] : nullptr;
+
+					// integer arithmetic (wrapping)
+					assert(apply(Add, ia, ib, &_iout[0], n));
+					for (size_t i = 0; i < n; i++)
+						assert(_iout[i] == wrap((uint64_t)_ia[i] + (uint64_t)_ib[i]));
+					assert(apply(Sub, ia, ib, &_iout[0], n));
+					for (size_t i = 0; i < n; i++)
+						assert(_iout[i] == wrap((uint64_t)_ia[i] - (uint64_t)_ib[i]));
+					assert(apply(Mul, ia, ib, &_iout[0], n));
+					for (size_t i = 0; i < n; i++)
+						assert(_iout[i] == wrap((uint64_t)_ia[i] * (uint64_t)_ib[i]));
+					assert(apply(Div, ia, ib, &_iout[0], n));
+					for (size_t i = 0; i < n; i++)
+						assert(_iout[i] == _ia[i] / _ib[i]);
+
+					// real arithmetic
+					assert(apply(Add, ra, rb, &_rout[0], n));
+					for (size_t i = 0; i < n; i++)
+						assert(_rout[i] == _ra[i] + _rb[i]);
+					assert(apply(Mul, data::Real, ra, rb, &_rout[0], n));
+					for (size_t i = 0; i < n; i++)
+						assert(_rout[i] == _ra[i] * _rb[i]);
+					assert(apply(Div, ra, rb, &_rout[0], n));
+					for (size_t i = 0; i < n; i++)
+						assert(_rout[i] == _ra[i] / _rb[i]);
+
+					// comparisons
+					compare(Less, ia, ib, &_flags[0], n);
+					for (size_t i = 0; i < n; i++)
+						assert(_flags[i] == (_ia[i] < _ib[i]));
+					compare(GreaterEqual, ia, ib, &_flags[0], n);
+					for (size_t i = 0; i < n; i++)
+						assert(_flags[i] == (_ia[i] >= _ib[i]));
+					compare(Equal, ra, rb, &_flags[0], n);
+					for (size_t i = 0; i < n; i++)
+						assert(_flags[i] == (_ra[i] == _rb[i]));
+					compare(LessEqual, ra, rb, &_flags[0], n);
+					for (size_t i = 0; i < n; i++)
+						assert(_flags[i] == (_ra[i] <= _rb[i]));
+
+					// reductions
+					uint64_t isum = 0;
+					double rsum = 0;
+					for (size_t i = 0; i < n; i++) {
+						isum += (uint64_t)_ia[i];
+						rsum += _ra[i];
+					}
+					assert(sum(ia, n) == wrap(isum));
+					assert(sum(ra, n) == rsum); // exact, small integral values
+					if (n) {
+						integer_t imin = _ia[0], imax = _ia[0];
+						double rmin = _ra[0], rmax = _ra[0];
+						for (size_t i = 1; i < n; i++) {
+							imin = _ia[i] < imin ? _ia[i] : imin;
+							imax = _ia[i] > imax ? _ia[i] : imax;
+							rmin = _ra[i] < rmin ? _ra[i] : rmin;
+							rmax = _ra[i] > rmax ? _ra[i] : rmax;
+						}
+						assert(minimum(ia, n) == imin && maximum(ia, n) == imax);
+						assert(minimum(ra, n) == rmin && maximum(ra, n) == rmax);
+					}
+				}
+
+				// NaN anywhere, in a vector lane or the scalar tail, is the extreme
+				for (size_t n = 1; n < 12; n++)
+					for (size_t at = 0; at < n; at++) {
+						std::vector<double> r(n, 1.0);
+						r[at] = std::numeric_limits<double>::quiet_NaN();
+						auto lo = minimum(&r[0], n), hi = maximum(&r[0], n);
+						assert(lo != lo && hi != hi);
+					}
+
+				// division by zero falls back to the generic path
+				integer_t a[] = { 1, 2, 3 }, b[] = { 1, 0, 1 }, out[3];
+				assert(!apply(Div, a, b, out, 3));
+				assert(!apply(Add, data::String, a, b, out, 3));
+
+				// range generation
+				auto values = materialize(range{ 0, 9, 1 });
+				assert(values == std::vector<integer_t>({ 0,1,2,3,4,5,6,7,8,9 }));
+				values = materialize(range{ 'f', 'a', -1 });
+				assert(values == std::vector<integer_t>({ 'f','e','d','c','b','a' }));
+				values = materialize(range{ 1, 0, 1 });
+				assert(values.empty());
+			}
+
+			kernels(AVX2); // restore best supported
+		}
+
+	}
+}
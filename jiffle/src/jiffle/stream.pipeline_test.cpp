@@ -0,0 +1,103 @@
+#include "stream.h"
+#include <assert.h>
+
+namespace jiffle {
+	namespace stream {
+
+		void pipeline_test() {
+			using data::integer_t;
+
+			// internal state -------------------------------------------------
+			std::vector<integer_t> _values;
+
+			// methods --------------------------------------------------------
+			auto collect = [&](const std::vector<integer_t>& batch) {
+				_values.insert(_values.end(), batch.begin(), batch.end());
+			};
+			auto total = [&]() {
+				integer_t s = 0;
+				for (auto v : _values)
+					s += v;
+				return s;
+			};
+
+			// tests ----------------------------------------------------------
+
+			{ // ring: bounded, in order
+				ring<integer_t> r(5); // rounded up to 8
+				integer_t in[10] = { 0,1,2,3,4,5,6,7,8,9 }, out[10];
+				assert(r.push(in, 10) == 8);
+				assert(r.push(in, 1) == 0);
+				assert(r.pop(out, 3) == 3 && out[0] == 0 && out[2] == 2);
+				assert(r.push(in + 8, 2) == 2);
+				assert(r.pop(out, 10) == 7 && out[0] == 3 && out[6] == 9);
+				assert(r.pop(out, 1) == 0);
+			}
+			{ // queue: bounded, many producers and consumers
+				queue<integer_t> q(8);
+				integer_t in[10] = { 0,1,2,3,4,5,6,7,8,9 }, out[10];
+				assert(q.push(in, 10) == 8);
+				assert(q.pop(out, 10) == 8 && out[7] == 7);
+				assert(q.pop(out, 1) == 0);
+
+				queue<integer_t> shared(64);
+				const integer_t N = 100000;
+				std::atomic<integer_t> sum(0), count(0);
+				std::vector<std::thread> threads;
+				for (integer_t p = 0; p < 4; p++) {
+					threads.emplace_back([&, p]() {
+						for (integer_t i = p; i < N; i += 4)
+							while (!shared.push(&i, 1))
+								std::this_thread::yield();
+					});
+				}
+				for (int c = 0; c < 4; c++) {
+					threads.emplace_back([&]() {
+						integer_t batch[16];
+						while (count.load() < N) {
+							auto n = shared.pop(batch, 16);
+							if (n == 0)
+								std::this_thread::yield();
+							for (size_t i = 0; i < n; i++)
+								sum += batch[i];
+							count += n;
+						}
+					});
+				}
+				for (auto& t : threads)
+					t.join();
+				assert(count == N && sum == N * (N - 1) / 2);
+			}
+			{ // single worker stages keep order
+				pipeline<integer_t>(16)
+					.stage([](std::vector<integer_t>& b) { for (auto& x : b) x *= 2; })
+					.stage([](std::vector<integer_t>& b) { for (auto& x : b) x += 1; })
+					.run(from({ 0,9999,1 }).begin(), collect);
+				assert(_values.size() == 10000);
+				for (integer_t i = 0; i < 10000; i++)
+					assert(_values[i] == i * 2 + 1);
+			}
+			{ // replicated stages, filtering, small channels (backpressure)
+				_values.clear();
+				pipeline<integer_t>(64)
+					.stage([](std::vector<integer_t>& b) {
+						std::vector<integer_t> odd;
+						for (auto x : b)
+							if (x % 2)
+								odd.push_back(x);
+						b.swap(odd);
+					}, 4)
+					.stage([](std::vector<integer_t>& b) { for (auto& x : b) x *= 3; }, 3)
+					.run(from({ 1,100000,1 }).begin(), collect);
+				assert(_values.size() == 50000);
+				assert(total() == 3 * (integer_t)50000 * 50000);
+			}
+			{ // no stages, empty source
+				_values.clear();
+				pipeline<integer_t>().run(from({ 1,0,1 }).begin(), collect);
+				assert(_values.empty());
+			}
+		}
+
+	}
+}
@@ -0,0 +1,42 @@
+#include "stream.h"
+
+namespace jiffle {
+	namespace stream {
+
+		size_t size(const range& r) {
+			if (r.step == 0)
+				return 0;
+			if (r.step > 0 && r.first > r.last)
+				return 0;
+			if (r.step < 0 && r.first < r.last)
+				return 0;
+			// unsigned, a span may not fit in a signed integer
+			auto span = r.step > 0 ? (uint64_t)r.last - (uint64_t)r.first : (uint64_t)r.first - (uint64_t)r.last;
+			auto step = r.step > 0 ? (uint64_t)r.step : 0 - (uint64_t)r.step;
+			auto steps = span / step;
+			return steps >= SIZE_MAX ? SIZE_MAX : (size_t)steps + 1;
+		}
+
+		data::integer_t at(const range& r, size_t index) {
+			return (data::integer_t)((uint64_t)r.first + (uint64_t)index * (uint64_t)r.step);
+		}
+
+		sequence<data::integer_t> from(const range& r) {
+			sequence<data::integer_t> s;
+			auto n = size(r);
+			s.begin = [r, n]() -> cursor<data::integer_t> {
+				size_t i = 0;
+				return [r, n, i](data::integer_t& v) mutable {
+					if (i >= n)
+						return false;
+					v = at(r, i++);
+					return true;
+				};
+			};
+			s.at = [r](size_t i) { return at(r, i); };
+			s.count = n;
+			return s;
+		}
+
+	}
+}
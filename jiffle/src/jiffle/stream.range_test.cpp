@@ -0,0 +1,73 @@
+#include "stream.h"
+#include <assert.h>
+
+namespace jiffle {
+	namespace stream {
+
+		void range_test() {
+			using data::integer_t;
+
+			// internal state -------------------------------------------------
+			std::vector<integer_t> _values;
+
+			// methods --------------------------------------------------------
+			auto assert_values = [&](const std::vector<integer_t>& v) {
+				assert(_values == v);
+			};
+
+			// tests ----------------------------------------------------------
+
+			// size
+			assert(size({ 0,9,1 }) == 10);
+			assert(size({ 'a','f',1 }) == 6);
+			assert(size({ 5,1,-2 }) == 3);
+			assert(size({ 1,0,1 }) == 0);
+			assert(size({ 1,5,0 }) == 0);
+
+			// spans wider than the signed range
+			assert(size({ INT64_MIN,INT64_MAX,INT64_MAX }) == 3);
+			assert(size({ INT64_MAX,INT64_MIN,INT64_MIN }) == 2);
+			assert(size({ INT64_MIN,INT64_MAX,1 }) == SIZE_MAX);
+			assert(at({ INT64_MIN,INT64_MAX,INT64_MAX }, 2) == INT64_MAX - 1);
+			assert(at({ INT64_MAX,INT64_MIN,INT64_MIN }, 1) == -1);
+
+			// empty
+			_values = materialize(from({ 1,0,1 }));
+			assert_values({});
+
+			// range ( 0..4 )
+			_values = materialize(from({ 0,4,1 }));
+			assert_values({ 0,1,2,3,4 });
+
+			// comprehension ( x*2, x <- 1..5 )
+			auto doubled = map(from({ 1,5,1 }), [](integer_t x) { return x * 2; });
+			_values = materialize(doubled);
+			assert_values({ 2,4,6,8,10 });
+
+			// fused chain, no intermediate sequences
+			auto evensHalved = map(
+				filter(from({ 1,10,1 }), [](integer_t x) { return x % 2 == 0; }),
+				[](integer_t x) { return x / 2; });
+			_values = materialize(evensHalved);
+			assert_values({ 1,2,3,4,5 });
+
+			// indexing huge ranges never materializes
+			integer_t v = 0;
+			auto huge = map(from({ 1,1000000000,1 }), [](integer_t x) { return x * 2; });
+			assert(huge.count == 1000000000);
+			assert(index(huge, 999999999, v) && v == 2000000000);
+			assert(!index(huge, 1000000000, v));
+
+			// indexing through a filter scans
+			auto odd = filter(from({ 0,100,1 }), [](integer_t x) { return x % 2 != 0; });
+			assert(index(odd, 3, v) && v == 7);
+			assert(!index(odd, 50, v));
+
+			// element type can change along the chain
+			auto halves = map(from({ 1,3,1 }), [](integer_t x) { return x * 0.5; });
+			auto reals = materialize(halves);
+			assert(reals.size() == 3 && reals[2] == 1.5);
+		}
+
+	}
+}
@@ -46,15 +46,15 @@ namespace jiffle {
 			ParameterEnd = ']',				// end of arguments group for definitions
 
 			// TODO: parse
-			//Composition = '.',					// composition ('.foo' makes it private to scope)
-			//Specification = ':',				// specification
-			//Variance = '|',						// variance (polymorphism)
+			//Composition = '.',					// composition ('.foo' makes it private to scope), 'a.b' and '.foo' are symbols
+			//Specification = ':',				// specification, 'x:Integer' is a symbol
+			//Variance = '|',						// variance (polymorphism), 'x:Integer|Real' is a symbol
 			//Reference = '&',					// reference a symbol without evaluating
 			//Statefull = '$',					// updateable state
 			//Escape = '\\',						// escape newline separator
 			//Index = '@',						// get index in sequence
 			//Fork = 7,							// '<-' forked abstraction (for each in sequence, original order is maintained)
-			//Range = 8,							// '..' range (variance for numbers and characters) (sequence for list indices)
+			//Range = 8,							// '..' range (variance for numbers and characters) (sequence for list indices), 'b..' is a symbol
 			//Flow = 9,							// '->' flow mapping (if lhs is evaluated, then compute rhs)
 			//Negation = '~',						// negation (variation inversion)
 			//Extern = '%',						// abstract (extern)
@@ -1,4 +1,5 @@
 #include "syntax.h"
+#include "trace.h"
 
 #include <string>
 #include <map>
@@ -7,6 +8,8 @@ namespace jiffle {
 	namespace syntax {
 
 		std::vector<token> tokenize(const std::string & code) {
+			trace::scope span("tokenize", "compile");
+
 			// internal state -------------------------------------------------
 			std::vector<token> _tdata;
 			pos _cur = {}, _start = {};
@@ -49,6 +52,9 @@ namespace jiffle {
 					return c >= '0' && c <= '9';
 				}
 			};
+			auto isOperator = [](char c) {
+				return c == '+' || c == '-' || c == '*' || c == '/' || c == '%';
+			};
 			auto isParticle = [](char c) {
 				switch (static_cast<type>(c)) {
 				case Separator:
@@ -121,9 +127,23 @@ namespace jiffle {
 				}
 
 				// identifier -------------------------------------------------
-				if (isLetter(_c)) {
+				auto isPrivate = _c == '.' && _cur.ch + 1 < code.length() && isLetter(code[_cur.ch + 1]);
+				if (isLetter(_c) || isPrivate) {
+					if (isPrivate) // '.foo'
+						shift();
 					while (isLetter(_c) || isDigit(_c))
 						shift();
+					// composition path 'a.b.c', specification 'x:Integer|Real'
+					while ((_c == '.' || _c == ':' || _c == '|') && _cur.ch + 1 < code.length() && isLetter(code[_cur.ch + 1])) {
+						shift();
+						while (isLetter(_c) || isDigit(_c))
+							shift();
+					}
+					// remaining items pattern 'b..'
+					if (_c == '.' && _cur.ch + 1 < code.length() && code[_cur.ch + 1] == '.') {
+						shift();
+						shift();
+					}
 					auto it = _keywords.find(_buffer);
 
 					// keywords -----------------------------------------------
@@ -135,6 +155,13 @@ namespace jiffle {
 					continue;
 				}
 
+				// arithmetic operator, evaluated as a symbol ------------------
+				if (isOperator(_c)) {
+					shift();
+					push(type::Symbol);
+					continue;
+				}
+
 				// number -----------------------------------------------------
 				if (isDigit(_c)) {
 					auto real = false; // integer by default
@@ -181,15 +208,13 @@ namespace jiffle {
 							shift();
 					}
 
-					// integer 
+					// integer (any size, converted by generate)
 					if (!real) {
-						auto i = _buffer.empty() ? 0 : std::stoll(_buffer, NULL, base);
 						push(type::Integer);
 						continue;
 					}
 					// real 
 					else {
-						auto r = std::stold(_buffer, NULL);
 						push(type::Real);
 						continue;
 					}
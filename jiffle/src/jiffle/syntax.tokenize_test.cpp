@@ -54,6 +54,30 @@ namespace jiffle {
 			assert_token(type::False,						{ 10,5,0,10 });
 			assert_token(type::Symbol,						{ 16,3,0,16 });
 			assert_end();
+			// composition paths
+			set("a.b1.c d. e.1");
+			assert_token(type::Symbol,						{ 0,6,0,0 });
+			assert_token(type::Symbol,						{ 7,1,0,7 });
+			assert_token(type::SyntaxError,					{ 8,1,0,8 });
+			assert_token(type::Symbol,						{ 10,1,0,10 });
+			assert_token(type::SyntaxError,					{ 11,1,0,11 });
+			assert_token(type::Integer,						{ 12,1,0,12 });
+			assert_end();
+			set(".private .a.b");
+			assert_token(type::Symbol,						{ 0,8,0,0 });
+			assert_token(type::Symbol,						{ 9,4,0,9 });
+			assert_end();
+			// specification and operators
+			set("x:Integer*2");
+			assert_token(type::Symbol,						{ 0,9,0,0 });
+			assert_token(type::Symbol,						{ 9,1,0,9 });
+			assert_token(type::Integer,						{ 10,1,0,10 });
+			assert_end();
+			// patterns
+			set("a:Integer|Real b..");
+			assert_token(type::Symbol,						{ 0,14,0,0 });
+			assert_token(type::Symbol,						{ 15,3,0,15 });
+			assert_end();
 			// numbers
 			set("0x 0 999999999999 0XF 0b111 0o111 0x111 3.14 6.02e-23 0.0e-1");
 			assert_token(type::SyntaxError,					{ 0,2,0,0 });
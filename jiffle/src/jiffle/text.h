@@ -0,0 +1,99 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace jiffle {
+	namespace text {
+
+		// strings ------------------------------------------------------------
+
+		// Immutable sequence of characters.
+		// Short strings are stored inline, without allocation. Longer ones are
+		// ropes: height balanced trees over flat leaves, so concatenation is
+		// O(log n) and never copies more than a leaf. The flat form and the
+		// content hash are computed on demand and cached in the shared node.
+		class string {
+		public:
+			static constexpr size_t Inline = 22;	// bytes kept in the string itself
+			static constexpr size_t Leaf = 128;		// bytes merged into one leaf
+
+			string() : _size(0), _inline() {}
+			string(const char* s);
+			string(const char* s, size_t len);
+			string(const std::string& s) : string(s.data(), s.size()) {}
+
+			size_t size() const { return _node ? _node->size : _size; }
+			bool empty() const { return size() == 0; }
+			bool isInline() const { return !_node; }
+
+			// O(log n) on ropes
+			char operator[](size_t i) const;
+
+			string concat(const string& other) const;
+			string operator+(const string& other) const { return concat(other); }
+
+			// contiguous characters, ropes are flattened once
+			const char* data() const;
+			std::string str() const { return std::string(data(), size()); }
+
+			// content hash (FNV-1a), cached on ropes and leaves
+			size_t hash() const;
+
+			// tree height, 0 inline and 1 for a single leaf
+			size_t height() const { return _node ? _node->height : 0; }
+
+			bool operator==(const string& other) const;
+			bool operator!=(const string& other) const { return !(*this == other); }
+			bool operator==(const std::string& other) const { return *this == string(other); }
+			bool operator!=(const std::string& other) const { return !(*this == other); }
+
+		private:
+			struct node;
+			typedef std::shared_ptr<const node> ptr;
+
+			struct node {
+				unsigned char height;
+				size_t size;
+				ptr left, right;					// inner node
+				std::string bytes;					// leaf
+				mutable std::once_flag flattened;
+				mutable std::string flat;			// inner node, once flattened
+				mutable std::atomic<size_t> hash;	// 0 until computed
+			};
+
+			ptr _node;
+			unsigned char _size;
+			char _inline[Inline];
+
+			friend string intern(const char* s, size_t len);
+
+			explicit string(ptr n) : _node(n), _size(0) {}
+
+			static size_t depth(const ptr& n) { return n ? n->height : 0; }
+			static ptr leaf(std::string&& bytes);
+			static ptr inner(const ptr& l, const ptr& r);
+			static ptr balance(const ptr& l, const ptr& r);
+			static ptr join(const ptr& l, const ptr& r);
+			ptr toNode() const;
+		};
+
+		// functions ----------------------------------------------------------
+
+		// FNV-1a, continued from seed
+		size_t hash(const char* s, size_t len, size_t seed = 14695981039346656037ull);
+
+		// shared copy of equal content, equal interned strings share their
+		// node and compare in O(1); inline strings are returned as is
+		string intern(const char* s, size_t len);
+		string intern(const string& s);
+
+		// tests --------------------------------------------------------------
+
+		void string_test();
+
+	}
+}
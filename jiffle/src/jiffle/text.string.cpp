@@ -0,0 +1,217 @@
+#include "text.h"
+
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+namespace jiffle {
+	namespace text {
+
+		// intern table is weak, unused strings are released by their owners
+		static std::mutex _mutex;
+		static std::unordered_multimap<size_t, std::weak_ptr<const void>> _interned;
+		static size_t _sweep = 64;
+
+		size_t hash(const char* s, size_t len, size_t seed) {
+			for (size_t i = 0; i < len; i++) {
+				seed ^= (unsigned char)s[i];
+				seed *= 1099511628211ull;
+			}
+			return seed;
+		}
+
+		// nodes --------------------------------------------------------------
+
+		string::ptr string::leaf(std::string&& bytes) {
+			if (bytes.empty())
+				return nullptr;
+			auto n = std::make_shared<node>();
+			n->height = 1;
+			n->size = bytes.size();
+			n->bytes = std::move(bytes);
+			n->hash = 0;
+			return n;
+		}
+
+		string::ptr string::inner(const ptr& l, const ptr& r) {
+			auto n = std::make_shared<node>();
+			n->height = (unsigned char)((depth(l) > depth(r) ? depth(l) : depth(r)) + 1);
+			n->size = l->size + r->size;
+			n->left = l;
+			n->right = r;
+			n->hash = 0;
+			return n;
+		}
+
+		// joins subtrees whose heights differ by at most 2
+		string::ptr string::balance(const ptr& l, const ptr& r) {
+			if (depth(l) > depth(r) + 1) {
+				if (depth(l->left) >= depth(l->right))
+					return inner(l->left, inner(l->right, r));
+				return inner(inner(l->left, l->right->left), inner(l->right->right, r));
+			}
+			if (depth(r) > depth(l) + 1) {
+				if (depth(r->right) >= depth(r->left))
+					return inner(inner(l, r->left), r->right);
+				return inner(inner(l, r->left->left), inner(r->left->right, r->right));
+			}
+			return inner(l, r);
+		}
+
+		// concatenation, descends the spine of the taller tree,
+		// small leaves at the seam are merged
+		string::ptr string::join(const ptr& l, const ptr& r) {
+			if (!l)
+				return r;
+			if (!r)
+				return l;
+			if (l->height == 1 && r->height == 1 && l->size + r->size <= Leaf)
+				return leaf(l->bytes + r->bytes);
+			if (depth(l) > depth(r) + 1)
+				return balance(l->left, join(l->right, r));
+			if (depth(r) > depth(l) + 1)
+				return balance(join(l, r->left), r->right);
+			return inner(l, r);
+		}
+
+		string::ptr string::toNode() const {
+			return _node ? _node : leaf(std::string(_inline, _size));
+		}
+
+		// strings ------------------------------------------------------------
+
+		string::string(const char* s) : string(s, strlen(s)) {}
+
+		string::string(const char* s, size_t len) : _size(0) {
+			if (len <= Inline) {
+				memcpy(_inline, s, len);
+				_size = (unsigned char)len;
+			}
+			else {
+				_node = leaf(std::string(s, len));
+			}
+		}
+
+		char string::operator[](size_t i) const {
+			if (!_node)
+				return _inline[i];
+			auto n = _node.get();
+			while (n->height > 1) {
+				if (i < n->left->size) {
+					n = n->left.get();
+				} else {
+					i -= n->left->size;
+					n = n->right.get();
+				}
+			}
+			return n->bytes[i];
+		}
+
+		string string::concat(const string& other) const {
+			auto total = size() + other.size();
+			if (total <= Inline) {
+				string out;
+				memcpy(out._inline, data(), size());
+				memcpy(out._inline + size(), other.data(), other.size());
+				out._size = (unsigned char)total;
+				return out;
+			}
+			return string(join(empty() ? nullptr : toNode(), other.empty() ? nullptr : other.toNode()));
+		}
+
+		const char* string::data() const {
+			if (!_node)
+				return _inline;
+			if (_node->height == 1)
+				return _node->bytes.data();
+			auto n = _node.get();
+			std::call_once(n->flattened, [n]() {
+				std::string flat;
+				flat.reserve(n->size);
+				// leaves left to right, without recursion
+				std::vector<const node*> stack = { n };
+				while (!stack.empty()) {
+					auto x = stack.back();
+					stack.pop_back();
+					if (x->height == 1) {
+						flat += x->bytes;
+						continue;
+					}
+					stack.push_back(x->right.get());
+					stack.push_back(x->left.get());
+				}
+				n->flat = std::move(flat);
+			});
+			return n->flat.data();
+		}
+
+		size_t string::hash() const {
+			if (!_node)
+				return text::hash(_inline, _size);
+			auto h = _node->hash.load(std::memory_order_relaxed);
+			if (!h) {
+				// over the leaves, no need to flatten
+				h = 14695981039346656037ull;
+				std::vector<const node*> stack = { _node.get() };
+				while (!stack.empty()) {
+					auto x = stack.back();
+					stack.pop_back();
+					if (x->height == 1) {
+						h = text::hash(x->bytes.data(), x->bytes.size(), h);
+						continue;
+					}
+					stack.push_back(x->right.get());
+					stack.push_back(x->left.get());
+				}
+				_node->hash.store(h, std::memory_order_relaxed);
+			}
+			return h;
+		}
+
+		bool string::operator==(const string& other) const {
+			if (size() != other.size())
+				return false;
+			if (_node && _node == other._node)
+				return true;
+			if (_node && other._node) {
+				// cached hashes tell most differences apart
+				auto a = _node->hash.load(std::memory_order_relaxed);
+				auto b = other._node->hash.load(std::memory_order_relaxed);
+				if (a && b && a != b)
+					return false;
+			}
+			return memcmp(data(), other.data(), size()) == 0;
+		}
+
+		// interning ----------------------------------------------------------
+
+		string intern(const char* s, size_t len) {
+			if (len <= string::Inline)
+				return string(s, len);
+			auto h = hash(s, len);
+			std::lock_guard<std::mutex> lock(_mutex);
+			auto range = _interned.equal_range(h);
+			for (auto it = range.first; it != range.second; ++it) {
+				auto n = std::static_pointer_cast<const string::node>(it->second.lock());
+				if (n && n->size == len && memcmp(string(n).data(), s, len) == 0)
+					return string(n);
+			}
+			if (_interned.size() > _sweep) {
+				for (auto it = _interned.begin(); it != _interned.end();)
+					it = it->second.expired() ? _interned.erase(it) : std::next(it);
+				_sweep = _interned.size() * 2 > 64 ? _interned.size() * 2 : 64;
+			}
+			string out(s, len);
+			out._node->hash = h;
+			_interned.emplace(h, out._node);
+			return out;
+		}
+
+		string intern(const string& s) {
+			if (s.isInline())
+				return s;
+			return intern(s.data(), s.size());
+		}
+
+	}
+}
@@ -0,0 +1,74 @@
+#include "text.h"
+#include <assert.h>
+#include <cstring>
+#include <vector>
+
+namespace jiffle {
+	namespace text {
+
+		void string_test() {
+			// internal state -------------------------------------------------
+			string _s;
+
+			// methods --------------------------------------------------------
+			auto assert_balanced = [](const string& s) {
+				// leaves of at least one byte, AVL height bound ~1.44 log2 n
+				size_t bound = 2;
+				for (auto n = s.size(); n; n >>= 1)
+					bound += 2;
+				assert(s.height() <= bound);
+			};
+
+			// tests ----------------------------------------------------------
+
+			{ // inline
+				assert(_s.empty() && _s.isInline());
+				string a = "hello", b = " world";
+				auto c = a + b;
+				assert(c.isInline() && c == std::string("hello world"));
+				assert(c.hash() == hash("hello world", 11));
+				assert(string(std::string(string::Inline + 1, 'x')).height() == 1);
+			}
+			{ // appending builds a balanced rope, every version remains valid
+				std::string expected;
+				std::vector<string> versions;
+				for (int i = 0; i < 5000; i++) {
+					versions.push_back(_s);
+					auto piece = std::to_string(i) + ",";
+					_s = _s + piece;
+					expected += piece;
+				}
+				assert(_s.size() == expected.size() && _s.str() == expected);
+				assert_balanced(_s);
+				for (size_t i = 0; i < expected.size(); i += 101)
+					assert(_s[i] == expected[i]);
+				assert(versions[10] == std::string("0,1,2,3,4,5,6,7,8,9,"));
+
+				// leaves are merged at the seams, not one per piece
+				assert(_s.height() < 16);
+
+				// hash over leaves equals hash of flat content
+				assert(_s.hash() == hash(expected.data(), expected.size()));
+			}
+			{ // prepending and equality across shapes
+				string left;
+				for (int i = 4999; i >= 0; i--)
+					left = string(std::to_string(i) + ",") + left;
+				assert_balanced(left);
+				assert(left == _s && left.hash() == _s.hash());
+				assert(left != _s + string("!"));
+				assert(strncmp(left.data(), "0,1,2,", 6) == 0);
+			}
+			{ // interning shares nodes
+				auto text = std::string(100, 'a') + "b";
+				auto a = intern(text.data(), text.size());
+				auto b = intern(string(std::string(100, 'a')) + string("b"));
+				assert(a == b && a.data() == b.data());
+				auto c = intern(std::string(101, 'a').data(), 101);
+				assert(a != c);
+				assert(intern("short", 5).isInline());
+			}
+		}
+
+	}
+}
@@ -0,0 +1,251 @@
+#include "trace.h"
+#include "stream.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace jiffle {
+	namespace trace {
+
+		std::atomic<bool> detail::on(false);
+
+		namespace {
+			struct event {
+				char name[64];
+				const char* category;	// string literals only
+				char phase;				// 'B' or 'E'
+				uint64_t time;			// nanoseconds since start
+			};
+			static const size_t Capacity = 4096;
+			static const auto Interval = std::chrono::milliseconds(5);
+
+			// begun on its thread, an end follows its begin into the file or is dropped with it
+			struct span {
+				event begin;
+				bool recorded;
+			};
+
+			// written only by its thread, drained only by the writer
+			struct buffer {
+				uint32_t thread;
+				stream::ring<event> events;
+				size_t pushed = 0;						// by the thread
+				std::atomic<size_t> popped{ 0 };		// by the writer
+				std::vector<span> open;					// by the thread, read once it's quiet
+				size_t reserved = 0;					// ends owed to recorded begins
+				buffer(uint32_t thread) : thread(thread), events(Capacity) {}
+			};
+
+			// the writer's side, guarded by its mutex
+			struct session {
+				std::mutex mutex;
+				std::condition_variable wake;
+				std::vector<std::shared_ptr<buffer>> buffers;
+				std::FILE* file = nullptr;
+				bool first = true;
+				bool stopping = false;
+				std::thread writer;
+				std::atomic<int64_t> origin{ 0 };			// steady clock nanoseconds
+				std::atomic<uint64_t> generation{ 0 };	// buffers register again each session
+				std::atomic<uint32_t> threads{ 0 };
+				std::atomic<size_t> dropped{ 0 };
+				std::atomic<uint32_t> recording{ 0 };	// threads inside record
+			};
+			session& _session() {
+				static session s;
+				return s;
+			}
+
+			int64_t now() {
+				return std::chrono::duration_cast<std::chrono::nanoseconds>(
+					std::chrono::steady_clock::now().time_since_epoch()).count();
+			}
+
+			thread_local std::shared_ptr<buffer> _buffer;
+			thread_local uint64_t _generation = 0;
+
+			void escape(std::FILE* f, const char* s) {
+				for (; *s; s++) {
+					auto c = (unsigned char)*s;
+					if (c == '"' || c == '\\')
+						std::fprintf(f, "\\%c", c);
+					else if (c < 0x20)
+						std::fprintf(f, "\\u%04x", c);
+					else
+						std::fputc(c, f);
+				}
+			}
+
+			void write(session& s, uint32_t thread, const event& e) {
+				std::fputs(s.first ? "\n" : ",\n", s.file);
+				s.first = false;
+				std::fputs("{\"name\":\"", s.file);
+				escape(s.file, e.name);
+				std::fputs("\",\"cat\":\"", s.file);
+				escape(s.file, e.category);
+				std::fprintf(s.file, "\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%u}",
+					e.phase, e.time / 1000.0, thread);
+			}
+
+			// mutex held, the single consumer of every ring
+			void drain(session& s) {
+				event batch[64];
+				for (auto& b : s.buffers) {
+					size_t n;
+					while ((n = b->events.pop(batch, 64)) > 0) {
+						for (size_t i = 0; i < n; i++)
+							write(s, b->thread, batch[i]);
+						b->popped.fetch_add(n, std::memory_order_release);
+					}
+				}
+			}
+
+			// mutex held and every thread out of record, ends the spans
+			// still open so each begin in the file has its end
+			void close(session& s) {
+				auto time = (uint64_t)(now() - s.origin.load(std::memory_order_relaxed));
+				for (auto& b : s.buffers) {
+					for (auto o = b->open.rbegin(); o != b->open.rend(); ++o) {
+						if (!o->recorded)
+							continue;
+						auto e = o->begin;
+						e.phase = 'E';
+						e.time = time;
+						write(s, b->thread, e);
+					}
+					b->open.clear();
+				}
+			}
+
+			bool push(session& s, buffer& b, event& e) {
+				if (!b.events.push(&e, 1)) {
+					s.dropped.fetch_add(1, std::memory_order_relaxed);
+					return false;
+				}
+				b.pushed++;
+				return true;
+			}
+
+			void record(const char* name, const char* category, char phase) {
+				auto& s = _session();
+				auto generation = s.generation.load(std::memory_order_acquire);
+				if (!_buffer || _generation != generation) {
+					_buffer = std::make_shared<buffer>(s.threads.fetch_add(1) + 1);
+					_generation = generation;
+					std::lock_guard<std::mutex> lock(s.mutex);
+					s.buffers.push_back(_buffer);
+				}
+				event e;
+				std::strncpy(e.name, name, sizeof(e.name) - 1);
+				e.name[sizeof(e.name) - 1] = 0;
+				e.category = category;
+				e.phase = phase;
+				e.time = (uint64_t)(now() - s.origin.load(std::memory_order_relaxed));
+				auto& b = *_buffer;
+				if (phase == 'B') {
+					// a begin goes in only with room kept for its end and
+					// the ends of the spans around it, so ends never drop
+					auto used = b.pushed - b.popped.load(std::memory_order_acquire) + b.reserved;
+					auto recorded = false;
+					if (used + 2 <= Capacity)
+						recorded = push(s, b, e);
+					else
+						s.dropped.fetch_add(1, std::memory_order_relaxed);
+					if (recorded)
+						b.reserved++;
+					b.open.push_back({ e, recorded });
+					return;
+				}
+				if (b.open.empty())
+					return; // begun before this session
+				auto recorded = b.open.back().recorded;
+				b.open.pop_back();
+				if (!recorded) {
+					s.dropped.fetch_add(1, std::memory_order_relaxed);
+					return;
+				}
+				b.reserved--;
+				push(s, b, e);
+			}
+
+			// counted while inside, so stop can wait until none is
+			void enter(const char* name, const char* category, char phase) {
+				auto& s = _session();
+				s.recording.fetch_add(1);
+				if (detail::on.load())
+					record(name, category, phase);
+				s.recording.fetch_sub(1, std::memory_order_release);
+			}
+		}
+
+		bool start(const std::string& path) {
+			auto& s = _session();
+			std::lock_guard<std::mutex> lock(s.mutex);
+			if (s.file)
+				return false;
+			s.file = std::fopen(path.c_str(), "wb");
+			if (!s.file)
+				return false;
+			std::fputs("{\"traceEvents\":[", s.file);
+			s.first = true;
+			s.stopping = false;
+			s.buffers.clear();
+			s.dropped = 0;
+			s.origin = now();
+			s.generation.fetch_add(1, std::memory_order_release);
+			s.writer = std::thread([&s]() {
+				std::unique_lock<std::mutex> lock(s.mutex);
+				while (!s.stopping) {
+					s.wake.wait_for(lock, Interval, [&s]() { return s.stopping; });
+					drain(s);
+				}
+			});
+			detail::on.store(true, std::memory_order_release);
+			return true;
+		}
+
+		size_t stop() {
+			auto& s = _session();
+			detail::on.store(false);
+			{
+				std::lock_guard<std::mutex> lock(s.mutex);
+				if (!s.file)
+					return 0;
+			}
+			// threads already past the switch finish their push before the last drain
+			while (s.recording.load(std::memory_order_acquire) != 0)
+				std::this_thread::yield();
+			{
+				std::lock_guard<std::mutex> lock(s.mutex);
+				s.stopping = true;
+			}
+			s.wake.notify_one();
+			s.writer.join();
+
+			std::lock_guard<std::mutex> lock(s.mutex);
+			drain(s);
+			close(s);
+			auto dropped = s.dropped.load();
+			std::fprintf(s.file, "\n],\"otherData\":{\"dropped\":\"%zu\"}}\n", dropped);
+			std::fclose(s.file);
+			s.file = nullptr;
+			s.buffers.clear();
+			return dropped;
+		}
+
+		void begin(const char* name, const char* category) {
+			enter(name, category, 'B');
+		}
+
+		void end(const char* name, const char* category) {
+			enter(name, category, 'E');
+		}
+
+	}
+}
@@ -0,0 +1,154 @@
+#include "trace.h"
+#include "vm.h"
+#include <assert.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <thread>
+
+namespace jiffle {
+	namespace trace {
+
+		void events_test() {
+			// internal state -------------------------------------------------
+			static const char* Path = "jiffle_trace_test.json";
+
+			// methods --------------------------------------------------------
+			auto read = [&]() {
+				std::ifstream input(Path, std::ios::binary);
+				return std::string((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+			};
+			auto count = [](const std::string& text, const std::string& part) {
+				size_t n = 0;
+				for (auto at = text.find(part); at != std::string::npos; at = text.find(part, at + 1))
+					n++;
+				return n;
+			};
+			// B and E events of each name match, in order on every thread
+			auto balanced = [](const std::string& text) {
+				std::map<std::string, std::vector<std::string>> open;
+				for (auto at = text.find("{\"name\":\""); at != std::string::npos; at = text.find("{\"name\":\"", at + 1)) {
+					auto name = text.substr(at + 9, text.find("\",\"cat\"", at) - at - 9);
+					auto phase = text[text.find("\"ph\":\"", at) + 6];
+					auto tid = text.substr(text.find("\"tid\":", at) + 6);
+					tid = tid.substr(0, tid.find('}'));
+					if (phase == 'B')
+						open[tid].push_back(name);
+					else if (open[tid].empty() || open[tid].back() != name)
+						return false;
+					else
+						open[tid].pop_back();
+				}
+				for (auto& o : open)
+					if (!o.second.empty())
+						return false;
+				return true;
+			};
+
+			// tests ----------------------------------------------------------
+
+			{ // off, nothing recorded
+				assert(!enabled());
+				{ scope span("idle", "test"); }
+				assert(stop() == 0);
+			}
+			{ // spans of every thread, in one document
+				assert(start(Path) && enabled());
+				assert(!start(Path));
+				std::thread other([]() {
+					for (int i = 0; i < 100; i++) {
+						scope outer("worker", "test");
+						scope inner("quoted \"name\" \\", "test");
+					}
+				});
+				for (int i = 0; i < 100; i++)
+					scope span("main", "test");
+				other.join();
+				assert(stop() == 0 && !enabled());
+
+				auto text = read();
+				assert(text.compare(0, 16, "{\"traceEvents\":[") == 0);
+				assert(text.find("]") != std::string::npos && text.find("\"dropped\":\"0\"") != std::string::npos);
+				assert(count(text, "\"name\":\"worker\"") == 200 && count(text, "\"name\":\"main\"") == 200);
+				assert(count(text, "\"name\":\"quoted \\\"name\\\" \\\\\"") == 200);
+				assert(count(text, "\"ph\":\"B\"") == 300 && count(text, "\"ph\":\"E\"") == 300);
+				assert(count(text, "\"tid\":") == 600 && text.find("\"tid\":1}") != std::string::npos);
+				assert(balanced(text));
+			}
+			{ // compile stages and tables, closed while a process is suspended
+				using namespace vm;
+				assert(start(Path));
+				std::string input = "f [x] = g x\ng [x] = x + 1\n";
+				for (int i = 0; i < 30; i++)
+					input += "f " + std::to_string(i) + "\n";
+				auto tokens = syntax::tokenize(input);
+				auto tables = generate(expr::parse(tokens, input));
+				link(tables);
+				auto p = vm::start(tables);
+				size_t slices = 0;
+				while (resume(p, 4) == Suspended)
+					slices++;
+				assert(slices > 1 && p.outputs[0].size() == 30 && p.outputs[0][29].integer == 30);
+				stop();
+
+				auto text = read();
+				for (auto stage : { "tokenize", "parse", "generate", "link" })
+					assert(count(text, "\"name\":\"" + std::string(stage) + "\",\"cat\":\"compile\",\"ph\":\"B\"") == 1);
+				assert(count(text, "\"name\":\"f\",\"cat\":\"vm\",\"ph\":\"B\"") >= 30);
+				assert(count(text, "\"name\":\"g\",\"cat\":\"vm\",\"ph\":\"B\"") >= 30);
+				assert(count(text, "\"name\":\"(root)\"") > slices);
+				assert(balanced(text));
+			}
+			{ // spans open at stop are ended, threads tracing through it stay balanced
+				assert(start(Path));
+				std::atomic<bool> running(true);
+				std::thread busy([&]() {
+					while (running) {
+						scope outer("busy", "test");
+						scope inner("step", "test");
+					}
+				});
+				begin("held", "test");
+				std::this_thread::sleep_for(std::chrono::milliseconds(10));
+				stop();
+				running = false;
+				busy.join();
+				end("held", "test");
+
+				auto text = read();
+				assert(count(text, "\"name\":\"held\"") == 2 && count(text, "\"name\":\"busy\"") > 0);
+				assert(balanced(text));
+			}
+			{ // an end doesn't carry into the next session
+				assert(start(Path));
+				begin("carried", "test");
+				stop();
+				assert(start(Path));
+				end("carried", "test");
+				{ scope span("fresh", "test"); }
+				stop();
+
+				auto text = read();
+				assert(count(text, "\"name\":\"carried\"") == 0 && count(text, "\"name\":\"fresh\"") == 2);
+				assert(balanced(text));
+			}
+			{ // a full buffer drops events instead of blocking
+				assert(start(Path));
+				size_t dropped = 0;
+				std::thread burst([&]() {
+					for (int i = 0; i < 100000; i++)
+						scope span("burst", "test");
+				});
+				burst.join();
+				dropped = stop();
+				auto text = read();
+				assert(count(text, "\"name\":\"burst\"") + dropped == 200000);
+				assert(text.find("\"dropped\":\"" + std::to_string(dropped) + "\"") != std::string::npos);
+			}
+			std::remove(Path);
+		}
+
+	}
+}
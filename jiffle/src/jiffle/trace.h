@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace jiffle {
+	namespace trace {
+
+		// Spans of work (compile stages, module loads, VM tables) as Chrome
+		// trace events ('chrome://tracing', Perfetto). Switched at runtime:
+		// while off, a span costs one relaxed load. While on, each thread
+		// appends to its own lock-free ring, and a background thread drains
+		// every ring into the output file. A full ring drops a span, its begin
+		// and end (counted), rather than blocking the traced thread.
+
+		namespace detail {
+			extern std::atomic<bool> on;
+		}
+
+		inline bool enabled() {
+			return detail::on.load(std::memory_order_relaxed);
+		}
+
+		// starts tracing into a trace-event JSON file, false when it can't be written
+		bool start(const std::string& path);
+
+		// waits for threads recording, drains every buffer, ends the spans
+		// still open and completes the file, returns dropped events
+		size_t stop();
+
+		// span on the calling thread, name is copied (long names are cut)
+		void begin(const char* name, const char* category);
+		void end(const char* name, const char* category);
+
+		// span of a C++ scope
+		class scope {
+		public:
+			scope(const char* name, const char* category) : _name(name), _category(category), _traced(enabled()) {
+				if (_traced)
+					begin(_name, _category);
+			}
+			~scope() {
+				if (_traced)
+					end(_name, _category);
+			}
+			scope(const scope&) = delete;
+			scope& operator=(const scope&) = delete;
+
+		private:
+			const char* _name;
+			const char* _category;
+			bool _traced;
+		};
+
+		// tests --------------------------------------------------------------
+
+		void events_test();
+
+	}
+}
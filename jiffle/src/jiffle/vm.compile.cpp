@@ -0,0 +1,36 @@
+#include "vm.h"
+
+namespace jiffle {
+	namespace vm {
+
+		std::vector<table> compile(const std::vector<const expr::node*>& modules, std::vector<std::string>& unresolved,
+			const feedback* guide, const stage& measure) {
+			auto run = [&](const char* name, const std::function<void()>& step) {
+				if (measure)
+					measure(name, step);
+				else
+					step();
+			};
+
+			// inlining rewrites trees, the modules stay as given
+			std::vector<expr::node> unfolded;
+			std::vector<table> tables;
+			run("unfold", [&]() {
+				for (auto m : modules)
+					unfolded.push_back(*m);
+				if (guide)
+					unfold(unfolded, *guide);
+				else
+					unfold(unfolded);
+			});
+			run("generate", [&]() {
+				tables = guide ? generate(unfolded, *guide) : generate(unfolded);
+			});
+			run("link", [&]() {
+				unresolved = link(tables);
+			});
+			return tables;
+		}
+
+	}
+}
@@ -0,0 +1,778 @@
+#include "vm.h"
+#include "trace.h"
+
+#include <cmath>
+#include <cstring>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace jiffle {
+	namespace vm {
+
+		// Frames live on the heap and calls never recurse in C++,
+		// every call returns to this loop (trampoline).
+		// Deep non-tail recursion ends in an error value instead of a crash.
+		static const size_t MaxFrames = 1 << 16;
+
+		// profiler hooks, nothing at all unless built with JIFFLE_PROFILE
+#ifdef JIFFLE_PROFILE
+#define PROFILE(hook) if (p.profiler) p.profiler->hook
+#else
+#define PROFILE(hook)
+#endif
+		// table and index of the executing instruction, for per site hooks
+#define SITE (size_t)(f.code - tables.data()), (size_t)(&in - f.code->start.data())
+
+		process start(const std::vector<table>& tables, size_t entry, const std::vector<value>& args, state* memory) {
+			process p = {};
+			p.tables = &tables;
+			p.entry = entry;
+			p.args = args;
+			p.outputs.push_back({});
+			p.caches.resize(tables.size());
+			p.memory = memory;
+			p.profiler = nullptr;
+			return p;
+		}
+
+		std::vector<value> execute(const std::vector<table>& tables, size_t entry, const std::vector<value>& args) {
+			auto p = start(tables, entry, args);
+			p.closed = true;
+			resume(p, (size_t)-1);
+			return std::move(p.outputs[0]);
+		}
+
+		std::vector<value> execute(const std::vector<table>& tables, state& memory, size_t entry, const std::vector<value>& args) {
+			auto p = start(tables, entry, args, &memory);
+			p.closed = true;
+			resume(p, (size_t)-1);
+			return std::move(p.outputs[0]);
+		}
+
+		std::vector<value> execute(const std::vector<table>& tables, profile& prof, size_t entry, const std::vector<value>& args) {
+			auto p = start(tables, entry, args);
+			p.closed = true;
+			p.profiler = &prof;
+			resume(p, (size_t)-1);
+			return std::move(p.outputs[0]);
+		}
+
+		status resume(process& p, size_t budget) {
+			// internal state -------------------------------------------------
+			typedef process::frame frame;
+			auto& tables = *p.tables;
+			auto& _frames = p.frames;
+			auto& _outputs = p.outputs;
+			auto& _caches = p.caches;
+			const value _none = {};
+			const bool _traced = trace::enabled();	// spans of tables, for this run only
+
+			// methods --------------------------------------------------------
+
+			// stateless
+			auto error = [](const std::string& text) {
+				value v = {};
+				v.type = data::Error;
+				v.text = text;
+				return v;
+			};
+			auto integer = [](data::integer_t i) {
+				value v = {};
+				v.type = data::Integer;
+				v.integer = i;
+				return v;
+			};
+			auto real = [](data::real_t r) {
+				value v = {};
+				v.type = data::Real;
+				v.real = r;
+				return v;
+			};
+			auto concat = [](const value& a, const value& b) {
+				value v = {};
+				v.type = data::String;
+				v.text = a.text + b.text;
+				return v;
+			};
+			auto equal = [](const value& a, const value& b) {
+				if (a.type != b.type)
+					return false;
+				switch (a.type) {
+				case data::Void: return true;
+				case data::Bool: return a.boolean == b.boolean;
+				case data::Integer: return a.integer == b.integer;
+				case data::Real: return a.real == b.real;
+				case data::String:
+				case data::Error: return a.text == b.text;
+				case data::BigInteger: return number::compare(*a.big, *b.big) == 0;
+				default: return false; // compound values are never equal
+				}
+			};
+			auto toReal = [](const value& v) {
+				return v.type == data::Integer ? (data::real_t)v.integer
+					: v.type == data::BigInteger ? number::real(*v.big) : v.real;
+			};
+			auto isIntegral = [](const value& v) {
+				return v.type == data::Integer || v.type == data::BigInteger;
+			};
+			auto isNumber = [](const value& v) {
+				return v.type == data::Integer || v.type == data::Real || v.type == data::BigInteger;
+			};
+			auto sign = [](const value& v) {
+				switch (v.type) {
+				case data::Void: return 0;
+				case data::Bool: return v.boolean ? 1 : 0;
+				case data::Integer: return v.integer < 0 ? -1 : v.integer > 0 ? 1 : 0;
+				case data::Real: return v.real < 0 ? -1 : v.real > 0 ? 1 : 0;
+				case data::BigInteger: return v.big->negative ? -1 : 1;
+				default: return 1;
+				}
+			};
+			auto pack = [](std::vector<value>& items, bool forced) {
+				// single item sequence equals item
+				if (items.size() == 1 && !forced)
+					return items[0];
+				value v = {};
+				if (items.empty() && !forced)
+					return v;
+				v.type = data::Sequence;
+				v.items = persist::vector<value>(items);
+				return v;
+			};
+			auto toBig = [](const value& v) {
+				return v.type == data::BigInteger ? *v.big : number::from(v.integer);
+			};
+			auto promote = [&](number::integer&& n) {
+				// back to a small integer whenever it fits
+				data::integer_t i;
+				if (number::small(n, i))
+					return integer(i);
+				value v = {};
+				v.type = data::BigInteger;
+				v.big = std::make_shared<const number::integer>(std::move(n));
+				return v;
+			};
+			// a * b, false on overflow
+			auto multiply = [](data::integer_t a, data::integer_t b, data::integer_t& out) {
+#if defined(_MSC_VER)
+				__int64 high;
+				out = _mul128(a, b, &high);
+				return high == (out < 0 ? -1 : 0);
+#else
+				return !__builtin_mul_overflow(a, b, &out);
+#endif
+			};
+			// base^exp, false on overflow
+			auto power = [](data::integer_t base, data::integer_t exp, data::integer_t& out) {
+				uint64_t result = 1, b = base < 0 ? 0 - (uint64_t)base : (uint64_t)base;
+				auto odd = (exp & 1) != 0;
+				for (; exp > 0; exp--) {
+					if (b > 1 && result > (uint64_t)INT64_MAX / b)
+						return false;
+					result *= b;
+					if (b <= 1)
+						break;
+				}
+				out = base < 0 && odd ? -(data::integer_t)result : (data::integer_t)result;
+				return true;
+			};
+
+			// small integers take the fast path, overflows continue
+			// as big integers instead of wrapping around
+			auto integral = [&](opcode op, const value& a, const value& b) {
+				if (a.type == data::Integer && b.type == data::Integer) {
+					auto x = a.integer, y = b.integer;
+					auto ux = (uint64_t)x, uy = (uint64_t)y;
+					data::integer_t r;
+					switch (op) {
+					case RSHIFT: return integer(x >> (uy & 63));
+					case LSHIFT: return integer((data::integer_t)(ux << (uy & 63)));
+					case AND: return integer((data::integer_t)(ux & uy));
+					case OR: return integer((data::integer_t)(ux | uy));
+					case XOR: return integer((data::integer_t)(ux ^ uy));
+					case ADD:
+						if (y > 0 ? x <= INT64_MAX - y : x >= INT64_MIN - y)
+							return integer(x + y);
+						break;
+					case SUB:
+						if (y < 0 ? x <= INT64_MAX + y : x >= INT64_MIN + y)
+							return integer(x - y);
+						break;
+					case MUL:
+						if (multiply(x, y, r))
+							return integer(r);
+						break;
+					case POW:
+						if (y <= 0)
+							return integer(1);
+						if (power(x, y, r))
+							return integer(r);
+						break;
+					default:
+						if (y == 0)
+							return error("division by zero");
+						if (y != -1 || x != INT64_MIN)
+							return integer(op == DIV ? x / y : x % y);
+						break;
+					}
+				}
+
+				// big integers
+				auto x = toBig(a), y = toBig(b);
+				switch (op) {
+				case ADD: return promote(number::add(x, y));
+				case SUB: return promote(number::sub(x, y));
+				case MUL: return promote(number::mul(x, y));
+				case POW: {
+					data::integer_t exp;
+					if (y.negative || y.limbs.empty())
+						return integer(1);
+					if (!number::small(y, exp))
+						return error("exponent too large");
+					return promote(number::pow(x, (uint64_t)exp));
+				}
+				case DIV: case MOD: {
+					if (y.limbs.empty())
+						return error("division by zero");
+					number::integer rem;
+					auto q = number::div(x, y, &rem);
+					return promote(op == DIV ? std::move(q) : std::move(rem));
+				}
+				default: return error("invalid operands, integers expected");
+				}
+			};
+			auto floating = [&](opcode op, data::real_t x, data::real_t y) {
+				switch (op) {
+				case FADD: return real(x + y);
+				case FSUB: return real(x - y);
+				case FMUL: return real(x * y);
+				case FDIV: return real(x / y);
+				case FMOD: return real(std::fmod(x, y));
+				default: return real(std::pow(x, y));
+				}
+			};
+
+			// numbers of either kind, or concatenated strings; an error operand is the result
+			auto dynamic = [&](opcode op, const value& a, const value& b) {
+				if (a.type == data::Error || b.type == data::Error)
+					return a.type == data::Error ? a : b;
+				auto i = op - DADD;
+				static const opcode integrals[] = { ADD, SUB, MUL, DIV, MOD };
+				static const opcode floatings[] = { FADD, FSUB, FMUL, FDIV, FMOD };
+				if (isIntegral(a) && isIntegral(b))
+					return integral(integrals[i], a, b);
+				if (op == DADD && a.type == data::String && b.type == data::String)
+					return concat(a, b);
+				if (isNumber(a) && isNumber(b))
+					return floating(floatings[i], toReal(a), toReal(b));
+				return error("invalid operands, numbers expected");
+			};
+			// element by element, a single value applies to every element
+			auto elementwise = [&](opcode op, const value& a, const value& b) {
+				auto xs = a.type == data::Sequence ? a.items.materialize() : std::vector<value>();
+				auto ys = b.type == data::Sequence ? b.items.materialize() : std::vector<value>();
+				if (a.type == data::Sequence && b.type == data::Sequence && xs.size() != ys.size())
+					return error("invalid operands, sequences of equal length expected");
+				auto n = a.type == data::Sequence ? xs.size() : ys.size();
+				std::vector<value> out(n);
+				for (size_t i = 0; i < n; i++)
+					out[i] = dynamic(op, a.type == data::Sequence ? xs[i] : a, b.type == data::Sequence ? ys[i] : b);
+				return pack(out, true);
+			};
+
+			auto traceName = [](const table& t) {
+				return t.symbol.empty() ? "(root)" : t.symbol.c_str();
+			};
+
+			// statefull
+			// open tables end while the process isn't running and begin
+			// again when it resumes, so spans are balanced per thread
+			auto traceFrames = [&](bool begin) {
+				if (!_traced)
+					return;
+				for (size_t i = 0; i < _frames.size(); i++) {
+					if (begin)
+						trace::begin(traceName(*_frames[i].code), "vm");
+					else
+						trace::end(traceName(*_frames[_frames.size() - 1 - i].code), "vm");
+				}
+			};
+			auto store = [&](frame& f, unsigned char reg, value v) {
+				if (reg == Output)
+					_outputs.back().push_back(std::move(v));
+				else
+					f.regs[reg] = std::move(v);
+			};
+			auto enter = [&](const table& t, const value* argv, size_t argc, unsigned char ret) {
+				frame f = { &t, 0, std::vector<value>(t.registers > argc ? t.registers : argc), ret, _outputs.size(), {} };
+				for (size_t i = 0; i < argc; i++)
+					f.regs[i] = argv[i];
+				_outputs.push_back({});
+				_frames.push_back(std::move(f));
+				PROFILE(entered(&t - tables.data()));
+				if (_traced)
+					trace::begin(traceName(t), "vm");
+			};
+
+			// specified parameter types are checked once per call,
+			// so the table body runs specialized code unguarded
+			auto admit = [&](const table& t, const value* argv, value& failure) {
+				static const char* names[] = { "Void", "Bool", "Integer", "Real", "String", "Error", "Sequence", "Object", "BigInteger" };
+				for (size_t i = 0; i < t.specifications.size(); i++) {
+					auto spec = t.specifications[i];
+					if (spec == data::Void || argv[i].type == spec
+						|| (spec == data::Integer && argv[i].type == data::BigInteger)
+						|| (spec == data::Real && isIntegral(argv[i])))
+						continue;
+					failure = error("invalid argument, " + std::string(names[spec]) + " expected");
+					return false;
+				}
+				return true;
+			};
+			// closures are flat: binding more arguments copies the bound ones
+			// into a new closure of the same table, never a chain of closures
+			auto bind = [](const value& fn, size_t table, const value* argv, size_t argc) {
+				value v = {};
+				v.type = data::Closure;
+				v.integer = table;
+				if (fn.type == data::Closure)
+					v.items = fn.items;
+				for (size_t i = 0; i < argc; i++)
+					v.items = v.items.push_back(argv[i]);
+				return v;
+			};
+			// too few arguments bind a closure, enough enter its table at once,
+			// and the arguments past its parameters are applied to the result.
+			// A value that isn't a closure is followed by its arguments, or is
+			// an error when it was the result of a table with given arity.
+			auto apply = [&](const value& fn, const value* argv, size_t argc, unsigned char ret, size_t arity) {
+				auto& f = _frames.back();
+				if (fn.type != data::Closure) {
+					if (arity != npos) {
+						store(f, ret, error("invalid number of arguments, " + std::to_string(arity) + " expected"));
+						return;
+					}
+					std::vector<value> items(1, fn);
+					items.insert(items.end(), argv, argv + argc);
+					if (ret == Output)
+						_outputs.back().insert(_outputs.back().end(), items.begin(), items.end());
+					else
+						store(f, ret, pack(items, false));
+					return;
+				}
+				auto& target = tables[(size_t)fn.integer];
+				auto bound = fn.items.size();
+				if (bound + argc < target.parameters) {
+					store(f, ret, bind(fn, (size_t)fn.integer, argv, argc));
+					return;
+				}
+				// saturated, bound arguments first
+				auto taken = target.parameters - bound;
+				auto args = argv;
+				std::vector<value> all;
+				if (bound) {
+					all = fn.items.materialize();
+					all.insert(all.end(), argv, argv + taken);
+					args = all.data();
+				}
+				value failure;
+				if (!admit(target, args, failure)) {
+					store(f, ret, failure);
+					return;
+				}
+				if (_frames.size() >= MaxFrames) {
+					store(f, ret, error("stack overflow"));
+					return;
+				}
+				std::vector<value> rest(argv + taken, argv + argc);
+				enter(target, args, target.parameters, ret); // invalidates f
+				_frames.back().rest = std::move(rest);
+			};
+			auto leave = [&]() {
+				PROFILE(left());
+				if (_traced)
+					trace::end(traceName(*_frames.back().code), "vm");
+				auto results = std::move(_outputs.back());
+				_outputs.pop_back();
+				auto ret = _frames.back().ret;
+				auto rest = std::move(_frames.back().rest);
+				auto arity = _frames.back().code->parameters;
+				_frames.pop_back();
+				if (!rest.empty())
+					apply(pack(results, false), rest.data(), rest.size(), ret, arity);
+				else if (ret == Output && _outputs.back().empty())
+					_outputs.back().swap(results);
+				else if (ret == Output)
+					_outputs.back().insert(_outputs.back().end(), results.begin(), results.end());
+				else
+					_frames.back().regs[ret] = pack(results, false);
+			};
+			auto site = [&](const frame& f) -> cache& {
+				auto& sites = _caches[f.code - tables.data()];
+				if (sites.empty())
+					sites.resize(f.code->start.size(), cache());
+				return sites[f.pc - 1];
+			};
+
+			// first frame (and transaction), false when the entry can't run
+			auto boot = [&]() {
+				p.started = true;
+				if (p.memory)
+					p.tx = begin(*p.memory, tables);
+				if (p.entry >= tables.size())
+					return false;
+				if (tables[p.entry].parameters != p.args.size()) {
+					_outputs[0].push_back(error("invalid number of arguments, "
+						+ std::to_string(tables[p.entry].parameters) + " expected"));
+					return false;
+				}
+				value failure;
+				if (!admit(tables[p.entry], p.args.data(), failure)) {
+					_outputs[0].push_back(failure);
+					return false;
+				}
+				enter(tables[p.entry], p.args.data(), p.args.size(), Output);
+				return true;
+			};
+
+			// entry ----------------------------------------------------------
+			PROFILE(resumed());
+			if (p.started)
+				traceFrames(true);
+			if (!p.started && !boot())
+				return Finished;
+
+			auto conflict = false;
+			for (;; budget--) {
+				if (_frames.empty() || conflict) {
+					if (!conflict && (!p.memory || commit(p.tx)))
+						return Finished;
+					// evaluation is pure, so it is retried from the start
+					// with a fresh transaction and the input it took
+					conflict = false;
+					p.input.insert(p.input.begin(), p.received.begin(), p.received.end());
+					p.received.clear();
+					for (size_t i = 0; i < _frames.size(); i++)
+						PROFILE(left());
+					traceFrames(false);
+					_frames.clear();
+					_outputs.assign(1, {});
+					if (!boot())
+						return Finished;
+				}
+				if (budget == 0) {
+					PROFILE(paused());
+					traceFrames(false);
+					return Suspended;
+				}
+				auto& f = _frames.back();
+				if (f.pc >= f.code->start.size()) {
+					leave();
+					continue;
+				}
+				auto& in = f.code->start[f.pc++];
+				PROFILE(executed(in.opcode, tables));
+				auto& a = in.a < f.regs.size() ? f.regs[in.a] : _none;
+				auto& b = in.b < f.regs.size() ? f.regs[in.b] : _none;
+
+				switch (in.opcode) {
+
+				// memory -----------------------------------------------------
+				case SET:
+					// tables made without link decode their constants here
+					store(f, in.reg, f.code->constants.empty() ? decode(*f.code, in.addr.index) : f.code->constants[in.addr.table]);
+					break;
+				case LOAD: {
+					if (!p.memory) {
+						store(f, in.reg, decode(tables[in.addr.table], in.addr.index));
+						break;
+					}
+					value v;
+					if (!read(p.tx, in.addr.table, in.addr.index, v)) {
+						conflict = true;
+						break;
+					}
+					store(f, in.reg, std::move(v));
+					break;
+				}
+				case STORE:
+					if (!p.memory) {
+						store(f, in.reg, error("no shared state"));
+						break;
+					}
+					write(p.tx, in.addr.table, in.addr.index, a);
+					break;
+				case CAS: {
+					// memory set to second register when it equals the first,
+					// register is whether it did
+					if (!p.memory) {
+						store(f, in.reg, error("no shared state"));
+						break;
+					}
+					value v;
+					if (!read(p.tx, in.addr.table, in.addr.index, v)) {
+						conflict = true;
+						break;
+					}
+					auto same = equal(v, a);
+					if (same)
+						write(p.tx, in.addr.table, in.addr.index, b);
+					value r = {};
+					r.type = data::Bool;
+					r.boolean = same;
+					store(f, in.reg, r);
+					break;
+				}
+				case MOVE:
+					store(f, in.reg, a);
+					break;
+				case EMIT:
+					_outputs.back().push_back(a);
+					break;
+				case BEGIN:
+					_outputs.push_back({});
+					break;
+				case END: {
+					auto items = std::move(_outputs.back());
+					_outputs.pop_back();
+					store(f, in.reg, pack(items, in.b != 0));
+					break;
+				}
+
+				// objects ----------------------------------------------------
+				case OBJECT: {
+					value v = {};
+					v.type = data::Object;
+					v.integer = f.code - tables.data(); // its set, dispatch row of members
+					v.layout = empty();
+					store(f, in.reg, std::move(v));
+					break;
+				}
+				case MEMBER: {
+					if (a.type != data::Object) {
+						store(f, in.reg, error("invalid operand, object expected"));
+						break;
+					}
+					auto set = (size_t)a.integer < tables.size() ? (size_t)a.integer : 0;
+					auto slot = member(site(f), *a.layout, in.addr.symbol, tables[set].slots, in.addr.index);
+					if (slot == npos) {
+						store(f, in.reg, error("missing member '" + in.addr.symbol + "'"));
+						break;
+					}
+					value v = a.items[slot]; // a may be the target register
+					store(f, in.reg, v);
+					break;
+				}
+				case EXTEND: {
+					if (a.type != data::Object && a.type != data::Void) {
+						store(f, in.reg, error("invalid operand, object expected"));
+						break;
+					}
+					value v = a;
+					if (v.type == data::Void) {
+						v.type = data::Object;
+						v.integer = 0; // of no set
+						v.layout = empty();
+					}
+					auto slot = member(site(f), *v.layout, in.addr.symbol);
+					if (slot == npos) {
+						v.layout = extend(v.layout, in.addr.symbol);
+						v.items = v.items.push_back(b);
+					}
+					else {
+						v.items = v.items.set(slot, b);
+					}
+					store(f, in.reg, v);
+					break;
+				}
+
+				// destructuring -----------------------------------------------
+				// a single value is a sequence of one, Void is empty
+				case TYPE:
+					store(f, in.reg, integer(a.type));
+					break;
+				case COUNT:
+					store(f, in.reg, integer(a.type == data::Sequence ? a.items.size() : a.type == data::Void ? 0 : 1));
+					break;
+				case ITEM: {
+					value v = {};
+					auto size = a.type == data::Sequence ? a.items.size() : a.type == data::Void ? 0 : 1;
+					if (in.addr.index < size) {
+						auto i = in.b ? size - 1 - in.addr.index : in.addr.index;
+						v = a.type == data::Sequence ? a.items[i] : a;
+					}
+					store(f, in.reg, v);
+					break;
+				}
+				case SLICE: {
+					// shares the nodes of the sequence, O(log n)
+					auto size = a.type == data::Sequence ? a.items.size() : a.type == data::Void ? 0 : 1;
+					auto to = size > in.b ? size - in.b : 0;
+					value v = {};
+					if (in.addr.index + 1 == to)
+						v = a.type == data::Sequence ? a.items[in.addr.index] : a;
+					else if (in.addr.index < to) {
+						v.type = data::Sequence;
+						v.items = a.items.slice(in.addr.index, to);
+					}
+					store(f, in.reg, std::move(v));
+					break;
+				}
+				case CONCAT:
+					store(f, in.reg, a.type == data::String && b.type == data::String
+						? concat(a, b) : error("invalid operands, strings expected"));
+					break;
+
+				// input ------------------------------------------------------
+				case RECEIVE:
+					if (!p.input.empty()) {
+						if (p.memory)
+							p.received.push_back(p.input.front());
+						store(f, in.reg, p.input.front());
+						p.input.pop_front();
+					}
+					else if (p.closed) {
+						store(f, in.reg, _none);
+					}
+					else {
+						f.pc--; // retried once resumed
+						PROFILE(paused());
+						traceFrames(false);
+						return Waiting;
+					}
+					break;
+
+				// control flow -----------------------------------------------
+				case JUMP:
+					f.pc = in.addr.index;
+					break;
+				case SWITCH: {
+					data::type_info info;
+					memcpy(&info, &f.code->memory[in.addr.index], sizeof(info));
+					auto count = (data::integer_t)(info.bytelen / sizeof(uint32_t));
+					auto key = a.type != data::Integer || a.integer < 0 ? 0 : a.integer < count ? a.integer : count - 1;
+					uint32_t target;
+					memcpy(&target, &f.code->memory[in.addr.index + sizeof(info) + key * sizeof(uint32_t)], sizeof(target));
+					PROFILE(branched(SITE, (size_t)key));
+					f.pc = target;
+					break;
+				}
+				case CALL: {
+					auto target = &tables[in.addr.table];
+					value failure;
+					if (!admit(*target, f.regs.data() + in.a, failure)) {
+						store(f, in.reg, failure);
+						break;
+					}
+					if (_frames.size() >= MaxFrames) {
+						store(f, in.reg, error("stack overflow"));
+						break;
+					}
+					enter(*target, f.regs.data() + in.a, in.b, in.reg); // invalidates f
+					break;
+				}
+				case TAILCALL: {
+					// reuses the frame, output keeps appending to the same sequence
+					auto target = &tables[in.addr.table];
+					value failure;
+					if (!admit(*target, f.regs.data() + in.a, failure)) {
+						store(f, Output, failure);
+						break;
+					}
+					// arguments move down to the first registers, the rest is cleared
+					for (size_t i = 0; i < in.b; i++)
+						if (in.a != 0)
+							f.regs[i] = std::move(f.regs[in.a + i]);
+					PROFILE(left());
+					PROFILE(entered(in.addr.table));
+					if (_traced) {
+						trace::end(traceName(*f.code), "vm");
+						trace::begin(traceName(*target), "vm");
+					}
+					f.code = target;
+					f.pc = 0;
+					f.regs.resize(target->registers > in.b ? target->registers : in.b);
+					for (size_t i = in.b; i < f.regs.size(); i++)
+						f.regs[i] = value();
+					break;
+				}
+				case CLOSE:
+					store(f, in.reg, bind(_none, in.addr.table, f.regs.data() + in.a, in.b));
+					break;
+				case APPLY:
+					apply(a, f.regs.data() + in.a + 1, in.b, in.reg, npos); // may invalidate f
+					break;
+				case RETURN:
+					leave();
+					break;
+				case IFZ:	if (!(sign(a) == 0)) f.pc++; PROFILE(branched(SITE, !(sign(a) == 0))); break;
+				case IFNZ:	if (!(sign(a) != 0)) f.pc++; PROFILE(branched(SITE, !(sign(a) != 0))); break;
+				case IFL:	if (!(sign(a) < 0)) f.pc++; PROFILE(branched(SITE, !(sign(a) < 0))); break;
+				case IFLE:	if (!(sign(a) <= 0)) f.pc++; PROFILE(branched(SITE, !(sign(a) <= 0))); break;
+				case IFG:	if (!(sign(a) > 0)) f.pc++; PROFILE(branched(SITE, !(sign(a) > 0))); break;
+				case IFGE:	if (!(sign(a) >= 0)) f.pc++; PROFILE(branched(SITE, !(sign(a) >= 0))); break;
+
+				// bitwise arithmetics ----------------------------------------
+				case RSHIFT: case LSHIFT: case AND: case OR: case XOR:
+					if (a.type != data::Integer || b.type != data::Integer) {
+						store(f, in.reg, error("invalid operands, integers expected"));
+						break;
+					}
+					store(f, in.reg, integral(in.opcode, a, b));
+					break;
+				case NOT:
+					if (a.type != data::Integer) {
+						store(f, in.reg, error("invalid operand, integer expected"));
+						break;
+					}
+					store(f, in.reg, integer((data::integer_t)~(uint64_t)a.integer));
+					break;
+				case MINUS:
+					if (!isIntegral(a)) {
+						store(f, in.reg, error("invalid operand, integer expected"));
+						break;
+					}
+					store(f, in.reg, a.type == data::Integer && a.integer != INT64_MIN
+						? integer(-a.integer) : promote(number::negate(toBig(a))));
+					break;
+
+				// integer arithmetics, operand types known by generate -------
+				case ADD: case SUB: case MUL: case DIV: case MOD: case POW:
+					store(f, in.reg, integral(in.opcode, a, b));
+					break;
+
+				// floating point arithmetics ---------------------------------
+				case FADD: case FSUB: case FMUL: case FDIV: case FMOD: case FPOW:
+					store(f, in.reg, floating(in.opcode, toReal(a), toReal(b)));
+					break;
+				case FMINUS:
+					if (!isNumber(a)) {
+						store(f, in.reg, error("invalid operand, number expected"));
+						break;
+					}
+					store(f, in.reg, real(-toReal(a)));
+					break;
+
+				// dynamic arithmetics, guarded by operand types --------------
+				case DADD: case DSUB: case DMUL: case DDIV: case DMOD: {
+					PROFILE(operated(SITE, a.type, b.type));
+					if (a.type == data::Sequence || b.type == data::Sequence)
+						store(f, in.reg, elementwise(in.opcode, a, b));
+					else
+						store(f, in.reg, dynamic(in.opcode, a, b));
+					break;
+				}
+
+				default:
+					store(f, in.reg, error("unsupported instruction"));
+					break;
+				}
+			}
+
+			return Finished;
+		}
+
+	}
+}
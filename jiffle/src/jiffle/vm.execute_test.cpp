@@ -0,0 +1,465 @@
+#include "vm.h"
+#include "bench.h"
+#include <assert.h>
+#include <cstring>
+
+namespace jiffle {
+	namespace vm {
+
+		void execute_test() {
+			using namespace syntax;
+			using namespace expr;
+
+			// internal state -------------------------------------------------
+			std::vector<table> _tables;
+			std::vector<value> _out;
+			size_t _index;
+
+			// methods --------------------------------------------------------
+			auto run = [&](const std::string& input) {
+				auto src = tokenize(input);
+				auto ast = parse(src, input);
+				_tables = generate(ast);
+				link(_tables);
+				_out = execute(_tables);
+				_index = 0;
+			};
+			auto next = [&]() -> const value& {
+				assert(_index < _out.size());
+				return _out[_index++];
+			};
+			auto assert_integer = [&](data::integer_t i) {
+				auto& v = next();
+				assert(v.type == data::Integer && v.integer == i);
+			};
+			auto assert_string = [&](const std::string& s) {
+				auto& v = next();
+				assert(v.type == data::String && v.text == s);
+			};
+			auto assert_error = [&](const std::string& s) {
+				auto& v = next();
+				assert(v.type == data::Error && v.text == s);
+			};
+			auto assert_type = [&](data::type t) {
+				assert(next().type == t);
+			};
+			auto assert_end = [&]() {
+				assert(_index >= _out.size());
+			};
+
+			// hand assembled tables
+			auto op = [](opcode o, unsigned char reg, unsigned char a = 0, unsigned char b = 0, const std::string& symbol = "", size_t index = 0) {
+				return instruction{ o, reg, a, b, { symbol, index, 0 } };
+			};
+			auto one = []() {
+				data::type_info info;
+				memset(&info, 0, sizeof(info));
+				info.type = data::Integer;
+				info.bytelen = sizeof(data::integer_t);
+				data::integer_t i = 1;
+				std::vector<data::byte> mem(sizeof(info) + sizeof(i));
+				memcpy(&mem[0], &info, sizeof(info));
+				memcpy(&mem[sizeof(info)], &i, sizeof(i));
+				return mem;
+			};
+			auto countdown = [&](const std::string& symbol, const std::string& next, opcode call) {
+				// symbol [n] { n:0 -> n; next (n-1) }
+				return table{ symbol, one(), {
+					op(IFZ, 0, 0),
+					op(JUMP, 0, 0, 0, "", 5),
+					op(SET, 1),
+					op(SUB, 2, 0, 1),
+					op(call, Output, 2, 1, next),
+					op(EMIT, 0, 0),
+				}, {}, 1, 3, false, {}, {}, {} };
+			};
+			auto integer = [](data::integer_t i) {
+				value v = {};
+				v.type = data::Integer;
+				v.integer = i;
+				return v;
+			};
+			auto invoke = [&](data::integer_t n) {
+				link(_tables);
+				_out = execute(_tables, 0, { integer(n) });
+				_index = 0;
+			};
+
+			// tests ----------------------------------------------------------
+
+			{ // empty
+				run("");
+				assert_end();
+			}
+			{ // values
+				run("3, 'hi', 1.5, true, null");
+				assert_integer(3);
+				assert_string("hi");
+				assert_type(data::Real);
+				assert_type(data::Bool);
+				assert_type(data::Void);
+				assert_end();
+
+				run("0x11 0b11 0o11");
+				assert_integer(17);
+				assert_integer(3);
+				assert_integer(9);
+				assert_end();
+			}
+			{ // sequences
+				run("(1, 2), (3), (4,), ()");
+				auto& s = next();
+				assert(s.type == data::Sequence && s.items.size() == 2 && s.items[1].integer == 2);
+				assert_integer(3);
+				auto& forced = next();
+				assert(forced.type == data::Sequence && forced.items.size() == 1);
+				assert_type(data::Void);
+				assert_end();
+			}
+			{ // definitions
+				run("three = 3\nident [x] = x\nthree\nident 'hi'");
+				assert_integer(3);
+				assert_string("hi");
+				assert_end();
+
+				run("outer { inner = 5 \n inner }\nouter");
+				assert_integer(5);
+				assert_end();
+
+				run("add [a] [b] { b, a }\nadd 3 8");
+				assert_integer(8);
+				assert_integer(3);
+				assert_end();
+			}
+			{ // modules run in order, extensions see their set
+				std::vector<node> modules;
+				for (auto input : { "counter { get = start \n .start = 5 }\n1", "counter.start2 = 6\ncounter.get" }) {
+					auto src = tokenize(input);
+					modules.push_back(parse(src, input));
+				}
+				_tables = generate(modules);
+				link(_tables);
+				_out = execute(_tables);
+				_index = 0;
+				assert_integer(1);
+				assert_integer(5);
+				assert_end();
+			}
+			{ // arithmetics
+				run("square [x:Integer] = x * x\nsquare 7\nsquare (1 + 2)\nsquare 1.5");
+				assert_integer(49);
+				assert_integer(9);
+				assert_error("invalid argument, Integer expected");
+				assert_end();
+
+				run("half [x:Real] = x / 2\nhalf 3");
+				auto& h = next();
+				assert(h.type == data::Real && h.real == 1.5);
+				assert_end();
+
+				run("inc [x] = x + 1\ninc 2, inc 2.5, inc 'a'\n7 / 0\n(7 % 4) - 1");
+				assert_integer(3);
+				auto& r = next();
+				assert(r.type == data::Real && r.real == 3.5);
+				assert_error("invalid operands, numbers expected");
+				assert_error("division by zero");
+				assert_integer(2);
+				assert_end();
+			}
+			{ // division errors pass through later arithmetics
+				run("(7 / 0) + 1\n(7 / 0) * 1.5\n(7 % 0) - 2\nf [x:Integer] = (x / 0) + 5\nf 3\n"
+					"g [x] = (x / 0) + 5\ng 3\n(6 / 2) + 1");
+				for (int i = 0; i < 5; i++)
+					assert_error("division by zero");
+				assert_integer(4);
+				assert_end();
+			}
+			{ // element-wise over sequences
+				auto assert_items = [&](const std::vector<data::integer_t>& items) {
+					auto& v = next();
+					assert(v.type == data::Sequence && v.items.size() == items.size());
+					for (size_t i = 0; i < items.size(); i++)
+						assert(v.items[i].type == data::Integer && v.items[i].integer == items[i]);
+				};
+				run("add [a] [b] = a + b\nsub [a] [b] = a - b\nmul [a] [b] = a * b\n"
+					"add (1, 2, 3, 4, 5) (10, 20, 30, 40, 50)\nsub 100 (1, 2)\nmul (1, 2) (3, 4)\n"
+					"add (9223372036854775807, 1) 1\nsub (0 - 9223372036854775807, 5) (2, 5)\n"
+					"mul (1.5, 'a') 2\nadd (1, 2) (1, 2, 3)\nadd (1,) (2,)");
+				assert_items({ 11, 22, 33, 44, 55 });
+				assert_items({ 99, 98 });
+				assert_items({ 3, 8 });
+				auto& wide = next();
+				assert(wide.type == data::Sequence && wide.items[0].type == data::BigInteger && wide.items[1].integer == 2);
+				auto& low = next();
+				assert(low.type == data::Sequence && low.items[0].type == data::BigInteger && low.items[1].integer == 0);
+				auto& mixed = next();
+				assert(mixed.type == data::Sequence && mixed.items[0].type == data::Real && mixed.items[0].real == 3);
+				assert(mixed.items[1].type == data::Error);
+				assert_error("invalid operands, sequences of equal length expected");
+				assert_items({ 3 });
+				assert_end();
+			}
+			{ // big integers
+				auto assert_big = [&](const std::string& digits) {
+					auto& v = next();
+					assert(v.type == data::BigInteger && number::format(*v.big) == digits);
+				};
+				run("9223372036854775807 + 1\n(0 - 9223372036854775807) - 2\n"
+					"0xFFFFFFFFFFFFFFFFFFFF\n(100000000000 * 100000000000) / 100000000000\n"
+					"kind [x:Integer] = 'int'\nkind 0b1" + std::string(70, '0') + "\n"
+					"half [x:Real] = x / 2\nhalf 18446744073709551616\n"
+					"3037000499 * 3037000499\n4294967296 * (0 - 2147483648)\n3037000500 * 3037000500");
+				assert_big("9223372036854775808");
+				assert_big("-9223372036854775809");
+				assert_big("1208925819614629174706175");
+				assert_integer(100000000000); // back to a small integer
+				assert_string("int");
+				auto& h = next();
+				assert(h.type == data::Real && h.real == 9223372036854775808.0L);
+
+				// products of wide operands stay small while they fit
+				assert_integer(9223372030926249001);
+				assert_integer(INT64_MIN);
+				assert_big("9223372037000250000");
+				assert_end();
+			}
+			{ // strings
+				run("join [a:String] [b:String] = a + b\njoin 'ab' 'cd'\n('a' + 'b') + 'c'\n"
+					"glue [a] [b] = a + b\nglue 'x' 'y', glue 'x' 1\n'x' + 1");
+				assert_string("abcd");
+				assert_string("abc");
+				assert_string("xy");
+				assert_error("invalid operands, numbers expected");
+				assert_error("invalid operands, strings expected");
+				assert_end();
+
+				// building by appending is linear, the result is a rope
+				std::string items = "0";
+				for (int i = 1; i < 500; i++)
+					items += "," + std::to_string(i);
+				run("build [s:String] [a,b..] = build (s + 'abcdefghij') b\nbuild [s] [r] = s\n"
+					"build '' (" + items + ")");
+				auto& s = next();
+				assert(s.type == data::String && s.text.size() == 5000 && !s.text.isInline());
+				assert(s.text[4999] == 'j');
+				assert_end();
+			}
+			{ // parameter patterns
+				run("swap [a,b] { b, a }\nswap (1, 2)");
+				assert_integer(2);
+				assert_integer(1);
+				assert_end();
+
+				run("head [a,b..] = a\ntail [a..,b] = b\nrest [a,b..] = b\nhead (1, 2, 3)\ntail (1, 2, 3)\nrest (1, 2, 3)\nrest (1, 2)\nhead 7");
+				assert_integer(1);
+				assert_integer(3);
+				auto& rest = next();
+				assert(rest.type == data::Sequence && rest.items.size() == 2 && rest.items[0].integer == 2);
+				assert_integer(2);
+				assert_integer(7);
+				assert_end();
+
+				run("kind [x:Integer] = 'int'\nkind [x:String|Bool] = 'text'\nkind [x] = 'other'\n"
+					"kind 1, kind 'a', kind true, kind 1.5\n"
+					"pick [x:Integer|Real] = x\npick 'a'");
+				assert_string("int");
+				assert_string("text");
+				assert_string("text");
+				assert_string("other");
+				assert_error("no matching variant");
+				assert_end();
+
+				run("sum [x:Integer] [y:Integer] = x + y\nsum [x] [y] = 0\nsum 1 2, sum 1 'a'");
+				assert_integer(3);
+				assert_integer(0);
+				assert_end();
+
+				// rest slices share the sequence, recursion over it is linear
+				auto walk = [&](size_t n) {
+					std::string items = "0";
+					for (size_t i = 1; i < n; i++)
+						items += "," + std::to_string(i);
+					auto before = bench::allocations();
+					run("count [n] [a,b..] = count (n + 1) b\ncount [n] [r] = n\ncount 0 (" + items + ")");
+					assert_integer((data::integer_t)n);
+					assert_end();
+					return bench::allocations() - before;
+				};
+				auto small = walk(2000), large = walk(8000);
+				assert(large < small * 6);
+			}
+			{ // partial application
+				run("add [a] [b] = a + b\nadd3to = add 3\nadd3to 6\nmake [n] = add n\nmake 1 2\n"
+					"twice [f] [x] = f (f x)\ntwice add3to 1, twice (make 2) 1");
+				assert_integer(9);
+				assert_integer(3);
+				assert_integer(7);
+				assert_integer(5);
+				assert_end();
+
+				// closures stay flat, and apply once saturated
+				run("sum [a] [b] [c] = (a + b) + c\napp [f] [x] = f x\n"
+					"app (app sum 1) 2\napp (app (app sum 1) 2) 3\napp 1 2");
+				auto& fn = next();
+				assert(fn.type == data::Closure && fn.items.size() == 2);
+				assert(_tables[(size_t)fn.integer].symbol == "sum");
+				assert_integer(6);
+				assert_integer(1); // not a closure, values side by side
+				assert_integer(2);
+				assert_end();
+			}
+			{ // nested definitions capture enclosing parameters
+				run("make [a] { [c] { a + c } }\napp [f] [x] = f x\napp (make 1) 2, make 3 4");
+				assert_integer(3);
+				assert_integer(7);
+				assert_end();
+				run("outer [a] { inner [c] = a + c\nother [d] = inner d\nother 5 }\nouter 1");
+				assert_integer(6);
+				assert_end();
+
+				// through two levels, and into variants
+				run("outer [a] { mid [b] { inner [c] = (a + b) + c\ninner 100 }\nmid 10 }\nouter 1");
+				assert_integer(111);
+				assert_end();
+				run("down [a] { f [n:String] = a\nf [n] = f 'done'\nf 3 }\ndown 7");
+				assert_integer(7);
+				assert_end();
+			}
+			{ // tail call output appends to caller output
+				run("f { 1 \n g } \n g { 2, 3 } \n f");
+				assert_integer(1);
+				assert_integer(2);
+				assert_integer(3);
+				assert_end();
+			}
+			{ // errors are values
+				run("unresolved");
+				assert_error("unresolved symbol 'unresolved'");
+				assert_end();
+
+				run("ident [x] = x\nident 1 2");
+				assert_error("invalid number of arguments, 1 expected");
+				assert_end();
+			}
+			{ // registers stop below Output
+				std::string values, names, args;
+				for (int i = 1; i <= 300; i++) {
+					values += " " + std::to_string(i);
+					names += " [a" + std::to_string(i) + "]";
+				}
+				run(values);
+				for (int i = 1; i <= 300; i++)
+					assert_integer(i);
+				assert_end();
+
+				// more live arguments than registers
+				run("wide" + names + " = a300\nwide" + values);
+				assert_error("too many registers");
+				assert_end();
+				for (auto& t : _tables)
+					assert(t.registers <= Output);
+
+				run("pick [x:Integer]" + names + " = 1\npick [x]" + names + " = 2\npick 0" + values);
+				assert_error("too many registers");
+				assert_end();
+			}
+			{ // objects
+				// { x = 1, x = 2, y = 3 }, then x
+				auto mem = one();
+				_tables = { table{ "object", mem, {
+					op(SET, 1),
+					op(EXTEND, 0, 0, 1, "x"),
+					op(ADD, 1, 1, 1),
+					op(EXTEND, 0, 0, 1, "x"),
+					op(EXTEND, 0, 0, 1, "y"),
+					op(MEMBER, 2, 0, 0, "x"),
+					op(EMIT, 0, 2),
+					op(MEMBER, 2, 0, 0, "z"),
+					op(EMIT, 0, 2),
+					op(EMIT, 0, 0),
+				}, {}, 0, 3, false, {}, {}, {} } };
+				link(_tables);
+				_out = execute(_tables);
+				_index = 0;
+				assert_integer(2);
+				assert_error("missing member 'z'");
+				auto& obj = next();
+				assert(obj.type == data::Object && obj.items.size() == 2);
+				assert(obj.layout == extend(extend(empty(), "x"), "y"));
+				assert_end();
+
+				// member access on parameters, sites see several shapes
+				auto src = tokenize("get [p] = p.x");
+				_tables = generate(parse(src, "get [p] = p.x"));
+				link(_tables);
+				value a = {};
+				a.type = data::Object;
+				a.layout = extend(empty(), "x");
+				a.items = { integer(7) };
+				value b = a;
+				b.layout = extend(extend(empty(), "y"), "x");
+				b.items = { integer(0), integer(8) };
+				_out = execute(_tables, 1, { a });
+				auto more = execute(_tables, 1, { b });
+				_out.insert(_out.end(), more.begin(), more.end());
+				more = execute(_tables, 1, { integer(1) });
+				_out.insert(_out.end(), more.begin(), more.end());
+				_index = 0;
+				assert_integer(7);
+				assert_integer(8);
+				assert_error("invalid operand, object expected");
+				assert_end();
+
+				// sets are objects of their public members, extensions included
+				run("point { y = 2\nx = 1\n.h = 3\nscale [k] = k * 10 }\npoint.z = 5\n"
+					"show [p] { p.x, p.z, p.scale 4 }\nshow point, show point\npoint");
+				for (int i = 0; i < 2; i++) {
+					assert_integer(1);
+					assert_integer(5);
+					assert_integer(40);
+				}
+				auto& set = next();
+				assert(set.type == data::Object && set.layout->members.size() == 4);
+				assert(set.layout->members[0] == "scale" && set.items[0].type == data::Closure);
+				assert(*set.layout->slots.find("z") == 3 && !set.layout->slots.find("h"));
+				assert_end();
+
+				// past the site cache, members come from the dispatch rows of sets
+				std::string sets, calls;
+				for (int i = 0; i < 8; i++) {
+					sets += "s" + std::to_string(i) + " { x = " + std::to_string(i) + "\n";
+					for (int j = 0; j < i; j++)
+						sets += "a" + std::to_string(j) + " = 0\n";
+					sets += "}\n";
+					calls += "get s" + std::to_string(i) + "\n";
+				}
+				run(sets + "get [p] = p.x\n" + calls + calls);
+				for (int round = 0; round < 2; round++)
+					for (int i = 0; i < 8; i++)
+						assert_integer(i);
+				assert_end();
+			}
+			{ // deep tail recursion runs in constant frames
+				_tables = { countdown("count", "count", TAILCALL) };
+				invoke(1000000);
+				assert_integer(0);
+				assert_end();
+
+				// mutual recursion
+				_tables = {
+					countdown("even", "odd", TAILCALL),
+					countdown("odd", "even", TAILCALL),
+				};
+				invoke(1000001);
+				assert_integer(0);
+				assert_end();
+
+				// same depth without tail calls overflows into an error value
+				_tables = { countdown("count", "count", CALL) };
+				invoke(1000000);
+				assert_error("stack overflow");
+			}
+		}
+
+	}
+}
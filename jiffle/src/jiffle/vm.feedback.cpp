@@ -0,0 +1,146 @@
+#include "vm.h"
+
+#include <cstring>
+#include <functional>
+#include <sstream>
+
+namespace jiffle {
+	namespace vm {
+
+		static const char* Header = "jiffle profile 1";
+
+		// symbols as they are written, the root has none
+		static std::string written(const std::string& symbol) {
+			return symbol.empty() ? "(root)" : symbol;
+		}
+
+		std::map<size_t, std::string> sites(const table& t) {
+			std::map<size_t, std::string> out;
+			std::vector<bool> seen(t.start.size());
+
+			// from the start, outcomes in key order, so code shared by several
+			// outcomes of a test is named by the lowest
+			std::function<void(size_t, const std::string&)> walk = [&](size_t pc, const std::string& path) {
+				for (; pc < t.start.size() && !seen[pc]; pc++) {
+					seen[pc] = true;
+					auto& in = t.start[pc];
+					switch (in.opcode) {
+					case SWITCH: {
+						out[pc] = path;
+						data::type_info info;
+						memcpy(&info, &t.memory[in.addr.index], sizeof(info));
+						for (size_t k = 0; k < info.bytelen / sizeof(uint32_t); k++) {
+							uint32_t target;
+							memcpy(&target, &t.memory[in.addr.index + sizeof(info) + k * sizeof(uint32_t)], sizeof(target));
+							walk(target, path + "/" + std::to_string(k));
+						}
+						return;
+					}
+					case IFZ: case IFNZ: case IFL: case IFLE: case IFG: case IFGE:
+						out[pc] = path;
+						walk(pc + 1, path + "/0");
+						walk(pc + 2, path + "/1");
+						return;
+					case JUMP:
+						walk(in.addr.index, path);
+						return;
+					case TAILCALL: case RETURN:
+						return;
+					default:
+						break;
+					}
+				}
+			};
+			walk(0, "");
+			return out;
+		}
+
+		std::string save(const profile& prof, const std::vector<table>& tables) {
+			std::string out = std::string(Header) + "\n";
+			for (size_t i = 0; i < prof.tables.size() && i < tables.size(); i++)
+				if (prof.tables[i].calls)
+					out += "call " + written(tables[i].symbol) + " " + std::to_string(prof.tables[i].calls) + "\n";
+
+			std::map<size_t, std::map<size_t, std::string>> paths;
+			for (auto& b : prof.branches) {
+				auto table = b.first.first;
+				if (table >= tables.size())
+					continue;
+				if (!paths.count(table))
+					paths[table] = sites(tables[table]);
+				auto path = paths[table].find(b.first.second);
+				if (path == paths[table].end())
+					continue;
+				out += "branch " + written(tables[table].symbol) + " " + (path->second.empty() ? "/" : path->second);
+				for (auto n : b.second)
+					out += " " + std::to_string(n);
+				out += "\n";
+			}
+
+			// arithmetic sites by their order among the table's dynamic arithmetics
+			for (auto& o : prof.operands) {
+				auto table = o.first.first;
+				if (table >= tables.size())
+					continue;
+				auto& code = tables[table].start;
+				size_t site = 0;
+				for (size_t i = 0; i < o.first.second && i < code.size(); i++)
+					site += code[i].opcode >= DADD && code[i].opcode <= DMOD;
+				for (auto& types : o.second)
+					out += "operands " + written(tables[table].symbol) + " " + std::to_string(site) + " "
+						+ std::to_string(types.first.first) + " " + std::to_string(types.first.second) + " "
+						+ std::to_string(types.second) + "\n";
+			}
+			return out;
+		}
+
+		bool load(const std::string& text, feedback& out) {
+			std::istringstream in(text);
+			std::string line;
+			if (!std::getline(in, line) || line != Header)
+				return false;
+			out = feedback();
+			while (std::getline(in, line)) {
+				if (line.empty())
+					continue;
+				std::istringstream fields(line);
+				std::string kind, symbol;
+				if (!(fields >> kind >> symbol))
+					return false;
+				if (symbol == "(root)")
+					symbol.clear();
+
+				if (kind == "call") {
+					uint64_t n;
+					if (!(fields >> n))
+						return false;
+					out.calls[symbol] += n;
+				}
+				else if (kind == "branch") {
+					std::string path;
+					std::vector<uint64_t> counts;
+					uint64_t n;
+					if (!(fields >> path) || path[0] != '/')
+						return false;
+					while (fields >> n)
+						counts.push_back(n);
+					if (!fields.eof())
+						return false;
+					out.branches[symbol][path == "/" ? std::string() : path] = counts;
+				}
+				else if (kind == "operands") {
+					size_t site;
+					unsigned a, b;
+					uint64_t n;
+					if (!(fields >> site >> a >> b >> n))
+						return false;
+					out.operands[symbol][site][{ (data::type)a, (data::type)b }] += n;
+				}
+				else
+					return false;
+			}
+			return true;
+		}
+
+	}
+}
@@ -0,0 +1,171 @@
+#include "vm.h"
+#include <assert.h>
+
+namespace jiffle {
+	namespace vm {
+
+		void feedback_test() {
+			using namespace syntax;
+			using namespace expr;
+
+			// internal state -------------------------------------------------
+			std::vector<expr::node> _modules;
+			std::vector<table> _tables;
+
+			// methods --------------------------------------------------------
+			auto compile = [&](const std::string& input, const feedback& guide) {
+				auto src = tokenize(input);
+				_modules = { parse(src, input) };
+				_tables = generate(_modules, guide);
+				link(_tables);
+			};
+			auto index = [&](const std::string& symbol) {
+				for (size_t i = 0; i < _tables.size(); i++)
+					if (_tables[i].symbol == symbol)
+						return i;
+				return npos;
+			};
+			auto integers = [&]() {
+				std::string out;
+				for (auto& v : execute(_tables))
+					out += std::to_string(v.integer) + " ";
+				return out;
+			};
+			// pc of the first instruction with opcode
+			auto first = [](const table& t, opcode op) {
+				for (size_t pc = 0; pc < t.start.size(); pc++)
+					if (t.start[pc].opcode == op)
+						return pc;
+				return npos;
+			};
+			auto same = [](const instruction& a, const instruction& b) {
+				return a.opcode == b.opcode && a.reg == b.reg && a.a == b.a && a.b == b.b
+					&& a.addr.symbol == b.addr.symbol && a.addr.index == b.addr.index;
+			};
+			auto calls = [](const table& t) {
+				size_t n = 0;
+				for (auto& in : t.start)
+					n += in.opcode == CALL || in.opcode == TAILCALL;
+				return n;
+			};
+
+			const std::string kinds = "kind [x:Integer] = 1\nkind [x:Real] = 2\nkind [x] = 3\nkind 1, kind 2.0, kind 'a', kind 'b', kind 'c'";
+
+			// tests ----------------------------------------------------------
+
+			{ // sites named by outcome paths from the start
+				compile(kinds, {});
+				auto& t = _tables[index("kind")];
+				auto named = sites(t);
+				assert(!named.empty() && named.begin()->second.empty());
+				assert(t.start[named.begin()->first].opcode == SWITCH);
+				for (auto& s : named)
+					assert(s.second.empty() || s.second[0] == '/');
+				assert(sites(_tables[0]).empty());
+			}
+			{ // save and load round trip
+				compile(kinds, {});
+				auto k = index("kind");
+				auto root = sites(_tables[k]).begin()->first;
+				profile prof;
+				prof.tables.resize(_tables.size());
+				prof.tables[0].calls = 1;
+				prof.tables[k].calls = 5;
+				prof.branches[{ k, root }] = { 1, 0, 4 };
+				prof.operands[{ 0, 0 }][{ data::Integer, data::Real }] = 7;
+				auto text = save(prof, _tables);
+
+				feedback guide;
+				assert(load(text, guide));
+				assert(guide.calls.at("") == 1 && guide.calls.at("kind") == 5);
+				assert(guide.branches.at("kind").at("") == std::vector<uint64_t>({ 1, 0, 4 }));
+				assert(guide.operands.at("").at(0).at({ data::Integer, data::Real }) == 7);
+				assert(save(prof, _tables) == text);
+			}
+			{ // malformed profiles
+				feedback guide;
+				assert(!load("", guide));
+				assert(!load("jiffle profile 2\n", guide));
+				assert(!load("jiffle profile 1\ncall f\n", guide));
+				assert(!load("jiffle profile 1\nbranch f 2 1\n", guide));
+				assert(!load("jiffle profile 1\nbranch f / 1 x\n", guide));
+				assert(!load("jiffle profile 1\njump f 1\n", guide));
+				assert(load("jiffle profile 1\n\ncall (root) 1\n", guide) && guide.calls.at("") == 1);
+			}
+			{ // busiest outcome laid out first, same results
+				compile(kinds, {});
+				auto plain = _tables[index("kind")];
+				auto before = integers();
+
+				feedback guide;
+				guide.branches["kind"][""] = { 0, 0, 9 };
+				compile(kinds, guide);
+				auto& laid = _tables[index("kind")];
+				assert(integers() == before);
+				assert(laid.start.size() == plain.start.size());
+
+				// another variant is called right after the switch
+				auto s = first(laid, SWITCH);
+				assert(s != npos && s == first(plain, SWITCH));
+				auto called = first(laid, TAILCALL);
+				assert(called > s && !same(laid.start[called], plain.start[called]));
+
+				// a guide without the symbol keeps the unguided layout
+				feedback other;
+				other.branches["elsewhere"][""] = { 1 };
+				compile(kinds, other);
+				auto& kept = _tables[index("kind")];
+				assert(kept.start.size() == plain.start.size());
+				for (size_t pc = 0; pc < kept.start.size(); pc++)
+					assert(same(kept.start[pc], plain.start[pc]));
+			}
+			{ // busy definitions unfold past the body limit, within the growth budget
+				const std::string code = "many { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 }\nmany\nmany";
+				compile(code, {});
+				auto before = integers();
+
+				_modules = { parse(tokenize(code), code) };
+				assert(unfold(_modules) == 0);
+
+				feedback guide;
+				guide.calls[""] = 1;
+				guide.calls["many"] = 2;
+				_modules = { parse(tokenize(code), code) };
+				assert(unfold(_modules, guide) == 1);
+				_tables = generate(_modules);
+				link(_tables);
+				assert(integers() == before);
+				assert(calls(_tables[0]) == 1);
+
+				// rare ones keep the plain limit
+				guide.calls[""] = 1000;
+				_modules = { parse(tokenize(code), code) };
+				assert(unfold(_modules, guide) == 0);
+			}
+			{ // execute records outcomes and operand types
+				compile(kinds + "\nmix [a] [b] = a + b\nmix 1 2.5", {});
+				profile prof;
+				execute(_tables, prof);
+				if (Profiling) {
+					auto k = index("kind");
+					auto recorded = prof.branches.find({ k, sites(_tables[k]).begin()->first });
+					assert(recorded != prof.branches.end());
+					uint64_t n = 0;
+					for (auto c : recorded->second)
+						n += c;
+					assert(n == 5);
+					auto mixed = prof.operands.begin();
+					assert(mixed != prof.operands.end() && mixed->first.first == index("mix"));
+					assert(mixed->second.at({ data::Integer, data::Real }) == 1);
+
+					feedback guide;
+					assert(load(save(prof, _tables), guide) && guide.calls.at("kind") == 5);
+					assert(guide.branches.at("kind").count("") && guide.operands.at("mix").at(0).size() == 1);
+				}
+				else
+					assert(prof.branches.empty() && prof.operands.empty());
+			}
+		}
+
+	}
+}
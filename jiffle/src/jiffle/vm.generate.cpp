@@ -1,15 +1,905 @@
 #include "vm.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <set>
+#include <unordered_map>
 
 namespace jiffle {
 	namespace vm {
 
-		std::vector<table> generate(const expr::node& ast) {
+		// every module's declarations are gathered, then the roots of every
+		// module (part npos) or of one part are generated, laid out by a
+		// profile when guided
+		static std::vector<table> generateModules(const std::vector<const expr::node*>& modules, size_t part, const std::string& partRoot,
+			const feedback* guide = nullptr) {
+			using namespace expr;
+			trace::scope span("generate", "compile");
+
+			// internal state -------------------------------------------------
+			struct scope {
+				std::string path;									// owner table symbol
+				std::map<std::string, unsigned char> parameters;	// name to register
+				std::map<std::string, std::string> definitions;		// name to table symbol
+				const scope* parent;
+				std::map<std::string, data::type> types;			// specified parameter types
+			};
+			struct context {
+				size_t table;			// index of generated table
+				const scope* names;		// visible symbols
+				unsigned char next;		// next free register
+				std::vector<std::pair<const node*, unsigned char>> values;	// expression and register holding its value
+			};
+			struct pooled {
+				size_t table;			// owner of the constant
+				const node* literal;	// first literal encoded
+				size_t offset;			// constant in table memory
+			};
 			std::vector<table> _tables;
+			size_t _anonymous = 0;
+			std::map<std::string, std::map<std::string, std::string>> _members;	// set symbol to member name to symbol
+			std::map<const node*, std::string> _symbols;						// declared object to table symbol
+			std::map<std::string, std::vector<const node*>> _declarations;		// table symbol to declared objects
+			std::map<std::string, size_t> _arity;								// table symbol to parameter count
+			expr::pool _pool;													// anonymous definitions by structure
+			std::unordered_multimap<size_t, pooled> _constants;					// table and literal hash to constants
+			std::map<std::pair<std::string, size_t>, std::string> _shared;		// scope and definition id to anonymous table
+			std::set<size_t> _overflowed;										// tables needing registers past Output
+			std::map<std::string, std::vector<std::string>> _captures;			// table symbol to enclosing parameters it binds first
+			std::map<std::string, node> _references;							// captured names as evaluated by callers
+
+			// methods --------------------------------------------------------
+
+			// stateless
+			auto isDefinition = [](const node& n) {
+				if (n.type != expr::Object)
+					return false;
+				for (auto& i : n.items)
+					if (i.type == expr::Definition || i.type == expr::DefinitionSequence)
+						return true;
+				return false;
+			};
+			auto isDeclaration = [&](const node& eval) {
+				return eval.items.size() == 1
+					&& isDefinition(eval.items.front())
+					&& !eval.items.front().text.empty();
+			};
+			auto pathOf = [](const std::string& path, const std::string& name) {
+				return path.empty() ? name : path + "." + name;
+			};
+			auto symbolOf = [&](const scope& s, const std::string& name) {
+				return pathOf(s.path, name);
+			};
+			auto parentOf = [](const std::string& path) {
+				auto dot = path.rfind('.');
+				return dot == std::string::npos ? std::string() : path.substr(0, dot);
+			};
+			auto isPrivate = [](const node& obj) {
+				// '.foo' is private to its set
+				return !obj.text.empty() && obj.text[0] == '.';
+			};
+			auto nameOf = [&](const node& obj) {
+				return isPrivate(obj) ? obj.text.substr(1) : obj.text;
+			};
+			auto isExtension = [&](const node& obj) {
+				// 'set.member' adds to another set
+				return nameOf(obj).find('.') != std::string::npos;
+			};
+			auto isMember = [](const scope& s, const std::string& name) {
+				// member access on a parameter 'p.x'
+				auto dot = name.find('.');
+				return dot != std::string::npos && s.parameters.count(name.substr(0, dot));
+			};
+			auto parameterName = [](const node& p) {
+				// single symbol parameter '[x]', or '[x:Type]'
+				if (p.items.size() != 1 || p.items.front().items.size() != 1)
+					return std::string();
+				auto& item = p.items.front().items.front();
+				if (item.type != expr::Object || !item.items.empty())
+					return std::string();
+				return item.text;
+			};
+			auto specification = [](const std::string& name) {
+				auto colon = name.find(':');
+				auto spec = colon == std::string::npos ? std::string() : name.substr(colon + 1);
+				if (spec == "Integer") return data::Integer;
+				if (spec == "Real") return data::Real;
+				if (spec == "String") return data::String;
+				if (spec == "Bool") return data::Bool;
+				if (spec == "Sequence") return data::Sequence;
+				if (spec == "Object") return data::Object;
+				return data::Void;
+			};
+			auto element = [&](const node& eval) {
+				// 'x', 'x:Integer|Real', 'x..'
+				pattern::element e = {};
+				if (eval.items.size() != 1)
+					return e;
+				auto& item = eval.items.front();
+				if (item.type != expr::Object || !item.items.empty())
+					return e;
+				auto text = item.text;
+				if (text.size() > 2 && text.compare(text.size() - 2, 2, "..") == 0) {
+					e.rest = true;
+					text.resize(text.size() - 2);
+				}
+				auto colon = text.find(':');
+				e.name = text.substr(0, colon);
+				while (colon != std::string::npos) {
+					auto bar = text.find('|', colon + 1);
+					e.types.push_back(specification(":" + text.substr(colon + 1, bar - colon - 1)));
+					colon = bar;
+				}
+				return e;
+			};
+			auto patternOf = [&](const node& p) {
+				pattern out = { p.items.size() > 1 || (p.flags & flags::ExplicitStructure), {} };
+				for (auto& eval : p.items)
+					out.elements.push_back(element(eval));
+				return out;
+			};
+			auto isSet = [&](const node& obj) {
+				// no parameters, and members only
+				auto members = false;
+				for (auto& d : obj.items) {
+					if (d.type == expr::Parameter)
+						return false;
+					if (d.type != expr::Definition && d.type != expr::DefinitionSequence)
+						continue;
+					for (auto& eval : d.items) {
+						if (!isDeclaration(eval))
+							return false;
+						members = true;
+					}
+				}
+				return members;
+			};
+			auto isPlain = [&](const node& obj) {
+				// parameters are single values with at most one type
+				for (auto& p : obj.items) {
+					if (p.type != expr::Parameter)
+						continue;
+					auto pat = patternOf(p);
+					if (pat.sequence || (!pat.elements.empty() && (pat.elements[0].rest || pat.elements[0].types.size() > 1)))
+						return false;
+				}
+				return true;
+			};
+			auto isArithmetic = [](const node& eval) {
+				// 'a + b'
+				if (eval.items.size() != 3)
+					return false;
+				auto& op = *std::next(eval.items.begin());
+				return op.type == expr::Object && op.items.empty() && op.text.size() == 1
+					&& std::string("+-*/%").find(op.text[0]) != std::string::npos;
+			};
+			auto parseInteger = [](const std::string& text) {
+				if (text.size() > 2 && text[0] == '0') {
+					switch (text[1]) {
+					case 'x': case 'X': return number::parse(text.substr(2), 16);
+					case 'o': case 'O': return number::parse(text.substr(2), 8);
+					case 'b': case 'B': return number::parse(text.substr(2), 2);
+					}
+				}
+				return number::parse(text, 10);
+			};
+			// names a definition object refers to without binding them,
+			// nested definitions included
+			std::function<void(const node&, std::set<std::string>, std::set<std::string>&)> freeNames =
+				[&](const node& n, std::set<std::string> bound, std::set<std::string>& out) {
+				if (n.type == expr::Object && n.items.empty()) {
+					auto head = n.text.substr(0, n.text.find('.'));
+					if (!bound.count(head))
+						out.insert(head);
+					return;
+				}
+				if (isDefinition(n)) {
+					for (auto& p : n.items)
+						if (p.type == expr::Parameter)
+							for (auto& e : patternOf(p).elements)
+								bound.insert(e.name);
+					for (auto& d : n.items)
+						if (d.type == expr::Definition || d.type == expr::DefinitionSequence)
+							for (auto& eval : d.items)
+								if (isDeclaration(eval) && !isExtension(eval.items.front()))
+									bound.insert(nameOf(eval.items.front()));
+				}
+				for (auto& i : n.items)
+					if (i.type != expr::Parameter)
+						freeNames(i, bound, out);
+			};
+
+			// statefull
+			auto emit = [&](context& c, opcode op, unsigned char reg, unsigned char a = 0, unsigned char b = 0, address addr = {}) {
+				_tables[c.table].start.push_back(instruction{ op, reg, a, b, addr });
+			};
+			auto alloc = [&](context& c) {
+				// register numbers stop below Output, the table evaluates to an error
+				if (c.next >= Output) {
+					_overflowed.insert(c.table);
+					return (unsigned char)(Output - 1);
+				}
+				auto r = c.next++;
+				auto& t = _tables[c.table];
+				if (t.registers < c.next)
+					t.registers = c.next;
+				return r;
+			};
+			auto release = [&](context& c, unsigned char next) {
+				// frees registers from next on, with the values they held
+				c.next = next;
+				c.values.erase(std::remove_if(c.values.begin(), c.values.end(),
+					[&](const std::pair<const node*, unsigned char>& v) { return v.second >= next; }), c.values.end());
+			};
+			auto constant = [&](context& c, data::type type, const void* payload, size_t len) {
+				return encode(_tables[c.table], type, payload, len);
+			};
+			auto encoded = [&](context& c, const node& n) {
+				switch (n.type) {
+				case expr::True:
+				case expr::False: {
+					data::bool_t b = n.type == expr::True;
+					return constant(c, data::Bool, &b, sizeof(b));
+				}
+				case expr::Integer: {
+					auto big = parseInteger(n.text);
+					data::integer_t i;
+					if (number::small(big, i))
+						return constant(c, data::Integer, &i, sizeof(i));
+					// sign byte, then limbs
+					std::vector<uint8_t> payload(1 + big.limbs.size() * sizeof(uint32_t), big.negative);
+					memcpy(&payload[1], big.limbs.data(), big.limbs.size() * sizeof(uint32_t));
+					return constant(c, data::BigInteger, payload.data(), payload.size());
+				}
+				case expr::Real: {
+					data::real_t r = std::strtold(n.text.c_str(), nullptr);
+					return constant(c, data::Real, &r, sizeof(r));
+				}
+				case expr::String:
+					return constant(c, data::String, n.text.data(), n.text.size());
+				case expr::Error:
+				case expr::SyntaxError:
+					return constant(c, data::Error, n.text.data(), n.text.size());
+				default:
+					return constant(c, data::Void, nullptr, 0);
+				}
+			};
+			auto literal = [&](context& c, const node& n) {
+				// equal literals of a table share their constant
+				auto h = expr::hash(n) * 31 + c.table;
+				auto range = _constants.equal_range(h);
+				for (auto it = range.first; it != range.second; it++)
+					if (it->second.table == c.table && expr::equal(*it->second.literal, n))
+						return it->second.offset;
+				auto offset = encoded(c, n);
+				_constants.emplace(h, pooled{ c.table, &n, offset });
+				return offset;
+			};
+			auto resolve = [](const scope* s, const std::string& name, std::string& symbol) {
+				// composition path 'a.b' resolves by its head
+				auto dot = name.find('.');
+				auto head = name.substr(0, dot);
+				auto rest = dot == std::string::npos ? std::string() : name.substr(dot);
+				for (; s; s = s->parent) {
+					auto it = s->definitions.find(name);
+					if (it != s->definitions.end()) {
+						symbol = it->second;
+						return true;
+					}
+					it = s->definitions.find(head);
+					if (it != s->definitions.end()) {
+						symbol = it->second + rest;
+						return true;
+					}
+				}
+				symbol = name; // unresolved, reported on evaluation
+				return false;
+			};
+
+			// whole program pass, gathers members of every set before generating
+			// so extensions from any module are visible inside their set
+			auto gather = [&](const std::vector<const node*>& roots) {
+				std::vector<std::pair<std::string, const node*>> extensions;
+				std::function<void(const std::string&, const std::list<node>&)> declarations;
+				auto add = [&](const std::string& path, const node& obj) {
+					auto symbol = pathOf(path, nameOf(obj));
+					_members[parentOf(symbol)][symbol.substr(symbol.rfind('.') + 1)] = symbol;
+					_symbols[&obj] = symbol;
+					_declarations[symbol].push_back(&obj);
+					_arity.emplace(symbol, std::count_if(obj.items.begin(), obj.items.end(),
+						[](const node& p) { return p.type == expr::Parameter; }));
+					for (auto& d : obj.items)
+						if (d.type == expr::Definition || d.type == expr::DefinitionSequence)
+							declarations(symbol, d.items);
+				};
+				declarations = [&](const std::string& path, const std::list<node>& items) {
+					for (auto& eval : items) {
+						if (!isDeclaration(eval))
+							continue;
+						if (isExtension(eval.items.front()))
+							extensions.push_back({ path, &eval.items.front() });
+						else
+							add(path, eval.items.front());
+					}
+				};
+				for (auto root : roots)
+					declarations("", root->items);
+
+				// extensions resolve their set by the nearest enclosing definition
+				for (size_t i = 0; i < extensions.size(); i++) {
+					auto path = extensions[i].first;
+					auto& obj = *extensions[i].second;
+					auto name = nameOf(obj);
+					auto head = name.substr(0, name.find('.'));
+					for (auto p = path;; p = parentOf(p)) {
+						auto set = _members.find(p);
+						if (set != _members.end() && set->second.count(head)) {
+							path = p;
+							break;
+						}
+						if (p.empty())
+							break;
+					}
+					add(path, obj);
+				}
+			};
+
+			// known calls, from the gathered declarations ----------------------
+
+			auto captured = [&](const std::string& symbol) {
+				auto it = _captures.find(symbol);
+				return it == _captures.end() ? 0 : it->second.size();
+			};
+			auto arityOf = [&](const std::string& symbol) {
+				auto it = _arity.find(symbol);
+				return it == _arity.end() ? npos : it->second + captured(symbol);
+			};
+			// symbol of a name seen from inside a declared table, empty when
+			// it isn't a definition (as resolve, by gathered members only)
+			auto lookup = [&](std::string path, const std::string& name) {
+				auto dot = name.find('.');
+				auto head = name.substr(0, dot);
+				auto rest = dot == std::string::npos ? std::string() : name.substr(dot);
+				for (;; path = parentOf(path)) {
+					auto set = _members.find(path);
+					if (set != _members.end()) {
+						auto it = set->second.find(name);
+						if (it != set->second.end())
+							return it->second;
+						it = set->second.find(head);
+						if (it != set->second.end())
+							return it->second + rest;
+					}
+					if (path.empty())
+						return std::string();
+				}
+			};
+			// single evaluation of a single declaration without definitions,
+			// null when its body does anything else
+			auto onlyEvaluation = [&](const std::string& symbol) -> const node* {
+				auto it = _declarations.find(symbol);
+				if (it == _declarations.end() || it->second.size() != 1)
+					return nullptr;
+				const node* only = nullptr;
+				for (auto& d : it->second.front()->items) {
+					if (d.type != expr::Definition && d.type != expr::DefinitionSequence)
+						continue;
+					for (auto& eval : d.items) {
+						if (only || isDeclaration(eval) || eval.items.empty())
+							return nullptr;
+						only = &eval;
+					}
+				}
+				return only;
+			};
+			// called definition of an evaluation inside a declared table
+			auto calleeOf = [&](const std::string& symbol, const node& eval) {
+				auto& head = eval.items.front();
+				if (head.type != expr::Object || !head.items.empty())
+					return std::string();
+				for (auto& p : _declarations[symbol].front()->items)
+					if (p.type == expr::Parameter && parameterName(p).substr(0, parameterName(p).find(':')) == head.text)
+						return std::string();
+				return lookup(symbol, head.text);
+			};
+
+			// a definition without parameters partially applying a known
+			// function to literals ('add3to = add 3') is that function with
+			// the literals bound first, so calls go straight to it
+			auto expand = [&](std::string& symbol, std::vector<const node*>& args) {
+				for (size_t depth = 0; depth < 16; depth++) {
+					auto eval = onlyEvaluation(symbol);
+					if (!eval || arityOf(symbol) != 0)
+						return;
+					auto callee = calleeOf(symbol, *eval);
+					auto arity = arityOf(callee);
+					auto declared = _declarations.find(callee);
+					if (arity == npos || eval->items.size() - 1 >= arity || captured(callee)
+						|| declared == _declarations.end() || isPrivate(*declared->second.front()))
+						return;
+					std::vector<const node*> bound;
+					for (auto it = std::next(eval->items.begin()); it != eval->items.end(); it++) {
+						if (it->type & expr::STRUCTURE_BIT)
+							return;
+						bound.push_back(&*it);
+					}
+					bound.insert(bound.end(), args.begin(), args.end());
+					args.swap(bound);
+					symbol = callee;
+				}
+			};
+			// whether a definition evaluates to a closure, a partial
+			// application or a definition with parameters in its body
+			// (directly or through saturated calls)
+			std::function<bool(const std::string&, size_t)> closes = [&](const std::string& symbol, size_t depth) {
+				auto eval = onlyEvaluation(symbol);
+				if (!eval || depth > 16)
+					return false;
+				auto& head = eval->items.front();
+				if (eval->items.size() == 1 && isDefinition(head))
+					return std::any_of(head.items.begin(), head.items.end(), [](const node& p) { return p.type == expr::Parameter; });
+				auto callee = calleeOf(symbol, *eval);
+				std::vector<const node*> args;
+				for (auto it = std::next(eval->items.begin()); it != eval->items.end(); it++)
+					args.push_back(&*it);
+				expand(callee, args);
+				auto arity = arityOf(callee);
+				auto argc = args.size() + captured(callee);
+				return arity != npos && (argc < arity || (argc == arity && closes(callee, depth + 1)));
+			};
+
+			std::function<std::string(const node&, const scope&)> define;
+			std::function<void(const std::vector<const node*>&, const scope&)> polymorphic;
+			std::function<void(context&, const node&, bool)> statement;
+			std::function<void(context&, const node&, unsigned char)> evaluate;
+
+			// call of a definition with argument values into register:
+			// fewer arguments than parameters bind a closure, more apply the
+			// closure it evaluates to, otherwise a direct call
+			auto invoke = [&](context& c, std::string symbol, std::vector<const node*> args, unsigned char reg, bool tail) {
+				expand(symbol, args);
+				if (captured(symbol)) {
+					// enclosing parameters go first, as the caller sees them
+					std::vector<const node*> names;
+					for (auto& name : _captures[symbol]) {
+						auto& ref = _references[name];
+						ref.type = expr::Object;
+						ref.text = name;
+						names.push_back(&ref);
+					}
+					args.insert(args.begin(), names.begin(), names.end());
+				}
+				auto arity = arityOf(symbol);
+				auto argc = (unsigned char)args.size();
+				auto over = arity != npos && argc > arity && closes(symbol, 0);
+
+				// arguments in consecutive registers, after the closure when over
+				auto next = c.next;
+				auto base = c.next;
+				if (over)
+					alloc(c);
+				auto first = c.next;
+				for (size_t i = 0; i < args.size(); i++)
+					alloc(c);
+				for (size_t i = 0; i < args.size(); i++)
+					evaluate(c, *args[i], (unsigned char)(first + i));
+
+				if (arity != npos && argc < arity)
+					emit(c, CLOSE, reg, first, argc, { symbol, 0, 0 });
+				else if (over) {
+					auto fn = (unsigned char)(base + arity);
+					emit(c, CALL, fn, first, (unsigned char)arity, { symbol, 0, 0 });
+					emit(c, APPLY, reg, fn, (unsigned char)(argc - arity));
+				}
+				else
+					emit(c, tail ? TAILCALL : CALL, reg, first, argc, { symbol, 0, 0 });
+				release(c, next);
+			};
+
+			// 'a + b' into register, specialized by inferred operand types
+			auto arithmetic = [&](context& c, const node& eval, unsigned char reg) {
+				auto& a = eval.items.front();
+				auto& b = eval.items.back();
+				auto ta = infer(a, c.names->types), tb = infer(b, c.names->types);
+				auto isNumber = [](data::type t) { return t == data::Integer || t == data::Real; };
+
+				// families share operator order
+				auto op = std::string("+-*/%").find(std::next(eval.items.begin())->text[0]);
+				static const opcode integral[] = { ADD, SUB, MUL, DIV, MOD };
+				static const opcode floating[] = { FADD, FSUB, FMUL, FDIV, FMOD };
+				static const opcode dynamic[] = { DADD, DSUB, DMUL, DDIV, DMOD };
+				auto code = op == 0 && (ta == data::String || tb == data::String) ? CONCAT
+					: ta == data::Integer && tb == data::Integer ? integral[op]
+					: isNumber(ta) && isNumber(tb) ? floating[op]
+					: dynamic[op];
+
+				auto next = c.next;
+				auto ra = alloc(c), rb = alloc(c);
+				evaluate(c, a, ra);
+				evaluate(c, b, rb);
+				emit(c, code, reg, ra, rb);
+				release(c, next);
+			};
+
+			// enclosing parameters a definition refers to, directly or through
+			// the definitions it calls; they are bound as its first parameters
+			// and every call passes them on (flat closure conversion)
+			std::function<const std::vector<std::string>&(const std::string&, const std::vector<const node*>&, const scope&)> enclose =
+				[&](const std::string& symbol, const std::vector<const node*>& objs, const scope& parent) -> const std::vector<std::string>& {
+				auto known = _captures.find(symbol);
+				if (known != _captures.end())
+					return known->second; // empty while in progress, breaks cycles
+				auto& out = _captures[symbol];
+				std::set<std::string> names, bound;
+				for (auto obj : objs)
+					freeNames(*obj, {}, names);
+				std::vector<std::string> pending(names.begin(), names.end());
+				for (size_t i = 0; i < pending.size(); i++) {
+					for (auto s = &parent; s; s = s->parent) {
+						if (s->parameters.count(pending[i])) {
+							bound.insert(pending[i]);
+							break;
+						}
+						auto d = s->definitions.find(pending[i]);
+						if (d == s->definitions.end())
+							continue;
+						auto callee = _declarations.find(d->second);
+						if (d->second != symbol && callee != _declarations.end())
+							for (auto& name : enclose(d->second, callee->second, *s))
+								if (names.insert(name).second)
+									pending.push_back(name);
+						break;
+					}
+				}
+				out.assign(bound.begin(), bound.end());
+				return out;
+			};
+
+			// declares definitions of a sequence (order doesn't matter)
+			auto declare = [&](scope& s, const std::list<node>& items) {
+				for (auto& eval : items) {
+					if (!isDeclaration(eval) || isExtension(eval.items.front()))
+						continue;
+					auto& obj = eval.items.front();
+					auto it = _symbols.find(&obj);
+					s.definitions[nameOf(obj)] = it != _symbols.end() ? it->second : symbolOf(s, nameOf(obj));
+					if (it == _symbols.end())
+						_declarations[s.definitions[nameOf(obj)]].push_back(&obj);
+				}
+				for (auto& d : s.definitions) {
+					auto declared = _declarations.find(d.second);
+					if (declared != _declarations.end())
+						enclose(d.second, declared->second, s);
+				}
+			};
+
+			// generates statements of a definition sequence
+			auto body = [&](context& c, scope& s, const std::list<node>& items, bool last) {
+				declare(s, items);
+
+				// last evaluation is in tail position
+				const node* tail = nullptr;
+				for (auto& eval : items)
+					if (!isDeclaration(eval) && last)
+						tail = &eval;
+				// variants of a name are compiled together
+				std::map<std::string, std::vector<const node*>> variants;
+				for (auto& eval : items)
+					if (isDeclaration(eval) && !isExtension(eval.items.front()))
+						variants[nameOf(eval.items.front())].push_back(&eval.items.front());
+
+				for (auto& eval : items) {
+					if (!isDeclaration(eval)) {
+						statement(c, eval, &eval == tail);
+						continue;
+					}
+					auto& obj = eval.items.front();
+					auto it = variants.find(nameOf(obj));
+					if (it == variants.end() || (it->second.size() == 1 && isPlain(obj)))
+						define(obj, s);
+					else if (it->second.front() == &obj)
+						polymorphic(it->second, s);
+				}
+			};
 
+			// table of a definition object, parameters are the given bindings
+			// (name and known type), or the object's own parameters when null
+			auto build = [&](const node& obj, const std::string& symbol, const std::string& set,
+				const scope& parent, const std::vector<std::pair<std::string, data::type>>* bindings) {
+				auto index = _tables.size();
+				_tables.push_back(table{ symbol, {}, {}, {}, 0, 0, false, {}, {}, {} });
+				_tables[index].internal = isPrivate(obj);
 
+				// extensions see the members of their sets
+				std::list<scope> sets;
+				auto outer = &parent;
+				for (auto p = parentOf(symbol); p != parent.path && !p.empty(); p = parentOf(p))
+					sets.push_front(scope{ p, {}, _members[p], nullptr, {} });
+				for (auto& set : sets) {
+					set.parent = outer;
+					outer = &set;
+				}
 
+				scope s = { symbol, {}, _members[set], outer, {} };
+				context c = { index, &s, 0, {} };
+				for (size_t i = 0; !bindings && i < captured(symbol); i++)
+					s.parameters[_captures[symbol][i]] = alloc(c);
+				for (size_t i = 0; bindings && i < bindings->size(); i++) {
+					auto r = alloc(c);
+					s.parameters[(*bindings)[i].first] = r;
+					if ((*bindings)[i].second != data::Void)
+						s.types[(*bindings)[i].first] = (*bindings)[i].second;
+				}
+				for (auto& p : obj.items) {
+					if (p.type != expr::Parameter || bindings)
+						continue;
+					auto r = alloc(c);
+					auto n = parameterName(p);
+					if (n.empty())
+						continue;
+					s.parameters[n.substr(0, n.find(':'))] = r;
+					if (specification(n) == data::Void)
+						continue;
+					s.types[n.substr(0, n.find(':'))] = specification(n);
+					_tables[index].specifications.resize(r + 1, data::Void);
+					_tables[index].specifications[r] = specification(n);
+				}
+				_tables[index].parameters = c.next;
+
+				for (auto& d : obj.items)
+					if (d.type == expr::Definition || d.type == expr::DefinitionSequence)
+						body(c, s, d.items, true);
+
+				// a set evaluates to the object of its public members, in name
+				// order; members with parameters are closures, the others are
+				// evaluated as it's built
+				if (bindings || !isSet(obj))
+					return;
+				auto o = alloc(c), r = alloc(c);
+				emit(c, OBJECT, o);
+				for (auto& m : s.definitions) {
+					auto declared = _declarations.find(m.second);
+					if (declared == _declarations.end() || isPrivate(*declared->second.front()))
+						continue;
+					invoke(c, m.second, {}, r, false);
+					emit(c, EXTEND, o, o, r, { m.first, 0, 0 });
+				}
+				emit(c, EMIT, 0, o);
+			};
+
+			// table of a definition object, returns its symbol; an anonymous
+			// definition identical to one already built in its scope is that table
+			define = [&](const node& obj, const scope& parent) {
+				auto gathered = _symbols.find(&obj);
+				auto anonymous = gathered == _symbols.end() && obj.text.empty();
+				auto id = anonymous ? _pool.intern(obj) : expr::pool::npos;
+				if (anonymous) {
+					auto shared = _shared.find({ parent.path, id });
+					if (shared != _shared.end())
+						return shared->second;
+				}
+				auto symbol = gathered != _symbols.end() ? gathered->second
+					: symbolOf(parent, obj.text.empty() ? partRoot + "#" + std::to_string(++_anonymous) : nameOf(obj));
+				auto index = _tables.size();
+				if (gathered == _symbols.end())
+					enclose(symbol, { &obj }, parent);
+				build(obj, symbol, symbol, parent, nullptr);
+				_arity.emplace(symbol, _tables[index].parameters - captured(symbol));
+				if (anonymous)
+					_shared[{ parent.path, id }] = symbol;
+				return symbol;
+			};
+
+			// variants of a definition, a decision tree over their parameter
+			// patterns tail calls the matching variant table 'symbol#n'
+			polymorphic = [&](const std::vector<const node*>& objs, const scope& parent) {
+				auto symbol = _symbols.count(objs.front()) ? _symbols[objs.front()] : symbolOf(parent, nameOf(*objs.front()));
+				auto index = _tables.size();
+				_tables.push_back(table{ symbol, {}, {}, {}, 0, 0, false, {}, {}, {} });
+				_tables[index].internal = isPrivate(*objs.front());
+				_tables[index].parameters = captured(symbol);
+				for (auto& p : objs.front()->items)
+					if (p.type == expr::Parameter)
+						_tables[index].parameters++;
+
+				std::vector<variant> variants;
+				for (size_t k = 0; k < objs.size(); k++) {
+					variant v = { symbol + "#" + std::to_string(k + 1), {} };
+					std::vector<std::pair<std::string, data::type>> bindings;
+					for (size_t i = 0; i < captured(symbol); i++) {
+						// captured values match anything
+						pattern any = { false, { pattern::element{} } };
+						any.elements[0].name = _captures[symbol][i];
+						v.parameters.push_back(any);
+						bindings.push_back({ any.elements[0].name, data::Void });
+					}
+					for (auto& p : objs[k]->items) {
+						if (p.type != expr::Parameter)
+							continue;
+						v.parameters.push_back(patternOf(p));
+						for (auto& e : v.parameters.back().elements)
+							if (!e.name.empty())
+								bindings.push_back({ e.name, e.types.size() == 1 && !e.rest ? e.types[0] : data::Void });
+					}
+					build(*objs[k], v.symbol, symbol, parent, &bindings);
+					variants.push_back(v);
+				}
+				if (guide && guide->branches.count(symbol))
+					match(_tables[index], variants, guide->branches.at(symbol));
+				else
+					match(_tables[index], variants);
+			};
+
+			// evaluation statement, values are appended to the current output
+			statement = [&](context& c, const node& eval, bool tail) {
+				if (eval.items.empty())
+					return;
+				auto next = c.next;
+				auto& first = eval.items.front();
+				std::string symbol;
+				auto callable = false;
+
+				if (isArithmetic(eval)) {
+					auto r = alloc(c);
+					arithmetic(c, eval, r);
+					emit(c, EMIT, 0, r);
+					release(c, next);
+					return;
+				}
+				if (isDefinition(first)) {
+					symbol = define(first, *c.names);
+					callable = true;
+				}
+				else if (first.type == expr::Object && !c.names->parameters.count(first.text)
+					&& !isMember(*c.names, first.text)) {
+					resolve(c.names, first.text, symbol);
+					callable = true;
+				}
+
+				if (callable) {
+					std::vector<const node*> args;
+					for (auto it = std::next(eval.items.begin()); it != eval.items.end(); it++)
+						args.push_back(&*it);
+					invoke(c, symbol, args, Output, tail);
+				}
+				else if (first.type == expr::Object && eval.items.size() > 1) {
+					// 'f x' applies a parameter, or member, that is a closure
+					auto base = c.next;
+					for (size_t i = 0; i < eval.items.size(); i++)
+						alloc(c);
+					auto r = base;
+					for (auto& item : eval.items)
+						evaluate(c, item, r++);
+					emit(c, APPLY, Output, base, (unsigned char)(eval.items.size() - 1));
+				}
+				else {
+					for (auto& item : eval.items) {
+						auto r = alloc(c);
+						evaluate(c, item, r);
+						emit(c, EMIT, 0, r);
+						release(c, next);
+					}
+				}
+				release(c, next);
+			};
+
+			// single value into register
+			auto compute = [&](context& c, const node& n, unsigned char reg) {
+				std::string symbol;
+				switch (n.type) {
+				case expr::Object: {
+					auto p = c.names->parameters.find(n.text);
+					if (p != c.names->parameters.end()) {
+						emit(c, MOVE, reg, p->second);
+						break;
+					}
+					if (isMember(*c.names, n.text)) {
+						// 'p.x.y' loads members one at a time, each site cached
+						// (an error until objects can be built from source)
+						auto dot = n.text.find('.');
+						emit(c, MOVE, reg, c.names->parameters.at(n.text.substr(0, dot)));
+						while (dot != std::string::npos) {
+							auto next = n.text.find('.', dot + 1);
+							emit(c, MEMBER, reg, reg, 0, { n.text.substr(dot + 1, next - dot - 1), 0, 0 });
+							dot = next;
+						}
+						break;
+					}
+					if (isDefinition(n))
+						symbol = define(n, *c.names);
+					else
+						resolve(c.names, n.text, symbol);
+					invoke(c, symbol, {}, reg, false);
+					break;
+				}
+				case expr::Sequence:
+					// '(a + b)' directly into register
+					if (n.items.size() == 1 && !(n.flags & flags::ExplicitStructure) && isArithmetic(n.items.front())) {
+						arithmetic(c, n.items.front(), reg);
+						break;
+					}
+					emit(c, BEGIN, 0);
+					for (auto& eval : n.items)
+						statement(c, eval, false);
+					emit(c, END, reg, 0, n.flags & flags::ExplicitStructure);
+					break;
+				default:
+					emit(c, SET, reg, 0, 0, { "", literal(c, n), 0 });
+					break;
+				}
+			};
+			// evaluations are pure, so an expression identical to one whose
+			// value is still held in a register is that register
+			evaluate = [&](context& c, const node& n, unsigned char reg) {
+				auto shared = n.type == expr::Sequence
+					|| (n.type == expr::Object && !c.names->parameters.count(n.text));
+				if (shared) {
+					auto held = std::find_if(c.values.begin(), c.values.end(),
+						[&](const std::pair<const node*, unsigned char>& v) { return expr::equal(*v.first, n); });
+					if (held != c.values.end()) {
+						if (held->second != reg)
+							emit(c, MOVE, reg, held->second);
+						return;
+					}
+				}
+				compute(c, n, reg);
+				if (shared)
+					c.values.push_back({ &n, reg });
+			};
+
+			// entry ----------------------------------------------------------
+			auto empty = true;
+			for (auto m : modules)
+				empty = empty && m->items.empty();
+			if (empty && part == npos)
+				return _tables;
+
+			gather(modules);
+			scope root = { "", {}, _members[""], nullptr, {} };
+			_tables.push_back(table{ partRoot, {}, {}, {}, 0, 0, false, {}, {}, {} });
+			context c = { 0, &root, 0, {} };
+			for (size_t i = 0; i < modules.size(); i++)
+				if (part == npos || part == i)
+					body(c, root, modules[i]->items, part == i || i + 1 == modules.size());
+
+			for (auto i : _overflowed) {
+				auto& t = _tables[i];
+				std::string text = "too many registers";
+				t.start = { instruction{ SET, Output, 0, 0, { "", encode(t, data::Error, text.data(), text.size()), 0 } },
+					instruction{ RETURN, 0, 0, 0, {} } };
+			}
 			return _tables;
 		}
 
+		std::vector<table> generate(const expr::node& ast) {
+			return generateModules({ &ast }, npos, "");
+		}
+
+		std::vector<table> generate(const std::vector<expr::node>& modules) {
+			std::vector<const expr::node*> roots;
+			for (auto& m : modules)
+				roots.push_back(&m);
+			return generateModules(roots, npos, "");
+		}
+
+		std::vector<table> generate(const std::vector<const expr::node*>& modules) {
+			return generateModules(modules, npos, "");
+		}
+
+		std::vector<table> generate(const std::vector<const expr::node*>& modules, size_t part, const std::string& root) {
+			return generateModules(modules, part, root);
+		}
+
+		std::vector<table> generate(const std::vector<expr::node>& modules, const feedback& guide) {
+			std::vector<const expr::node*> roots;
+			for (auto& m : modules)
+				roots.push_back(&m);
+			return generateModules(roots, npos, "", &guide);
+		}
+
 	}
-}
\ No newline at end of file
+}
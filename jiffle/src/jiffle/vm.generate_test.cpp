@@ -1,5 +1,6 @@
 #include "vm.h"
 #include <assert.h>
+#include <cstring>
 
 namespace jiffle {
 	namespace vm {
@@ -28,6 +29,7 @@ namespace jiffle {
 				_src = tokenize(input);
 				_ast = parse(_src, input);
 				_tables = generate(_ast);
+				_index = 0;
 			};
 			auto nextTable = [&]() {
 				assert(_index < _tables.size());
@@ -43,6 +45,28 @@ namespace jiffle {
 				assert(mem.size() >= offset + data.size());
 				assert(memcmp(&mem[offset], &data[0], data.size()) == 0);
 			};
+			auto assert_table = [&](const std::string& symbol, size_t parameters) {
+				assert(_index < _tables.size());
+				assert(_tables[_index].symbol == symbol);
+				assert(_tables[_index].parameters == parameters);
+			};
+			auto assert_code = [&](const std::vector<opcode>& code) {
+				assert(_index < _tables.size());
+				auto &start = _tables[_index].start;
+				assert(start.size() == code.size());
+				for (size_t i = 0; i < code.size(); i++)
+					assert(start[i].opcode == code[i]);
+			};
+			auto constant = [](data::type t, const void* payload, size_t len) {
+				data::type_info info;
+				memset(&info, 0, sizeof(info));
+				info.type = t;
+				info.bytelen = len;
+				bytes v(sizeof(info) + len);
+				memcpy(&v[0], &info, sizeof(info));
+				memcpy(&v[sizeof(info)], payload, len);
+				return v;
+			};
 
 			// tests ----------------------------------------------------------
 
@@ -52,12 +76,147 @@ namespace jiffle {
 			}
 			{ // constant memory
 				gen("3");
-				//assert_memory(0, b<4>("\x3\0\0\x1"));
+				data::integer_t three = 3;
+				assert_memory(0, constant(data::Integer, &three, sizeof(three)));
+				assert_code({ SET, EMIT });
 
-				//nextTable();
-				//end();
+				nextTable();
+				end();
 			}
+			{ // definitions
+				gen("three = 3\nthree");
+				assert_table("", 0);
+				assert_code({ TAILCALL });
+				nextTable();
+				assert_table("three", 0);
+				assert_code({ SET, EMIT });
+				nextTable();
+				end();
 
+				// nested
+				gen("class { method [x] { x } }");
+				assert_table("", 0);
+				assert_code({});
+				nextTable();
+				assert_table("class", 0);
+				nextTable();
+				assert_table("class.method", 1);
+				assert_code({ MOVE, EMIT });
+				nextTable();
+				end();
+			}
+			{ // member access
+				gen("get [p] = p.x.y\nclass.m = 1\nclass.m");
+				assert_code({ TAILCALL });
+				assert(_tables[0].start[0].addr.symbol == "class.m");
+				nextTable();
+				assert_table("get", 1);
+				assert_code({ MOVE, MEMBER, MEMBER, EMIT });
+				assert(_tables[_index].start[1].addr.symbol == "x");
+				assert(_tables[_index].start[2].addr.symbol == "y");
+
+				// a set builds the object of its public members
+				gen("a { y = 2 \n .h = 1 \n x = 3 }");
+				nextTable();
+				assert_table("a", 0);
+				assert_code({ OBJECT, CALL, EXTEND, CALL, EXTEND, EMIT });
+				assert(_tables[_index].start[2].addr.symbol == "x" && _tables[_index].start[4].addr.symbol == "y");
+			}
+			{ // extensions across modules
+				std::vector<node> modules;
+				for (auto input : { "set { get = m \n .p = 1 }\nset.get", "set.m = p" }) {
+					_src = tokenize(input);
+					modules.push_back(parse(_src, input));
+				}
+				_tables = generate(modules);
+				_index = 0;
+				assert_table("", 0);
+				assert_code({ CALL });
+				nextTable();
+				assert_table("set", 0);
+				nextTable();
+				assert_table("set.get", 0);
+				assert(_tables[_index].start[0].addr.symbol == "set.m");
+				nextTable();
+				assert_table("set.p", 0);
+				assert(_tables[_index].internal);
+				nextTable();
+				assert_table("set.m", 0);
+				assert(_tables[_index].start[0].addr.symbol == "set.p");
+				nextTable();
+				end();
+			}
+			{ // specialized arithmetics
+				gen("square [x:Integer] = x * x\nhalf [x:Real] = x / 2\nany [x] = x + 1");
+				nextTable();
+				assert_table("square", 1);
+				assert(_tables[_index].specifications.size() == 1 && _tables[_index].specifications[0] == data::Integer);
+				assert_code({ MOVE, MOVE, MUL, EMIT });
+				nextTable();
+				assert_table("half", 1);
+				assert_code({ MOVE, SET, FDIV, EMIT });
+				nextTable();
+				assert_table("any", 1);
+				assert(_tables[_index].specifications.empty());
+				assert_code({ MOVE, SET, DADD, EMIT });
+
+				// nested directly into registers
+				gen("(1 + 2) * 3");
+				assert_code({ SET, SET, ADD, SET, MUL, EMIT });
+			}
+			{ // tail position
+				gen("loop [n] { n \n loop n }");
+				nextTable();
+				assert_table("loop", 1);
+				assert_code({ MOVE, EMIT, MOVE, TAILCALL });
+
+				// not last, or inside a sequence
+				gen("f { g \n (g) \n 1 }\ng = 2");
+				nextTable();
+				assert_table("f", 0);
+				assert_code({ CALL, BEGIN, CALL, END, EMIT, SET, EMIT });
+			}
+			{ // partial application
+				gen("add [a] [b] = a + b\nadd3to = add 3\nadd3to 6\nadd3to\nmake [n] = add n\nmake 1 2");
+				// known partial definitions call their function directly
+				assert_code({ SET, SET, CALL, SET, CLOSE, SET, SET, CALL, APPLY });
+				assert(_tables[0].start[2].addr.symbol == "add" && _tables[0].start[2].b == 2);
+				assert(_tables[0].start[7].addr.symbol == "make" && _tables[0].start[7].b == 1);
+				nextTable();
+				assert_table("add", 2);
+				nextTable();
+				assert_table("add3to", 0);
+				assert_code({ SET, CLOSE });
+				nextTable();
+				assert_table("make", 1);
+				assert_code({ MOVE, CLOSE });
+
+				// enclosing parameters are bound first, from the caller's registers
+				gen("make [a] { [c] { a + c } }\nmake 1");
+				nextTable();
+				assert_table("make", 1);
+				assert_code({ MOVE, CLOSE });
+				assert(_tables[1].start[1].b == 1);
+				nextTable();
+				assert(_tables[2].parameters == 2);
+				assert_code({ MOVE, MOVE, DADD, EMIT });
+			}
+			{ // identical subexpressions
+				// evaluated once in a statement, their register reused
+				gen("g = 2\n(g * 3) + (g * 3)");
+				assert_code({ CALL, SET, DMUL, MOVE, DADD, EMIT });
+				gen("f [a] [b] = a\nf (g 1) (g 1), g 1\ng [x] = x");
+				assert_code({ BEGIN, SET, CALL, END, MOVE, CALL, SET, TAILCALL });
+
+				// equal literals share a constant, equal anonymous definitions a table
+				gen("'abc'\n'abc', 'abc'");
+				assert(_tables[0].memory.size() == sizeof(data::type_info) + 3);
+				gen("f [x] = x\nf ({ 1 })\nf ({ 1 })\n{ 2 }");
+				assert(_tables.size() == 4);
+				assert_code({ BEGIN, CALL, END, CALL, BEGIN, CALL, END, CALL, TAILCALL });
+				assert(_tables[0].start[1].addr.symbol == _tables[0].start[5].addr.symbol);
+				assert(_tables[0].start[1].addr.symbol != _tables[0].start[8].addr.symbol);
+			}
 
 		}
 
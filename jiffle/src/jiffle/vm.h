@@ -2,6 +2,18 @@
 
 #include "data.h"
 #include "expr.h"
+#include "number.h"
+#include "persist.h"
+#include "text.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
 
 namespace jiffle {
 	namespace vm {
@@ -14,9 +26,28 @@ namespace jiffle {
 			STORE,	// Stores the value of a register to addressed memory
 			FENCE,	// memory barrier between loads and stores
 			CAS,	// compare and swap atomic operator
+			MOVE,	// Copies a register to another register
+			EMIT,	// Appends the value of a register to the output sequence
+			BEGIN,	// Starts a nested output sequence
+			END,	// Ends nested output sequence into a register
+			OBJECT,	// New object without members into register
+			MEMBER,	// Loads named member of an object register to a register
+			EXTEND,	// Object register with named member set to second register
+			TYPE,	// Type tag of a register as integer
+			COUNT,	// Item count of a register (single value is 1, Void is 0)
+			ITEM,	// Addressed item index of a register, from its end when second operand set
+			SLICE,	// Items of a register from addressed index, dropping second operand items at its end
+			CONCAT,	// String of two string registers joined (shares both, no copy)
+			RECEIVE,	// Takes next value of the process input into register, suspends while empty (Void once closed)
 
 			// Control flow
-			JUMP,	// Unconditional jump to address in register 
+			JUMP,	// Unconditional jump to addressed code index
+			SWITCH,	// Jump through addressed jump table, indexed by integer register (clamped)
+			CALL,	// Evaluates addressed table with argument registers into register
+			TAILCALL,	// Replaces current table with addressed table, appending to same output
+			CLOSE,	// Closure of addressed table binding argument registers (partial application)
+			APPLY,	// Applies closure register to the argument registers following it into register
+			RETURN,	// Ends current table evaluation
 			IFZ,	// Perform next instruction if value in register == 0
 			IFNZ,	// Perform next instruction if value in register != 0
 			IFL,	// Perform next instruction if value in register < 0
@@ -32,21 +63,30 @@ namespace jiffle {
 			NOT,	// bitwise not
 			XOR,	// bitwise xor
 
-			// Integer Arithmetics
+			// Integer Arithmetics (operands known to be integers)
 			ADD,	// addition
 			SUB,	// subtraction
+			MUL,	// multiplication
 			DIV,	// division
 			MOD,	// modulus
 			POW,	// exponentiation
 			MINUS,	// unary minus
 
-			// Floating Point Arithmetics
+			// Floating Point Arithmetics (operands known to be numbers)
 			FADD,	// floating point addition
 			FSUB,	// floating point subtraction
+			FMUL,	// floating point multiplication
 			FDIV,	// floating point division
 			FMOD,	// floating point modulus
 			FPOW,	// floating point exponentiation
 			FMINUS,	// floating point unary minus
+
+			// Dynamic Arithmetics (operand types checked at runtime, element by element over sequences)
+			DADD,	// integer addition, or floating point when not both integers, joins strings
+			DSUB,	// integer subtraction, or floating point when not both integers
+			DMUL,	// integer multiplication, or floating point when not both integers
+			DDIV,	// integer division, or floating point when not both integers
+			DMOD,	// integer modulus, or floating point when not both integers
 		};
 
 		// memory model -------------------------------------------------------
@@ -66,33 +106,496 @@ namespace jiffle {
 		struct address {
 			std::string symbol;
 			size_t index;
+			size_t table;		// dense owner index, resolved by link
 		};
 
+		// register operand referring to the current output sequence
+		constexpr static unsigned char Output = 0xFF;
+
 		// Instructions are executed when a table is loaded and when released
 		struct instruction {
 			opcode opcode;
-			// ...
+			unsigned char reg;		// target register
+			unsigned char a;		// first operand register
+			unsigned char b;		// second operand register, or argument count
+			address addr;			// constant memory, code index or table symbol
 		};
 		
+		struct value;
+
 		struct table {
 			std::string symbol;					// link access reference
 			std::vector<data::byte> memory;		// owned (released after cleanup)
 
 			std::vector<instruction> start;		// executed code on jump to symbol
 			std::vector<instruction> end;		// executed code on cleanup (when symbol never used again)
+
+			size_t parameters;					// arguments, in first registers
+			size_t registers;					// register file size
+			bool internal;						// private to its set ('.name')
+			std::vector<data::type> specifications;	// parameter types, Void when unspecified
+			std::vector<value> constants;			// of SET, decoded (strings interned) by link
+			std::vector<size_t> slots;				// set: object slot by member id, npos when missing (by link)
+		};
+
+		// Parameter pattern of a variant, a single value '[x]', '[x:Integer|Real]',
+		// or a sequence destructured into elements '[a,b]', '[a,b..]', '[a..,b]'.
+		struct pattern {
+			struct element {
+				std::string name;				// bound name, none when empty
+				std::vector<data::type> types;	// alternatives, any when empty
+				bool rest;						// 'b..' binds the remaining items
+			};
+			bool sequence;
+			std::vector<element> elements;
+		};
+
+		// Definition variant, the table evaluated with bound names as arguments
+		struct variant {
+			std::string symbol;
+			std::vector<pattern> parameters;
+		};
+
+		// Member set of a symbol, every 'set.member' definition of the
+		// program (from any module) merged into one dense table.
+		struct set {
+			std::string symbol;
+			size_t table;						// set table, npos when only extended
+			std::vector<std::string> members;	// ordered by name
+			std::vector<size_t> tables;			// member table per slot
+		};
+
+		// Precomputed polymorphic dispatch by dense member id and set:
+		// the member table, and the slot of the member in objects of the
+		// set (its public members in name order), npos where a set doesn't
+		// have the member.
+		struct dispatch {
+			std::vector<set> sets;
+			std::map<std::string, size_t> ids;		// set symbol to set index
+			std::vector<std::string> members;		// public member names by id
+			std::vector<size_t> targets;			// [member * sets.size() + set]
+			std::vector<size_t> slots;				// [member * sets.size() + set]
+		};
+
+		// Cost model of unfold, in expression nodes. An inlined call saves
+		// a frame and its argument passing, worth a body of a few nodes;
+		// the program grows by at most a share of its own size.
+		struct budget {
+			size_t body;	// largest definition body inlined
+			size_t growth;	// nodes added, in percent of the program
+			size_t depth;	// calls inlined into an inlined body
+		};
+
+		// Profile of a run saved for later builds of the same sources, by table
+		// symbol. Branch sites of a table are named by the outcomes leading to
+		// them from its start ('' first, then '/2', '/2/0'), so they survive
+		// a different layout; arithmetic sites count its dynamic arithmetics.
+		struct feedback {
+			typedef std::map<std::pair<data::type, data::type>, uint64_t> types;
+			std::map<std::string, uint64_t> calls;										// symbol to calls
+			std::map<std::string, std::map<std::string, std::vector<uint64_t>>> branches;	// symbol to site to outcomes
+			std::map<std::string, std::map<size_t, types>> operands;					// symbol to site to operand types
+		};
+
+		// Constant memory is a sequence of data::type_info headers,
+		// each followed by bytelen bytes of value data.
+
+		// shapes -------------------------------------------------------------
+
+		// Hidden class of objects, the ordered member names of a layout.
+		// Shapes are immutable and shared: adding a member transitions to a
+		// child shape, so objects extended the same way share one shape,
+		// and member slots are fixed for the lifetime of a shape. A child
+		// shares the member list and slot map of its parent, so extending
+		// an object member by member doesn't copy them.
+		// A set (a definition without parameters declaring only members)
+		// evaluates to an object of its public members, extensions included,
+		// built by EXTEND; 'p.x' on a parameter is a cached MEMBER site.
+		struct shape;
+		typedef std::shared_ptr<const shape> shape_ptr;
+		struct shape {
+			size_t id;								// unique, never reused
+			persist::vector<std::string> members;		// slot order
+			persist::map<std::string, size_t> slots;	// member to slot
+			shape_ptr parent;						// keeps the transition path alive
+		};
+
+		// Member access site cache, remembers slots of the last seen shapes.
+		// An extension yields a new shape, so stale entries never match.
+		struct cache {
+			constexpr static size_t Entries = 4;	// polymorphic limit
+			struct entry {
+				size_t shape;
+				size_t slot;
+			} entries[Entries];
+			size_t count;
+			size_t misses;
+		};
+
+		// values -------------------------------------------------------------
+
+		// register and output sequence content
+		struct value {
+			data::type type;
+			union {
+				data::bool_t boolean;
+				data::integer_t integer;	// Integer, Closure table, Object set table (0 for none, the root is no set)
+				data::real_t real;
+			};
+			text::string text;					// String, Error
+			persist::vector<value> items;		// Sequence, Object slots, Closure bound arguments
+			shape_ptr layout;					// Object
+			std::shared_ptr<const number::integer> big;	// BigInteger, only past 64 bits
 		};
 
 		// TODO: input parameters / external borrowed memory referenced by symbol path and index 
 
+		// shared state -------------------------------------------------------
+
+		// Mutable table memory shared by processes: a cell per addressed
+		// constant (table index and byte offset), holding the constant until
+		// first written. Cells are versioned against a global clock.
+		// Transactions read optimistically and buffer their writes; a commit
+		// locks the written cells (compare and swap on their version),
+		// validates every read and journals old and new values for undo.
+		struct transaction;
+		class state {
+		public:
+			struct cell {
+				std::atomic<uint64_t> version;			// 2 * commit version, +1 while locked
+				std::shared_ptr<const value> current;	// atomic access only
+			};
+			struct change {
+				size_t table;
+				size_t offset;
+				value before;
+				value after;
+				uint64_t version;
+			};
+
+			state() : _clock(0) {}
+
+			// cell of an address, created from the table constant on first use
+			cell& at(const std::vector<table>& tables, size_t table, size_t offset);
+
+			// version of the last commit
+			uint64_t clock() const { return _clock.load(std::memory_order_acquire); }
+
+			// committed changes, oldest first
+			std::vector<change> journal() const;
+
+		private:
+			friend bool commit(transaction& t);
+
+			mutable std::mutex _mutex;	// guards cell creation and journal
+			std::map<std::pair<size_t, size_t>, std::unique_ptr<cell>> _cells;
+			std::vector<change> _journal;
+			std::atomic<uint64_t> _clock;
+		};
+
+		// reads and pending writes of one evaluation, by address
+		struct transaction {
+			state* memory;
+			const std::vector<table>* tables;
+			uint64_t start;		// clock when begun, newer cells conflict
+			std::map<std::pair<size_t, size_t>, uint64_t> reads;
+			std::map<std::pair<size_t, size_t>, value> writes;
+		};
+
+
+		// profiling ----------------------------------------------------------
+
+		// The VM calls a process profiler only when built with JIFFLE_PROFILE,
+		// otherwise the hooks are compiled out and a profile stays empty.
+		// The Profile configuration (Release plus JIFFLE_PROFILE) builds them in.
+#ifdef JIFFLE_PROFILE
+		constexpr static bool Profiling = true;
+#else
+		constexpr static bool Profiling = false;
+#endif
+
+		// Executed instructions by opcode, calls and time by table (inclusive
+		// and exclusive of callees, in ticks: cycles where a counter is cheap),
+		// outcomes of branches and operand types of dynamic arithmetics by
+		// site, and the table stack sampled every interval instructions.
+		class profile {
+		public:
+			struct timing {
+				uint64_t calls;
+				uint64_t inclusive;
+				uint64_t exclusive;
+			};
+
+			std::vector<uint64_t> opcodes;			// by opcode
+			std::vector<timing> tables;				// by table index
+			std::map<std::string, uint64_t> stacks;	// 'root;f;g' to samples
+			std::map<std::pair<size_t, size_t>, std::vector<uint64_t>> branches;	// table and index to count by SWITCH key, or IF* skipping
+			std::map<std::pair<size_t, size_t>, std::map<std::pair<data::type, data::type>, uint64_t>> operands;	// table and index to count by types
+			size_t interval;						// 0 never samples
+
+			explicit profile(size_t interval = 0);
+
+			// cycle counter, or steady clock nanoseconds
+			static uint64_t ticks();
+
+			// hooks, a tail call leaves then enters
+			void executed(unsigned char op, const std::vector<table>& code);
+			void entered(size_t table);
+			void left();
+			void paused();
+			void resumed();
+			void branched(size_t table, size_t index, size_t outcome);
+			void operated(size_t table, size_t index, data::type a, data::type b);
+
+		private:
+			struct open {
+				size_t table;
+				uint64_t start;
+				uint64_t callees;
+			};
+			std::vector<open> _open;	// mirrors the process frames
+			size_t _countdown;
+			uint64_t _paused;
+		};
+
+		// Evaluation of a table, resumable at any instruction.
+		// Frames live on the heap, so a suspended process keeps no C++ stack
+		// and resuming it is a plain call (no context switch).
+		struct process {
+			struct frame {
+				const table* code;
+				size_t pc;
+				std::vector<value> regs;
+				unsigned char ret;		// caller register, or Output
+				size_t output;			// index of its output sequence
+				std::vector<value> rest;	// arguments past the parameters, applied to the result
+			};
+			const std::vector<table>* tables;
+			size_t entry;
+			std::vector<value> args;
+			bool started;
+			std::vector<frame> frames;
+			std::vector<std::vector<value>> outputs;	// open output sequences, first is the result
+			std::vector<std::vector<cache>> caches;		// member sites, per instruction
+			std::deque<value> input;					// taken by RECEIVE
+			std::vector<value> received;				// taken within tx, put back when it retries
+			bool closed;								// no more input will come
+			state* memory;								// LOAD, STORE and CAS within tx when set
+			transaction tx;								// committed when finished, retried on conflict
+			profile* profiler;							// when set (and built with JIFFLE_PROFILE)
+		};
+		enum status : unsigned char {
+			Suspended,	// instruction budget used up
+			Waiting,	// RECEIVE on empty input
+			Finished,	// result in outputs[0]
+		};
+
+		// Runs continuous commands (and any other process) on a fixed pool of
+		// worker threads: many processes per thread, each resumed for a slice
+		// of instructions at a time. A process waiting for input is parked
+		// until a value is sent to it. Output of a process streams to its sink
+		// as soon as it is final, in order, from one thread at a time.
+		class scheduler {
+		public:
+			typedef std::function<void(const value&)> sink;
+			typedef size_t handle;
+
+			static constexpr size_t Slice = 1024;	// instructions per resume
+
+			// zero workers uses every hardware thread
+			explicit scheduler(size_t workers = 0);
+			// waits for every process to finish
+			~scheduler();
+
+			// tables must outlive the process
+			// a process with shared state runs as one transaction,
+			// its output is held back until it commits
+			handle spawn(const std::vector<table>& tables, size_t entry = 0, const std::vector<value>& args = {}, sink out = sink(), state* memory = nullptr);
+
+			// appends to process input, and wakes it when waiting
+			void send(handle h, const value& v);
+			// ends process input, RECEIVE then yields Void
+			void close(handle h);
+
+			// blocks until every spawned process finished
+			void wait();
+
+			size_t workers() const { return _threads.size(); }
+
+		private:
+			struct task;
+
+			std::mutex _mutex;
+			std::condition_variable _ready, _idle;
+			std::deque<std::shared_ptr<task>> _queue;
+			std::map<handle, std::shared_ptr<task>> _tasks;
+			std::vector<std::thread> _threads;
+			handle _next;
+			bool _stop;
+
+			void work();
+			void wake(const std::shared_ptr<task>& t);
+		};
+
 
 		// functions ----------------------------------------------------------
 
-		// first table is the module root
+		// first table is the module root. Calls with fewer arguments than
+		// parameters bind a flat closure, and a definition binding literals
+		// ('add3to = add 3') is called as its function with them prepended.
+		// Nested definitions take the enclosing parameters they use as
+		// their first parameters, passed by every call and closure.
 		std::vector<table> generate(const expr::node& ast);
 
+		// whole program, module roots run in order as the first table.
+		// Members of a set are gathered from every module first,
+		// so extensions are visible inside their set.
+		std::vector<table> generate(const std::vector<expr::node>& modules);
+		std::vector<table> generate(const std::vector<const expr::node*>& modules);
+
+		// one module of a program, its root as a table of the given symbol
+		// (and anonymous objects named after it). Declarations of every
+		// module are visible, so parts generated separately link together
+		// under a root calling the part roots in module order.
+		std::vector<table> generate(const std::vector<const expr::node*>& modules, size_t part, const std::string& root);
+
+		// whole program laid out by a profile of earlier runs, the busiest
+		// outcome of each decision tree test first after it
+		std::vector<table> generate(const std::vector<expr::node>& modules, const feedback& guide);
+
+		// inlines calls of small top-level definitions ('three', 'ident x',
+		// 'swap (a, b)') before generate, arguments substituted for their
+		// parameters. Calls stay where inlining could change what a name
+		// or an operator means, and recursive definitions stay calls.
+		// Returns the calls inlined.
+		size_t unfold(std::vector<expr::node>& modules, const budget& limits = { 16, 50, 4 });
+
+		// as unfold, definitions a profile shows busy inline with larger bodies
+		size_t unfold(std::vector<expr::node>& modules, const feedback& guide, const budget& limits = { 16, 50, 4 });
+
+		// module at part unfolded into a copy, the others read only for
+		// their declarations. Only calls of the part's own definitions are
+		// inlined, so the copy depends on what other modules show as
+		// generate of a part does.
+		size_t unfold(const std::vector<const expr::node*>& modules, size_t part, expr::node& into, const budget& limits = { 16, 50, 4 });
+
+		// runs one step of compile, named after it
+		typedef std::function<void(const char*, const std::function<void()>&)> stage;
+
+		// whole program as the command line and the compile server build it:
+		// unfolded (by a profile when guided), generated and linked, the
+		// given trees left unchanged. Each step goes through measure when
+		// given ('unfold', 'generate', 'link').
+		std::vector<table> compile(const std::vector<const expr::node*>& modules, std::vector<std::string>& unresolved,
+			const feedback* guide = nullptr, const stage& measure = nullptr);
+
+		// resolves addresses to dense table indices, and checks call arity
+		// and private access. Failing instructions are replaced by error
+		// constants, returns unresolved symbols. Constants of SET are decoded
+		// once, addr.table of a SET is its slot in the table's constants.
+		// Set tables get their row of the merged dispatch, and MEMBER its
+		// dense member id as addr.index (npos when no set has the member).
+		std::vector<std::string> link(std::vector<table>& tables);
+
+		// compiles variant patterns into a decision tree appended to table code,
+		// the first matching variant is tail called with its bound names.
+		// Any property of an argument is tested at most once on each path.
+		void match(table& t, const std::vector<variant>& variants);
+
+		// as match, tests lay out their busiest outcome first by site outcomes
+		void match(table& t, const std::vector<variant>& variants, const std::map<std::string, std::vector<uint64_t>>& taken);
+
+		// merges member tables of every set, and their dispatch tables
+		dispatch merge(const std::vector<table>& tables);
+
+		// evaluates a linked table (module root by default), returns its output sequence
+		std::vector<value> execute(const std::vector<table>& tables, size_t entry = 0, const std::vector<value>& args = {});
+
+		// evaluates a linked table as one transaction over shared state,
+		// the evaluation is retried until it commits
+		std::vector<value> execute(const std::vector<table>& tables, state& memory, size_t entry = 0, const std::vector<value>& args = {});
+
+		// evaluates a linked table as execute does, counted into a profile
+		std::vector<value> execute(const std::vector<table>& tables, profile& prof, size_t entry = 0, const std::vector<value>& args = {});
+
+		// sampled stacks in collapsed format, 'root;f;g count' per line
+		// (the input of flamegraph tools)
+		std::string collapsed(const profile& prof);
+
+		// opcode counts and table times, busiest first
+		std::string summary(const profile& prof, const std::vector<table>& tables);
+
+		// compact text of a profile, by symbol as feedback reads it
+		std::string save(const profile& prof, const std::vector<table>& tables);
+
+		// feedback of saved profile text, false when it isn't one
+		bool load(const std::string& text, feedback& out);
+
+		// paths of the branch sites of a table (as feedback names them) by index
+		std::map<size_t, std::string> sites(const table& t);
+
+		// mnemonic of an opcode
+		const char* name(opcode op);
+
+		// process of a linked table, not running until resumed
+		process start(const std::vector<table>& tables, size_t entry = 0, const std::vector<value>& args = {}, state* memory = nullptr);
+
+		// runs a process for at most budget instructions
+		status resume(process& p, size_t budget);
+
+		// static type of a value expression, parameters typed by their
+		// specification ('x:Integer'). Void when only known at runtime.
+		data::type infer(const expr::node& n, const std::map<std::string, data::type>& parameters);
+
+		// appends a constant to table memory, returns its byte offset
+		size_t encode(table& t, data::type type, const void* payload, size_t len);
+
+		// constant at byte offset of table memory
+		value decode(const table& t, size_t offset);
+
+		// shape without members
+		shape_ptr empty();
+
+		// transition to shape with an added member (shared between callers)
+		shape_ptr extend(const shape_ptr& s, const std::string& member);
+
+		// transaction over shared state, seeing commits up to now
+		transaction begin(state& s, const std::vector<table>& tables);
+
+		// value at address as seen by the transaction,
+		// false when a newer commit changed it (the transaction must retry)
+		bool read(transaction& t, size_t table, size_t offset, value& out);
+
+		// buffered until commit
+		void write(transaction& t, size_t table, size_t offset, const value& v);
+
+		// publishes the writes atomically, false (nothing written) on conflict
+		bool commit(transaction& t);
+
+		// reverts every change committed after version, as a new commit
+		void rollback(state& s, const std::vector<table>& tables, uint64_t version);
+
+		// member slot of shape through site cache, npos when missing
+		constexpr static size_t npos = (size_t)-1;
+		size_t member(cache& c, const shape& s, const std::string& name);
+		// as member, a miss takes the slot from the dispatch row of a set
+		// by member id, and probes the shape only where the row has none
+		size_t member(cache& c, const shape& s, const std::string& name, const std::vector<size_t>& row, size_t id);
+
 		// tests --------------------------------------------------------------
 		
+		void infer_test();
+		void match_test();
 		void generate_test();
+		void unfold_test();
+		void link_test();
+		void merge_test();
+		void execute_test();
+		void shape_test();
+		void schedule_test();
+		void state_test();
+		void profile_test();
+		void feedback_test();
 
 	}
 }
\ No newline at end of file
@@ -0,0 +1,64 @@
+#include "vm.h"
+
+#include <iterator>
+
+namespace jiffle {
+	namespace vm {
+
+		data::type infer(const expr::node& n, const std::map<std::string, data::type>& parameters) {
+			// methods --------------------------------------------------------
+			auto isArithmetic = [](const expr::node& eval) {
+				if (eval.type != expr::Evaluation || eval.items.size() != 3)
+					return false;
+				auto& op = *std::next(eval.items.begin());
+				return op.type == expr::Object && op.items.empty() && op.text.size() == 1
+					&& std::string("+-*/%").find(op.text[0]) != std::string::npos;
+			};
+
+			auto op = [](const expr::node& eval) {
+				return std::next(eval.items.begin())->text[0];
+			};
+
+			// entry ----------------------------------------------------------
+			switch (n.type) {
+			case expr::True:
+			case expr::False:
+				return data::Bool;
+			case expr::Integer:
+				return data::Integer;
+			case expr::Real:
+				return data::Real;
+			case expr::String:
+				return data::String;
+			case expr::Object: {
+				auto it = parameters.find(n.text);
+				return it == parameters.end() || !n.items.empty() ? data::Void : it->second;
+			}
+			case expr::Sequence:
+				// '(x)' is x
+				if (n.items.size() == 1 && !(n.flags & expr::flags::ExplicitStructure))
+					return infer(n.items.front(), parameters);
+				return data::Void;
+			case expr::Evaluation: {
+				if (n.items.size() == 1)
+					return infer(n.items.front(), parameters);
+				if (!isArithmetic(n))
+					return data::Void;
+				auto a = infer(n.items.front(), parameters);
+				auto b = infer(n.items.back(), parameters);
+				// integer division may give an error, left to dynamic arithmetic
+				if (a == data::Integer && b == data::Integer)
+					return op(n) == '/' || op(n) == '%' ? data::Void : data::Integer;
+				if (a == data::String && b == data::String && op(n) == '+')
+					return data::String;
+				if ((a == data::Integer || a == data::Real) && (b == data::Integer || b == data::Real))
+					return data::Real;
+				return data::Void;
+			}
+			default:
+				return data::Void;
+			}
+		}
+
+	}
+}
@@ -0,0 +1,60 @@
+#include "vm.h"
+#include <assert.h>
+
+namespace jiffle {
+	namespace vm {
+
+		void infer_test() {
+			using namespace syntax;
+			using namespace expr;
+
+			// internal state -------------------------------------------------
+			std::map<std::string, data::type> _parameters = {
+				{ "i", data::Integer },
+				{ "r", data::Real },
+			};
+
+			// methods --------------------------------------------------------
+			auto assert_type = [&](const std::string& input, data::type t) {
+				auto src = tokenize(input);
+				auto ast = parse(src, input);
+				assert(ast.items.size() == 1);
+				assert(infer(ast.items.front(), _parameters) == t);
+			};
+
+			// tests ----------------------------------------------------------
+
+			{ // literals
+				assert_type("1", data::Integer);
+				assert_type("1.5", data::Real);
+				assert_type("'s'", data::String);
+				assert_type("true", data::Bool);
+				assert_type("null", data::Void);
+			}
+			{ // specified parameters
+				assert_type("i", data::Integer);
+				assert_type("r", data::Real);
+				assert_type("unknown", data::Void);
+			}
+			{ // arithmetics
+				assert_type("i * i", data::Integer);
+				assert_type("i + 1", data::Integer);
+				assert_type("i / r", data::Real);
+				assert_type("(i * 2) - 1.5", data::Real);
+				assert_type("i + unknown", data::Void);
+				assert_type("'s' + 1", data::Void);
+				assert_type("('a' + 'b') + 'c'", data::String);
+				assert_type("'a' - 'b'", data::Void);
+				assert_type("(1, 2)", data::Void);
+
+				// integer division and modulus may give an error
+				assert_type("i / 2", data::Void);
+				assert_type("i % i", data::Void);
+				assert_type("(i / 0) + 1", data::Void);
+				assert_type("(i % 0) * 1.5", data::Void);
+				assert_type("r / 2", data::Real);
+			}
+		}
+
+	}
+}
@@ -0,0 +1,131 @@
+#include "vm.h"
+#include "trace.h"
+
+#include <map>
+
+namespace jiffle {
+	namespace vm {
+
+		std::vector<std::string> link(std::vector<table>& tables) {
+			trace::scope span("link", "compile");
+
+			// internal state -------------------------------------------------
+			std::map<std::string, size_t> _symbols;
+			std::vector<std::string> _unresolved;
+
+			// methods --------------------------------------------------------
+
+			// instruction evaluates to an error constant instead
+			auto fail = [&](size_t owner, instruction& in, const std::string& text) {
+				auto& t = tables[owner];
+				in.opcode = SET;
+				in.a = 0;
+				in.b = 0;
+				in.addr.index = encode(t, data::Error, text.data(), text.size());
+			};
+			// constants of a table decoded once, strings interned here
+			// instead of on every SET
+			auto decodeConstants = [&](table& t) {
+				std::map<size_t, size_t> slots;
+				t.constants.clear();
+				for (auto code : { &t.start, &t.end })
+					for (auto& in : *code) {
+						if (in.opcode != SET)
+							continue;
+						auto slot = slots.emplace(in.addr.index, t.constants.size());
+						if (slot.second)
+							t.constants.push_back(decode(t, in.addr.index));
+						in.addr.table = slot.first->second;
+					}
+			};
+			auto resolve = [&](size_t owner, instruction& in) {
+				switch (in.opcode) {
+				case CALL:
+				case TAILCALL:
+				case CLOSE:
+				case LOAD:
+				case STORE:
+				case CAS: {
+					auto it = _symbols.find(in.addr.symbol);
+					if (it == _symbols.end()) {
+						_unresolved.push_back(in.addr.symbol);
+						fail(owner, in, "unresolved symbol '" + in.addr.symbol + "'");
+						break;
+					}
+					auto& target = tables[it->second];
+					if (target.internal) {
+						// private members are only visible inside their set
+						auto dot = target.symbol.rfind('.');
+						auto set = dot == std::string::npos ? std::string() : target.symbol.substr(0, dot + 1);
+						if (tables[owner].symbol.compare(0, set.size(), set) != 0
+							&& tables[owner].symbol + "." != set) {
+							fail(owner, in, "private member '" + in.addr.symbol + "'");
+							break;
+						}
+					}
+					if (in.opcode == CALL || in.opcode == TAILCALL) {
+						if (target.parameters != in.b) {
+							fail(owner, in, "invalid number of arguments, "
+								+ std::to_string(target.parameters) + " expected");
+							break;
+						}
+					}
+					else if (in.opcode == CLOSE) {
+						if (in.b >= target.parameters) {
+							fail(owner, in, "invalid number of arguments, less than "
+								+ std::to_string(target.parameters) + " expected");
+							break;
+						}
+					}
+					else if (in.addr.index >= target.memory.size()) {
+						fail(owner, in, "invalid address");
+						break;
+					}
+					in.addr.table = it->second;
+					break;
+				}
+				default:
+					break;
+				}
+			};
+
+			// entry ----------------------------------------------------------
+			for (size_t i = 0; i < tables.size(); i++)
+				_symbols.emplace(tables[i].symbol, i);
+
+			for (size_t i = 0; i < tables.size(); i++) {
+				for (auto& in : tables[i].start)
+					resolve(i, in);
+				for (auto& in : tables[i].end)
+					resolve(i, in);
+				decodeConstants(tables[i]);
+			}
+
+			// member sites by dense id, each set table its dispatch row
+			auto merged = merge(tables);
+			std::map<std::string, size_t> ids;
+			for (size_t i = 0; i < merged.members.size(); i++)
+				ids.emplace(merged.members[i], i);
+			for (auto& t : tables) {
+				t.slots.clear();
+				for (auto& in : t.start) {
+					if (in.opcode != MEMBER)
+						continue;
+					auto id = ids.find(in.addr.symbol);
+					in.addr.index = id == ids.end() ? npos : id->second;
+				}
+			}
+			for (size_t i = 0; i < merged.sets.size(); i++) {
+				if (merged.sets[i].table == npos)
+					continue;
+				auto& row = tables[merged.sets[i].table].slots;
+				row.resize(merged.members.size());
+				for (size_t m = 0; m < merged.members.size(); m++)
+					row[m] = merged.slots[m * merged.sets.size() + i];
+			}
+
+			return _unresolved;
+		}
+
+	}
+}
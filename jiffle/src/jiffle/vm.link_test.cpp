@@ -0,0 +1,101 @@
+#include "vm.h"
+#include <assert.h>
+
+namespace jiffle {
+	namespace vm {
+
+		void link_test() {
+			using namespace syntax;
+			using namespace expr;
+
+			// internal state -------------------------------------------------
+			std::vector<table> _tables;
+			std::vector<std::string> _unresolved;
+
+			// methods --------------------------------------------------------
+			auto lnk = [&](const std::string& input) {
+				auto src = tokenize(input);
+				auto ast = parse(src, input);
+				_tables = generate(ast);
+				_unresolved = link(_tables);
+			};
+			auto find = [&](size_t table, opcode op) -> const instruction& {
+				assert(table < _tables.size());
+				for (auto& in : _tables[table].start)
+					if (in.opcode == op)
+						return in;
+				assert(false);
+				return _tables[table].start.front();
+			};
+			auto assert_error = [&](size_t table, const std::string& text) {
+				for (auto& in : _tables[table].start) {
+					if (in.opcode != SET)
+						continue;
+					auto& v = _tables[table].constants[in.addr.table];
+					if (v.type == data::Error && v.text == text)
+						return;
+				}
+				assert(false);
+			};
+			auto op = [](opcode o, const std::string& symbol, size_t index = 0) {
+				return instruction{ o, 0, 0, 0, { symbol, index, 0 } };
+			};
+
+			// tests ----------------------------------------------------------
+
+			{ // calls resolve to dense table indices
+				lnk("f = 1\ng = f\ng");
+				assert(_unresolved.empty());
+				assert(_tables.size() == 3);
+				assert(find(0, TAILCALL).addr.table == 2);
+				assert(find(2, TAILCALL).addr.table == 1);
+				assert(find(1, SET).addr.table == 0);
+				assert(_tables[1].constants.size() == 1 && _tables[1].constants[0].integer == 1);
+			}
+			{ // constants decoded once, strings interned
+				lnk("f = 'longer than inline strings are'\n'longer than inline strings are'\nf");
+				auto& root = _tables[0].constants;
+				auto& f = _tables[1].constants;
+				assert(root.size() == 1 && f.size() == 1 && root[0].type == data::String);
+				assert(root[0].text.data() == f[0].text.data());
+				assert(execute(_tables).size() == 2);
+			}
+			{ // nested symbols
+				lnk("outer { inner = 5 \n inner }\nouter");
+				assert(_unresolved.empty());
+				assert(_tables[find(1, TAILCALL).addr.table].symbol == "outer.inner");
+			}
+			{ // unresolved symbols become error constants
+				lnk("missing\nother 1");
+				assert(_unresolved.size() == 2);
+				assert(_unresolved[0] == "missing");
+				assert(_unresolved[1] == "other");
+				assert_error(0, "unresolved symbol 'missing'");
+				assert_error(0, "unresolved symbol 'other'");
+			}
+			{ // arity is checked once
+				lnk("ident [x] = x\nident 1 2");
+				assert(_unresolved.empty());
+				assert_error(0, "invalid number of arguments, 1 expected");
+			}
+			{ // private members
+				lnk("s { .p = 1 \n q = p }\ns.q\ns.p");
+				assert(_unresolved.empty());
+				assert(_tables[find(0, CALL).addr.table].symbol == "s.q");
+				assert_error(0, "private member 's.p'");
+			}
+			{ // memory addresses are bounds checked
+				_tables = {
+					table{ "data", { 0 }, {}, {}, 0, 0, false, {}, {}, {} },
+					table{ "code", {}, { op(LOAD, "data", 0), op(LOAD, "data", 1), op(STORE, "none") }, {}, 0, 0, false, {}, {}, {} },
+				};
+				_unresolved = link(_tables);
+				assert(_unresolved.size() == 1 && _unresolved[0] == "none");
+				assert(_tables[1].start[0].opcode == LOAD && _tables[1].start[0].addr.table == 0);
+				assert_error(1, "invalid address");
+				assert_error(1, "unresolved symbol 'none'");
+			}
+		}
+
+	}
+}
@@ -0,0 +1,258 @@
+#include "vm.h"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <tuple>
+
+namespace jiffle {
+	namespace vm {
+
+		// outcomes of each test are laid out busiest first when taken counts
+		// them by site path, otherwise in key order
+		static void compileMatch(table& t, const std::vector<variant>& variants, const std::map<std::string, std::vector<uint64_t>>* taken) {
+			// internal state -------------------------------------------------
+
+			// argument, or one of its items
+			struct position {
+				size_t arg;
+				size_t index;		// npos for the whole argument
+				bool fromEnd;
+				bool operator<(const position& o) const {
+					return std::tie(arg, index, fromEnd) < std::tie(o.arg, o.index, o.fromEnd);
+				}
+				bool operator==(const position& o) const {
+					return arg == o.arg && index == o.index && fromEnd == o.fromEnd;
+				}
+			};
+			enum property { Type, Count };
+			struct test {
+				position at;
+				property of;
+				uint32_t types;		// accepted type tags
+				size_t count;		// items, or at least when rest
+				bool rest;
+			};
+			struct binding {
+				position at;
+				bool slice;			// items from index, dropping 'drop' at the end
+				unsigned char drop;
+			};
+			struct row {
+				size_t variant;
+				std::vector<test> tests;	// pending, in dependency order
+				std::vector<binding> bindings;
+			};
+			static const size_t Types = data::Closure + 1;
+
+			// methods --------------------------------------------------------
+
+			// stateless
+			auto mask = [](const std::vector<data::type>& types) {
+				uint32_t m = 0;
+				for (auto type : types) {
+					m |= 1u << type;
+					if (type == data::Integer || type == data::Real) // big integers too
+						m |= 1u << data::BigInteger;
+					if (type == data::Real) // integers are numbers too
+						m |= 1u << data::Integer;
+				}
+				return m;
+			};
+			auto accepts = [](const test& x, size_t key, size_t keys) {
+				if (x.of == Type)
+					return (x.types >> key & 1) != 0;
+				if (x.rest)
+					return key >= x.count;
+				return key == x.count && key + 1 < keys;
+			};
+
+			// statefull
+			auto emit = [&](opcode op, unsigned char reg, unsigned char a = 0, unsigned char b = 0, address addr = {}) {
+				t.start.push_back(instruction{ op, reg, a, b, addr });
+			};
+			auto use = [&](size_t reg) {
+				if (t.registers < reg + 1)
+					t.registers = reg + 1;
+			};
+			auto load = [&](const position& at, unsigned char reg) {
+				if (at.index == npos)
+					emit(MOVE, reg, (unsigned char)at.arg);
+				else
+					emit(ITEM, reg, (unsigned char)at.arg, at.fromEnd, { "", at.index, 0 });
+			};
+
+			// rows of the variants, tests ordered so counts come before items
+			auto rows = [&]() {
+				std::vector<row> out;
+				for (size_t v = 0; v < variants.size(); v++) {
+					auto& params = variants[v].parameters;
+					if (params.size() != t.parameters)
+						continue; // never matches this arity
+					row r = { v, {}, {} };
+					for (size_t i = 0; i < params.size(); i++) {
+						auto& p = params[i];
+						position whole = { i, npos, false };
+						if (!p.sequence) {
+							if (p.elements.empty())
+								continue;
+							auto& e = p.elements.front();
+							if (!e.types.empty())
+								r.tests.push_back({ whole, Type, mask(e.types), 0, false });
+							if (!e.name.empty())
+								r.bindings.push_back({ whole, false, 0 });
+							continue;
+						}
+						auto m = p.elements.size();
+						auto restAt = m;
+						for (size_t j = 0; j < m; j++)
+							if (p.elements[j].rest)
+								restAt = j;
+						auto rest = restAt < m;
+						r.tests.push_back({ whole, Count, 0, rest ? m - 1 : m, rest });
+						for (size_t j = 0; j < m; j++) {
+							auto& e = p.elements[j];
+							if (j == restAt) {
+								if (!e.name.empty())
+									r.bindings.push_back({ { i, j, false }, true, (unsigned char)(m - 1 - j) });
+								continue;
+							}
+							position at = j < restAt ? position{ i, j, false } : position{ i, m - 1 - j, true };
+							if (!e.types.empty())
+								r.tests.push_back({ at, Type, mask(e.types), 0, false });
+							if (!e.name.empty())
+								r.bindings.push_back({ at, false, 0 });
+						}
+					}
+					out.push_back(r);
+				}
+				return out;
+			};
+
+			std::function<size_t(const std::vector<row>&, std::map<position, unsigned char>, size_t, const std::string&)> compile;
+			compile = [&](const std::vector<row>& rs, std::map<position, unsigned char> loaded, size_t next, const std::string& path) {
+				auto start = t.start.size();
+				auto fail = [&](const std::string& text) {
+					emit(SET, Output, 0, 0, { "", encode(t, data::Error, text.data(), text.size()), 0 });
+					emit(RETURN, 0);
+					return start;
+				};
+
+				// no variant left
+				if (rs.empty())
+					return fail("no matching variant");
+
+				// first variant fully matched, bind and evaluate it
+				// (register numbers stop below Output)
+				auto& first = rs.front();
+				if (next + (first.tests.empty() ? first.bindings.size() : 2) > Output)
+					return fail("too many registers");
+				if (first.tests.empty()) {
+					auto base = next;
+					for (auto& b : first.bindings) {
+						use(next);
+						if (b.slice)
+							emit(SLICE, (unsigned char)next, (unsigned char)b.at.arg, b.drop, { "", b.at.index, 0 });
+						else
+							load(b.at, (unsigned char)next);
+						next++;
+					}
+					emit(TAILCALL, Output, (unsigned char)base, (unsigned char)first.bindings.size(),
+						{ variants[first.variant].symbol, 0, 0 });
+					return start;
+				}
+
+				// test a property once, every row is specialized by its outcome
+				auto x = first.tests.front();
+				unsigned char subject;
+				auto it = loaded.find(x.at);
+				if (x.at.index == npos) {
+					subject = (unsigned char)x.at.arg;
+				}
+				else if (it != loaded.end()) {
+					subject = it->second;
+				}
+				else {
+					subject = (unsigned char)next++;
+					use(subject);
+					load(x.at, subject);
+					loaded[x.at] = subject;
+				}
+				auto key = (unsigned char)next++;
+				use(key);
+				emit(x.of == Type ? TYPE : COUNT, key, subject);
+
+				size_t keys = Types;
+				if (x.of == Count) {
+					keys = 1;
+					for (auto& r : rs)
+						for (auto& y : r.tests)
+							if (y.at == x.at && y.of == Count && y.count + 1 > keys)
+								keys = y.count + 1;
+					keys++; // last key is 'keys - 1 or more'
+				}
+				std::vector<uint32_t> jumps(keys);
+				auto jt = encode(t, data::Address, jumps.data(), keys * sizeof(uint32_t));
+				emit(SWITCH, 0, key, 0, { "", jt, 0 });
+
+				// branches with the same variants share code, reached first by the lowest key
+				std::vector<std::vector<row>> subs(keys);
+				std::map<std::vector<size_t>, size_t> lowest;
+				std::vector<size_t> group(keys);
+				for (size_t k = 0; k < keys; k++) {
+					std::vector<size_t> ids;
+					for (auto& r : rs) {
+						row s = { r.variant, {}, r.bindings };
+						auto keep = true;
+						for (auto& y : r.tests) {
+							if (y.at == x.at && y.of == x.of)
+								keep = keep && accepts(y, k, keys);
+							else
+								s.tests.push_back(y);
+						}
+						if (!keep)
+							continue;
+						subs[k].push_back(s);
+						ids.push_back(r.variant);
+					}
+					group[k] = lowest.emplace(ids, k).first->second;
+				}
+
+				// busiest branch first
+				std::vector<uint64_t> counts(keys);
+				if (taken) {
+					auto site = taken->find(path);
+					for (size_t k = 0; site != taken->end() && k < keys && k < site->second.size(); k++)
+						counts[group[k]] += site->second[k];
+				}
+				std::vector<size_t> order;
+				for (size_t k = 0; k < keys; k++)
+					if (group[k] == k)
+						order.push_back(k);
+				std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return counts[a] > counts[b]; });
+
+				std::vector<size_t> at(keys);
+				for (auto k : order)
+					at[k] = compile(subs[k], loaded, next, path + "/" + std::to_string(k));
+				for (size_t k = 0; k < keys; k++)
+					jumps[k] = (uint32_t)at[group[k]];
+				memcpy(&t.memory[jt + sizeof(data::type_info)], jumps.data(), keys * sizeof(uint32_t));
+				return start;
+			};
+
+			// entry ----------------------------------------------------------
+			if (t.registers < t.parameters)
+				t.registers = t.parameters;
+			compile(rows(), {}, t.parameters, "");
+		}
+
+		void match(table& t, const std::vector<variant>& variants) {
+			compileMatch(t, variants, nullptr);
+		}
+
+		void match(table& t, const std::vector<variant>& variants, const std::map<std::string, std::vector<uint64_t>>& taken) {
+			compileMatch(t, variants, &taken);
+		}
+
+	}
+}
@@ -0,0 +1,117 @@
+#include "vm.h"
+#include <assert.h>
+#include <cstring>
+#include <functional>
+#include <set>
+
+namespace jiffle {
+	namespace vm {
+
+		void match_test() {
+			using namespace syntax;
+			using namespace expr;
+
+			// internal state -------------------------------------------------
+			std::vector<table> _tables;
+
+			// methods --------------------------------------------------------
+			auto gen = [&](const std::string& input) {
+				auto src = tokenize(input);
+				_tables = generate(parse(src, input));
+			};
+			auto find = [&](const std::string& symbol) -> const table& {
+				for (auto& t : _tables)
+					if (t.symbol == symbol)
+						return t;
+				assert(false);
+				return _tables.front();
+			};
+			auto jumps = [](const table& t, const instruction& in) {
+				data::type_info info;
+				memcpy(&info, &t.memory[in.addr.index], sizeof(info));
+				std::vector<uint32_t> out(info.bytelen / sizeof(uint32_t));
+				memcpy(out.data(), &t.memory[in.addr.index + sizeof(info)], info.bytelen);
+				return out;
+			};
+
+			// walks every path of the tree, returns variants reached
+			auto walk = [&](const table& t) {
+				std::set<std::string> reached;
+				std::function<void(size_t, std::set<std::pair<opcode, unsigned char>>)> path;
+				path = [&](size_t pc, std::set<std::pair<opcode, unsigned char>> seen) {
+					for (; pc < t.start.size(); pc++) {
+						auto& in = t.start[pc];
+						if (in.opcode == TYPE || in.opcode == COUNT) {
+							// property of a value never tested twice
+							assert(!seen.count({ in.opcode, in.a }));
+							seen.insert({ in.opcode, in.a });
+						}
+						if (in.opcode == SWITCH) {
+							for (auto target : jumps(t, in))
+								path(target, seen);
+							return;
+						}
+						if (in.opcode == TAILCALL) {
+							reached.insert(in.addr.symbol);
+							return;
+						}
+						if (in.opcode == RETURN) {
+							reached.insert("");
+							return;
+						}
+					}
+				};
+				path(0, {});
+				return reached;
+			};
+
+			// tests ----------------------------------------------------------
+
+			{ // variants share tests
+				gen("kind [x:Integer] = 1\n"
+					"kind [x:String|Bool] = 2\n"
+					"kind [x:Real] = 3\n"
+					"kind [a,b] = 4\n"
+					"kind [a,b..] = 5\n"
+					"kind [a..,b:Integer] = 6\n");
+				auto& t = find("kind");
+				assert(t.parameters == 1);
+				auto reached = walk(t);
+				for (size_t k = 1; k <= 5; k++)
+					assert(reached.count("kind#" + std::to_string(k)));
+				assert(!reached.count("kind#6")); // shadowed by 'kind [a,b..]'
+				assert(reached.count(""));
+
+				// one type test at the root for all type variants
+				size_t types = 0;
+				for (auto& in : t.start)
+					if (in.opcode == TYPE && in.a == 0)
+						types++;
+				assert(types == 1);
+			}
+			{ // several arguments
+				gen("both [x:Integer] [y:Integer] = 1\n"
+					"both [x:Integer] [y] = 2\n"
+					"both [x] [y:Integer] = 3\n");
+				auto& t = find("both");
+				assert(t.parameters == 2);
+				auto reached = walk(t);
+				assert(reached.size() == 4);
+			}
+			{ // plain single definitions are not dispatched
+				gen("single [x:Integer] = x");
+				assert(_tables.size() == 2 && _tables[1].symbol == "single");
+				assert(_tables[1].specifications.size() == 1);
+			}
+			{ // bindings past the register limit evaluate to an error
+				table t = { "wide", {}, {}, {}, 200, 0, false, {}, {}, {} };
+				variant v = { "wide#1", std::vector<pattern>(200, pattern{ false, { { "x", {}, false } } }) };
+				match(t, { v });
+				auto reached = walk(t);
+				assert(reached.size() == 1 && reached.count(""));
+				assert(t.registers <= Output);
+			}
+		}
+
+	}
+}
@@ -0,0 +1,48 @@
+#include "vm.h"
+
+#include <cstring>
+
+namespace jiffle {
+	namespace vm {
+
+		size_t encode(table& t, data::type type, const void* payload, size_t len) {
+			auto& mem = t.memory;
+			auto offset = mem.size();
+			data::type_info info;
+			memset(&info, 0, sizeof(info)); // deterministic padding bits
+			info.type = type;
+			info.bytelen = len;
+			mem.resize(offset + sizeof(info) + len);
+			memcpy(&mem[offset], &info, sizeof(info));
+			if (len)
+				memcpy(&mem[offset + sizeof(info)], payload, len);
+			return offset;
+		}
+
+		value decode(const table& t, size_t offset) {
+			data::type_info info;
+			memcpy(&info, &t.memory[offset], sizeof(info));
+			auto payload = &t.memory[offset + sizeof(info)];
+			value v = {};
+			v.type = (data::type)info.type;
+			switch (v.type) {
+			case data::Bool: memcpy(&v.boolean, payload, sizeof(v.boolean)); break;
+			case data::Integer: memcpy(&v.integer, payload, sizeof(v.integer)); break;
+			case data::Real: memcpy(&v.real, payload, sizeof(v.real)); break;
+			case data::String: v.text = text::intern((const char*)payload, info.bytelen); break;
+			case data::Error: v.text = text::string((const char*)payload, info.bytelen); break;
+			case data::BigInteger: {
+				// sign byte, then limbs
+				number::integer i = { payload[0] != 0, std::vector<uint32_t>((info.bytelen - 1) / sizeof(uint32_t)) };
+				if (!i.limbs.empty())
+					memcpy(&i.limbs[0], payload + 1, info.bytelen - 1);
+				v.big = std::make_shared<const number::integer>(std::move(i));
+				break;
+			}
+			default: break;
+			}
+			return v;
+		}
+
+	}
+}
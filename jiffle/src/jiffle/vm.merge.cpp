@@ -0,0 +1,74 @@
+#include "vm.h"
+
+namespace jiffle {
+	namespace vm {
+
+		dispatch merge(const std::vector<table>& tables) {
+			// internal state -------------------------------------------------
+			dispatch _d;
+			std::map<std::string, std::map<std::string, size_t>> _members;	// set to ordered members
+			std::map<std::string, size_t> _names;							// public member names
+
+			// methods --------------------------------------------------------
+			auto isAnonymous = [](const std::string& symbol) {
+				return symbol.find('#') != std::string::npos;
+			};
+
+			// entry ----------------------------------------------------------
+
+			// gather members scattered over tables, sets ordered by symbol
+			for (size_t i = 0; i < tables.size(); i++) {
+				auto& symbol = tables[i].symbol;
+				if (symbol.empty() || isAnonymous(symbol))
+					continue;
+				auto dot = symbol.rfind('.');
+				auto set = dot == std::string::npos ? std::string() : symbol.substr(0, dot);
+				_members[set][symbol.substr(dot + 1)] = i;
+				if (!tables[i].internal)
+					_names[symbol.substr(dot + 1)];
+			}
+
+			// dense member table per set
+			for (auto& m : _members) {
+				set s = { m.first, npos, {}, {} };
+				for (auto& member : m.second) {
+					s.members.push_back(member.first);
+					s.tables.push_back(member.second);
+				}
+				_d.ids[s.symbol] = _d.sets.size();
+				_d.sets.push_back(std::move(s));
+			}
+			for (auto& s : _d.sets) {
+				auto dot = s.symbol.rfind('.');
+				auto parent = _members.find(dot == std::string::npos ? std::string() : s.symbol.substr(0, dot));
+				if (parent == _members.end())
+					continue;
+				auto own = parent->second.find(s.symbol.substr(dot + 1));
+				if (own != parent->second.end())
+					s.table = own->second;
+			}
+
+			// dispatch rows, private members are not dispatched
+			for (auto& n : _names) {
+				n.second = _d.members.size();
+				_d.members.push_back(n.first);
+			}
+			// objects of a set hold its public members in name order
+			_d.targets.assign(_d.members.size() * _d.sets.size(), npos);
+			_d.slots.assign(_d.members.size() * _d.sets.size(), npos);
+			for (size_t i = 0; i < _d.sets.size(); i++) {
+				auto& s = _d.sets[i];
+				size_t slot = 0;
+				for (size_t j = 0; j < s.members.size(); j++) {
+					if (tables[s.tables[j]].internal)
+						continue;
+					_d.targets[_names[s.members[j]] * _d.sets.size() + i] = s.tables[j];
+					_d.slots[_names[s.members[j]] * _d.sets.size() + i] = slot++;
+				}
+			}
+
+			return _d;
+		}
+
+	}
+}
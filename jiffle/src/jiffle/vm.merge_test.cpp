@@ -0,0 +1,90 @@
+#include "vm.h"
+#include <assert.h>
+
+namespace jiffle {
+	namespace vm {
+
+		void merge_test() {
+			using namespace syntax;
+			using namespace expr;
+
+			// internal state -------------------------------------------------
+			std::vector<table> _tables;
+			dispatch _d;
+
+			// methods --------------------------------------------------------
+			auto build = [&](const std::vector<std::string>& inputs) {
+				std::vector<node> modules;
+				for (auto& input : inputs) {
+					auto src = tokenize(input);
+					modules.push_back(parse(src, input));
+				}
+				_tables = generate(modules);
+				link(_tables);
+				_d = merge(_tables);
+			};
+			auto setOf = [&](const std::string& symbol) -> const set& {
+				assert(_d.ids.count(symbol));
+				return _d.sets[_d.ids.at(symbol)];
+			};
+			auto idOf = [&](const std::string& member) {
+				size_t id = 0;
+				while (id < _d.members.size() && _d.members[id] != member)
+					id++;
+				assert(id < _d.members.size());
+				return id;
+			};
+			auto target = [&](const std::string& member, const std::string& set) {
+				auto t = _d.targets[idOf(member) * _d.sets.size() + _d.ids.at(set)];
+				return t == npos ? std::string() : _tables[t].symbol;
+			};
+			auto slot = [&](const std::string& member, const std::string& set) {
+				return _d.slots[idOf(member) * _d.sets.size() + _d.ids.at(set)];
+			};
+
+			// tests ----------------------------------------------------------
+
+			{ // extensions from several modules merge into one ordered table
+				build({
+					"a { z = 1 \n .hidden = 2 }\nb { z = 3 }",
+					"a.m = 4\nb.y = 5",
+					"a.b = 6",
+				});
+				auto& a = setOf("a");
+				assert(a.members.size() == 4);
+				assert(a.members[0] == "b" && a.members[1] == "hidden");
+				assert(a.members[2] == "m" && a.members[3] == "z");
+				assert(_tables[a.tables[2]].symbol == "a.m");
+				assert(_tables[a.table].symbol == "a");
+
+				auto& b = setOf("b");
+				assert(b.members.size() == 2 && b.members[0] == "y");
+			}
+			{ // dispatch by member id and set
+				assert(target("z", "a") == "a.z");
+				assert(target("z", "b") == "b.z");
+				assert(target("m", "b").empty());
+				for (auto& m : _d.members)
+					assert(m != "hidden");
+
+				// slots of public members in objects of the set
+				assert(slot("b", "a") == 0 && slot("m", "a") == 1 && slot("z", "a") == 2);
+				assert(slot("y", "b") == 0 && slot("z", "b") == 1 && slot("m", "b") == npos);
+
+				// linked into set tables and member sites
+				auto& row = _tables[setOf("a").table].slots;
+				assert(row.size() == _d.members.size() && row[idOf("z")] == 2);
+				build({ "a { x = 1 }\nget [p] = p.x" });
+				for (auto& t : _tables)
+					if (t.symbol == "get")
+						assert(t.start[1].opcode == MEMBER && t.start[1].addr.index == idOf("x"));
+			}
+			{ // set without own table
+				build({ "x.y = 1" });
+				assert(setOf("x").table == npos);
+				assert(target("y", "x") == "x.y");
+			}
+		}
+
+	}
+}
@@ -0,0 +1,144 @@
+#include "vm.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace jiffle {
+	namespace vm {
+
+		static const char* _names[] = {
+			"SET", "LOAD", "STORE", "FENCE", "CAS", "MOVE", "EMIT", "BEGIN", "END",
+			"OBJECT", "MEMBER", "EXTEND", "TYPE", "COUNT", "ITEM", "SLICE", "CONCAT", "RECEIVE",
+			"JUMP", "SWITCH", "CALL", "TAILCALL", "CLOSE", "APPLY", "RETURN",
+			"IFZ", "IFNZ", "IFL", "IFLE", "IFG", "IFGE",
+			"RSHIFT", "LSHIFT", "AND", "OR", "NOT", "XOR",
+			"ADD", "SUB", "MUL", "DIV", "MOD", "POW", "MINUS",
+			"FADD", "FSUB", "FMUL", "FDIV", "FMOD", "FPOW", "FMINUS",
+			"DADD", "DSUB", "DMUL", "DDIV", "DMOD",
+		};
+		static const size_t Opcodes = sizeof(_names) / sizeof(_names[0]);
+
+		const char* name(opcode op) {
+			return op < Opcodes ? _names[op] : "?";
+		}
+
+		profile::profile(size_t interval) : opcodes(Opcodes), interval(interval), _countdown(interval), _paused(0) {}
+
+		uint64_t profile::ticks() {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+			return __rdtsc();
+#elif defined(__x86_64__) || defined(__i386__)
+			return __builtin_ia32_rdtsc();
+#else
+			return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+		}
+
+		void profile::executed(unsigned char op, const std::vector<table>& code) {
+			if (op < opcodes.size())
+				opcodes[op]++;
+			if (!interval || --_countdown)
+				return;
+			_countdown = interval;
+			std::string stack;
+			for (auto& o : _open) {
+				if (!stack.empty())
+					stack += ';';
+				stack += code[o.table].symbol.empty() ? "(root)" : code[o.table].symbol;
+			}
+			stacks[stack]++;
+		}
+
+		void profile::entered(size_t table) {
+			if (table >= tables.size())
+				tables.resize(table + 1, timing());
+			tables[table].calls++;
+			_open.push_back({ table, ticks(), 0 });
+		}
+
+		void profile::left() {
+			if (_open.empty())
+				return;
+			auto o = _open.back();
+			_open.pop_back();
+			auto inclusive = ticks() - o.start;
+			tables[o.table].inclusive += inclusive;
+			tables[o.table].exclusive += inclusive > o.callees ? inclusive - o.callees : 0;
+			if (!_open.empty())
+				_open.back().callees += inclusive;
+		}
+
+		// a suspended process isn't running, open tables start later instead
+		void profile::paused() {
+			_paused = ticks();
+		}
+
+		void profile::resumed() {
+			if (!_paused)
+				return;
+			auto idle = ticks() - _paused;
+			for (auto& o : _open)
+				o.start += idle;
+			_paused = 0;
+		}
+
+		void profile::branched(size_t table, size_t index, size_t outcome) {
+			auto& counts = branches[{ table, index }];
+			if (outcome >= counts.size())
+				counts.resize(outcome + 1);
+			counts[outcome]++;
+		}
+
+		void profile::operated(size_t table, size_t index, data::type a, data::type b) {
+			operands[{ table, index }][{ a, b }]++;
+		}
+
+		std::string collapsed(const profile& prof) {
+			std::string out;
+			for (auto& s : prof.stacks)
+				out += s.first + " " + std::to_string(s.second) + "\n";
+			return out;
+		}
+
+		std::string summary(const profile& prof, const std::vector<table>& tables) {
+			std::string out;
+			char line[256];
+			std::vector<size_t> order;
+			auto busiest = [&](const std::vector<uint64_t>& by) {
+				order.clear();
+				for (size_t i = 0; i < by.size(); i++)
+					if (by[i])
+						order.push_back(i);
+				std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return by[a] > by[b]; });
+			};
+
+			busiest(prof.opcodes);
+			out += "opcode               count\n";
+			for (auto i : order) {
+				snprintf(line, sizeof(line), "%-10s %14llu\n", name((opcode)i), (unsigned long long)prof.opcodes[i]);
+				out += line;
+			}
+
+			std::vector<uint64_t> exclusive;
+			for (auto& t : prof.tables)
+				exclusive.push_back(t.calls ? t.exclusive + 1 : 0);
+			busiest(exclusive);
+			out += "table                          calls      inclusive      exclusive\n";
+			for (auto i : order) {
+				auto& t = prof.tables[i];
+				auto symbol = i < tables.size() && !tables[i].symbol.empty() ? tables[i].symbol.c_str() : "(root)";
+				snprintf(line, sizeof(line), "%-24s %12llu %14llu %14llu\n", symbol,
+					(unsigned long long)t.calls, (unsigned long long)t.inclusive, (unsigned long long)t.exclusive);
+				out += line;
+			}
+			return out;
+		}
+
+	}
+}
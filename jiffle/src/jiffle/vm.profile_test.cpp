@@ -0,0 +1,82 @@
+#include "vm.h"
+#include <assert.h>
+
+namespace jiffle {
+	namespace vm {
+
+		void profile_test() {
+			using namespace syntax;
+			using namespace expr;
+
+			// internal state -------------------------------------------------
+			std::vector<table> _tables;
+
+			// methods --------------------------------------------------------
+			auto compile = [&](const std::string& input) {
+				auto src = tokenize(input);
+				_tables = generate(parse(src, input));
+				link(_tables);
+			};
+			auto index = [&](const std::string& symbol) {
+				for (size_t i = 0; i < _tables.size(); i++)
+					if (_tables[i].symbol == symbol)
+						return i;
+				return npos;
+			};
+			auto total = [](const std::vector<uint64_t>& counts) {
+				uint64_t n = 0;
+				for (auto c : counts)
+					n += c;
+				return n;
+			};
+
+			// tests ----------------------------------------------------------
+
+			{ // counters, or nothing when compiled out
+				compile("f [x] = g x\ng [x] = x + 1\nf 1, f 2, f 3");
+				profile prof(1);
+				auto out = execute(_tables, prof);
+				assert(out.size() == 3 && out[0].integer == 2 && out[2].integer == 4);
+				if (!Profiling) {
+					assert(total(prof.opcodes) == 0 && prof.tables.empty() && collapsed(prof).empty());
+				}
+				else {
+					assert(prof.opcodes[CALL] == 2);
+					assert(prof.opcodes[TAILCALL] == 4);
+					auto f = index("f"), g = index("g");
+					assert(prof.tables[f].calls == 3 && prof.tables[g].calls == 3);
+					for (auto& t : prof.tables)
+						assert(t.inclusive >= t.exclusive);
+					assert(prof.tables[0].inclusive >= prof.tables[f].inclusive);
+
+					// every instruction sampled, one stack per line
+					uint64_t samples = 0;
+					for (auto& s : prof.stacks)
+						samples += s.second;
+					assert(samples == total(prof.opcodes));
+					assert(prof.stacks.count("(root);f") && prof.stacks.count("(root);g"));
+					auto text = collapsed(prof);
+					assert(text.find("(root);g ") != std::string::npos && text.back() == '\n');
+					auto report = summary(prof, _tables);
+					assert(report.find("TAILCALL") != std::string::npos && report.find("g ") != std::string::npos);
+				}
+			}
+			{ // a suspended process keeps its open tables
+				compile("f [x] = g x\ng [x] = x + 1\nf 1, f 2, f 3");
+				profile prof;
+				auto p = start(_tables);
+				p.profiler = &prof;
+				p.closed = true;
+				while (resume(p, 2) == Suspended);
+				assert(p.outputs[0].size() == 3);
+				assert(!Profiling || (prof.tables[index("g")].calls == 3 && prof.stacks.empty()));
+			}
+			{ // opcode names
+				assert(std::string(name(SET)) == "SET");
+				assert(std::string(name(APPLY)) == "APPLY");
+				assert(std::string(name(DMOD)) == "DMOD");
+			}
+		}
+
+	}
+}
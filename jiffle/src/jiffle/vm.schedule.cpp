@@ -0,0 +1,165 @@
+#include "vm.h"
+
+namespace jiffle {
+	namespace vm {
+
+		// Tasks are queued at most once: a task is either queued, running on
+		// one worker, parked waiting for input, or finished.
+		struct scheduler::task {
+			enum state { Queued, Running, Parked, Done };
+
+			handle id;
+			std::mutex mutex;			// guards inbox, closed and state
+			std::deque<value> inbox;	// sent while running, moved into input
+			bool closed;
+			state at;
+			process p;
+			sink out;
+		};
+
+		// hands final output to the sink: the root sequence, then the output
+		// of every frame appending straight into the previous one, in order
+		// (a call into a register, a nested sequence or a call applied to
+		// further arguments ends the chain)
+		static void drain(process& p, const scheduler::sink& out) {
+			auto deliver = [&](std::vector<value>& items) {
+				if (out)
+					for (auto& v : items)
+						out(v);
+				items.clear();
+			};
+			deliver(p.outputs[0]);
+			size_t expected = 1;
+			for (auto& f : p.frames) {
+				if (f.ret != Output || f.output != expected || !f.rest.empty())
+					break;
+				deliver(p.outputs[f.output]);
+				expected = f.output + 1;
+			}
+		}
+
+		scheduler::scheduler(size_t workers) : _next(0), _stop(false) {
+			if (workers == 0)
+				workers = std::thread::hardware_concurrency();
+			if (workers == 0)
+				workers = 1;
+			for (size_t i = 0; i < workers; i++)
+				_threads.emplace_back([this]() { work(); });
+		}
+
+		scheduler::~scheduler() {
+			wait();
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				_stop = true;
+			}
+			_ready.notify_all();
+			for (auto& t : _threads)
+				t.join();
+		}
+
+		scheduler::handle scheduler::spawn(const std::vector<table>& tables, size_t entry, const std::vector<value>& args, sink out, state* memory) {
+			auto t = std::make_shared<task>();
+			t->closed = false;
+			t->at = task::Queued;
+			t->p = start(tables, entry, args, memory);
+			t->out = out;
+			std::lock_guard<std::mutex> lock(_mutex);
+			auto h = t->id = _next++;
+			_tasks[h] = t;
+			_queue.push_back(t);
+			_ready.notify_one();
+			return h;
+		}
+
+		void scheduler::send(handle h, const value& v) {
+			std::shared_ptr<task> t;
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				auto it = _tasks.find(h);
+				if (it == _tasks.end())
+					return; // finished, nobody receives
+				t = it->second;
+			}
+			std::lock_guard<std::mutex> lock(t->mutex);
+			t->inbox.push_back(v);
+			wake(t);
+		}
+
+		void scheduler::close(handle h) {
+			std::shared_ptr<task> t;
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				auto it = _tasks.find(h);
+				if (it == _tasks.end())
+					return;
+				t = it->second;
+			}
+			std::lock_guard<std::mutex> lock(t->mutex);
+			t->closed = true;
+			wake(t);
+		}
+
+		void scheduler::wait() {
+			std::unique_lock<std::mutex> lock(_mutex);
+			_idle.wait(lock, [this]() { return _tasks.empty(); });
+		}
+
+		// requeues a parked task, called with the task mutex held
+		void scheduler::wake(const std::shared_ptr<task>& t) {
+			if (t->at != task::Parked)
+				return;
+			t->at = task::Queued;
+			std::lock_guard<std::mutex> lock(_mutex);
+			_queue.push_back(t);
+			_ready.notify_one();
+		}
+
+		void scheduler::work() {
+			for (;;) {
+				std::shared_ptr<task> t;
+				{
+					std::unique_lock<std::mutex> lock(_mutex);
+					_ready.wait(lock, [this]() { return _stop || !_queue.empty(); });
+					if (_queue.empty())
+						return;
+					t = std::move(_queue.front());
+					_queue.pop_front();
+				}
+
+				// pending input, then a slice of the process
+				{
+					std::lock_guard<std::mutex> lock(t->mutex);
+					t->at = task::Running;
+					for (auto& v : t->inbox)
+						t->p.input.push_back(std::move(v));
+					t->inbox.clear();
+					t->p.closed = t->closed;
+				}
+				auto s = resume(t->p, Slice);
+				if (s == Finished || !t->p.memory)
+					drain(t->p, t->out); // a transaction may still retry
+
+				std::unique_lock<std::mutex> lock(t->mutex);
+				auto requeue = s == Suspended
+					|| (s == Waiting && (!t->inbox.empty() || t->closed != t->p.closed));
+				if (s == Finished) {
+					t->at = task::Done;
+					lock.unlock();
+					std::lock_guard<std::mutex> global(_mutex);
+					_tasks.erase(t->id);
+					if (_tasks.empty())
+						_idle.notify_all();
+					continue;
+				}
+				t->at = requeue ? task::Queued : task::Parked;
+				if (requeue) {
+					std::lock_guard<std::mutex> global(_mutex);
+					_queue.push_back(t);
+					_ready.notify_one();
+				}
+			}
+		}
+
+	}
+}
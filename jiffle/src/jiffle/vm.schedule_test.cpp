@@ -0,0 +1,133 @@
+#include "vm.h"
+#include <assert.h>
+
+namespace jiffle {
+	namespace vm {
+
+		void schedule_test() {
+			// internal state -------------------------------------------------
+			std::vector<table> _tables;
+
+			// methods --------------------------------------------------------
+			auto op = [](opcode o, unsigned char reg, unsigned char a = 0, unsigned char b = 0, size_t index = 0) {
+				return instruction{ o, reg, a, b, { "", index, 0 } };
+			};
+			auto integer = [](data::integer_t i) {
+				value v = {};
+				v.type = data::Integer;
+				v.integer = i;
+				return v;
+			};
+			auto constant = [](table& t, data::integer_t i) {
+				return encode(t, data::Integer, &i, sizeof(i));
+			};
+			auto values = [](const std::vector<value>& items) {
+				std::vector<data::integer_t> out;
+				for (auto& v : items)
+					out.push_back(v.integer);
+				return out;
+			};
+			auto upto = [](data::integer_t n) {
+				std::vector<data::integer_t> out;
+				for (data::integer_t i = 0; i < n; i++)
+					out.push_back(i);
+				return out;
+			};
+
+			// count [n] { 0..n-1 }, as a loop
+			table count = { "count", {}, {}, {}, 1, 4, false, {}, {}, {} };
+			auto zero = constant(count, 0), one = constant(count, 1);
+			count.start = {
+				op(SET, 1, 0, 0, zero),
+				op(SET, 2, 0, 0, one),
+				op(SUB, 3, 1, 0),
+				op(IFGE, 0, 3),
+				op(RETURN, 0),
+				op(EMIT, 0, 1),
+				op(ADD, 1, 1, 2),
+				op(JUMP, 0, 0, 0, 2),
+			};
+			// echo { every input value, until input ends }
+			table echo = { "echo", {}, {
+				op(RECEIVE, 0),
+				op(IFZ, 0, 0),
+				op(RETURN, 0),
+				op(EMIT, 0, 0),
+				op(JUMP, 0, 0, 0, 0),
+			}, {}, 0, 1, false, {}, {}, {} };
+			_tables = { count, echo };
+
+			// tests ----------------------------------------------------------
+
+			{ // slices resume where they stopped
+				auto p = start(_tables, 0, { integer(5000) });
+				size_t slices = 0;
+				while (resume(p, 100) == Suspended)
+					slices++;
+				assert(slices > 100);
+				assert(values(p.outputs[0]) == upto(5000));
+				assert(values(execute(_tables, 0, { integer(5000) })) == upto(5000));
+			}
+			{ // waiting for input
+				auto p = start(_tables, 1);
+				assert(resume(p, 1000) == Waiting);
+				p.input.push_back(integer(7));
+				p.input.push_back(integer(8));
+				assert(resume(p, 1000) == Waiting);
+				p.closed = true;
+				assert(resume(p, 1000) == Finished);
+				assert(values(p.outputs[0]) == std::vector<data::integer_t>({ 7, 8 }));
+
+				// closed input at start, as execute runs
+				assert(execute(_tables, 1).empty());
+			}
+			{ // thousands of processes on a few threads
+				const size_t N = 2000;
+				std::vector<std::vector<data::integer_t>> produced(N), echoed(N);
+				{
+					scheduler s(4);
+					assert(s.workers() == 4);
+					std::vector<scheduler::handle> consumers;
+					for (size_t i = 0; i < N; i++) {
+						// sinks of one process are never called concurrently
+						s.spawn(_tables, 0, { integer(300) }, [&produced, i](const value& v) { produced[i].push_back(v.integer); });
+						consumers.push_back(s.spawn(_tables, 1, {}, [&echoed, i](const value& v) { echoed[i].push_back(v.integer); }));
+					}
+					for (size_t i = 0; i < N; i++)
+						for (data::integer_t k = 1; k <= 3; k++)
+							s.send(consumers[i], integer(k)); // 0 would end echo
+					for (auto h : consumers)
+						s.close(h);
+					s.wait();
+				}
+				for (size_t i = 0; i < N; i++) {
+					assert(produced[i] == upto(300));
+					assert(echoed[i] == std::vector<data::integer_t>({ 1, 2, 3 }));
+				}
+			}
+			{ // slices ending inside a call applied to more arguments than it takes
+				const size_t N = 1100;
+				std::vector<std::vector<table>> programs(N);
+				std::vector<std::vector<data::integer_t>> out(N);
+				{
+					scheduler s(4);
+					std::string code = "add [a][b] = a + b\nk [a] = add a\napp [f] = f 1 2\n";
+					for (size_t i = 0; i < N; i++) {
+						auto last = code + "app k\n";
+						programs[i] = generate(std::vector<expr::node>{ expr::parse(syntax::tokenize(last), last) });
+						link(programs[i]);
+						s.spawn(programs[i], 0, {}, [&out, i](const value& v) { out[i].push_back(v.type == data::Integer ? v.integer : -1); });
+						code += std::to_string(i) + "\n";
+					}
+					s.wait();
+				}
+				for (size_t i = 0; i < N; i++) {
+					auto expected = upto(i);
+					expected.push_back(3);
+					assert(out[i] == expected);
+				}
+			}
+		}
+
+	}
+}
@@ -0,0 +1,65 @@
+#include "vm.h"
+
+#include <atomic>
+#include <mutex>
+
+namespace jiffle {
+	namespace vm {
+
+		// transitions are weak, unused shapes are released with their objects
+		static std::mutex _mutex;
+		static std::map<std::pair<size_t, std::string>, std::weak_ptr<const shape>> _transitions;
+		static size_t _sweep = 64;
+		static std::atomic<size_t> _ids(0);
+
+		shape_ptr empty() {
+			static const shape_ptr root = std::make_shared<const shape>(shape{ _ids++, {}, {}, nullptr });
+			return root;
+		}
+
+		shape_ptr extend(const shape_ptr& s, const std::string& member) {
+			if (s->slots.find(member))
+				return s;
+			std::lock_guard<std::mutex> lock(_mutex);
+			auto& link = _transitions[{ s->id, member }];
+			if (auto existing = link.lock())
+				return existing;
+			if (_transitions.size() > _sweep) {
+				for (auto it = _transitions.begin(); it != _transitions.end();)
+					it = it->second.expired() && &it->second != &link ? _transitions.erase(it) : std::next(it);
+				_sweep = _transitions.size() * 2 > 64 ? _transitions.size() * 2 : 64;
+			}
+			auto child = std::make_shared<shape>(*s);
+			child->id = _ids++;
+			child->parent = s;
+			child->slots = s->slots.set(member, s->members.size());
+			child->members = s->members.push_back(member);
+			link = child;
+			return child;
+		}
+
+		size_t member(cache& c, const shape& s, const std::string& name) {
+			return member(c, s, name, {}, npos);
+		}
+
+		size_t member(cache& c, const shape& s, const std::string& name, const std::vector<size_t>& row, size_t id) {
+			// hit: a shape check
+			for (size_t i = 0; i < c.count; i++)
+				if (c.entries[i].shape == s.id)
+					return c.entries[i].slot;
+
+			// miss: the set's dispatch row, or a probe of the shape
+			// (members added past the set), remembered while not megamorphic
+			c.misses++;
+			auto slot = id < row.size() ? row[id] : npos;
+			if (slot == npos) {
+				auto it = s.slots.find(name);
+				slot = it ? *it : npos;
+			}
+			if (c.count < cache::Entries)
+				c.entries[c.count++] = { s.id, slot };
+			return slot;
+		}
+
+	}
+}
@@ -0,0 +1,82 @@
+#include "vm.h"
+#include <assert.h>
+
+namespace jiffle {
+	namespace vm {
+
+		void shape_test() {
+			// internal state -------------------------------------------------
+			cache _site;
+
+			// methods --------------------------------------------------------
+			auto reset = [&]() {
+				_site = cache();
+			};
+
+			// tests ----------------------------------------------------------
+
+			{ // transitions are shared
+				auto a = extend(extend(empty(), "x"), "y");
+				auto b = extend(extend(empty(), "x"), "y");
+				assert(a == b);
+				assert(a->members.size() == 2 && *a->slots.find("y") == 1);
+				assert(extend(a, "x") == a);
+
+				// order matters
+				auto c = extend(extend(empty(), "y"), "x");
+				assert(c != a && *c->slots.find("x") == 1);
+
+				// a child leaves its parent's members as they were
+				auto d = extend(a, "z");
+				assert(d->members.size() == 3 && d->members[2] == "z" && *d->slots.find("z") == 2);
+				assert(a->members.size() == 2 && !a->slots.find("z"));
+			}
+			{ // monomorphic site
+				reset();
+				auto s = extend(extend(empty(), "x"), "y");
+				assert(member(_site, *s, "y") == 1);
+				assert(member(_site, *s, "y") == 1);
+				assert(_site.count == 1 && _site.misses == 1);
+				assert(member(_site, *empty(), "y") == npos);
+				assert(_site.count == 2 && _site.misses == 2);
+			}
+			{ // extension invalidates by shape
+				reset();
+				auto s = extend(empty(), "x");
+				assert(member(_site, *s, "y") == npos);
+				auto extended = extend(s, "y");
+				assert(member(_site, *extended, "y") == 1);
+				assert(_site.misses == 2);
+			}
+			{ // polymorphic, then megamorphic
+				reset();
+				std::vector<shape_ptr> shapes;
+				for (size_t i = 0; i < cache::Entries + 2; i++) {
+					auto s = empty();
+					for (size_t j = 0; j < i; j++)
+						s = extend(s, "pad" + std::to_string(j));
+					shapes.push_back(extend(s, "v"));
+				}
+				for (size_t round = 0; round < 2; round++)
+					for (size_t i = 0; i < shapes.size(); i++)
+						assert(member(_site, *shapes[i], "v") == i);
+				assert(_site.count == cache::Entries);
+				assert(_site.misses == cache::Entries + 2 * 2);
+			}
+			{ // a miss takes the slot from a dispatch row
+				reset();
+				auto s = extend(extend(empty(), "x"), "y");
+				std::vector<size_t> row = { npos, 1, 0 };
+				assert(member(_site, *s, "y", row, 2) == 0); // the row, not the shape
+				assert(member(_site, *s, "y", row, 2) == 0 && _site.misses == 1);
+
+				// members past the set are probed
+				reset();
+				assert(member(_site, *s, "y", row, 0) == 1);
+				reset();
+				assert(member(_site, *s, "y", row, 7) == 1);
+			}
+		}
+
+	}
+}
@@ -0,0 +1,130 @@
+#include "vm.h"
+
+#include <algorithm>
+
+namespace jiffle {
+	namespace vm {
+
+		typedef std::pair<size_t, size_t> key;
+
+		state::cell& state::at(const std::vector<table>& tables, size_t table, size_t offset) {
+			std::lock_guard<std::mutex> lock(_mutex);
+			auto& c = _cells[{ table, offset }];
+			if (!c) {
+				c.reset(new cell());
+				c->version.store(0);
+				c->current = std::make_shared<const value>(decode(tables[table], offset));
+			}
+			return *c;
+		}
+
+		std::vector<state::change> state::journal() const {
+			std::lock_guard<std::mutex> lock(_mutex);
+			return _journal;
+		}
+
+		transaction begin(state& s, const std::vector<table>& tables) {
+			return transaction{ &s, &tables, s.clock(), {}, {} };
+		}
+
+		bool read(transaction& t, size_t table, size_t offset, value& out) {
+			key k = { table, offset };
+			auto w = t.writes.find(k);
+			if (w != t.writes.end()) {
+				out = w->second;
+				return true;
+			}
+			// optimistic: the version must not move while the value is read
+			auto& c = t.memory->at(*t.tables, table, offset);
+			auto before = c.version.load();
+			auto current = std::atomic_load(&c.current);
+			auto after = c.version.load();
+			if (before != after || (before & 1) || before / 2 > t.start)
+				return false;
+			t.reads[k] = before;
+			out = *current;
+			return true;
+		}
+
+		void write(transaction& t, size_t table, size_t offset, const value& v) {
+			t.writes[{ table, offset }] = v;
+		}
+
+		bool commit(transaction& t) {
+			// read only, every read was consistent with the start version
+			if (t.writes.empty())
+				return true;
+			auto& s = *t.memory;
+
+			// lock written cells in address order, compare and swap on version
+			// (blind writes may follow newer commits, read ones may not)
+			std::vector<std::pair<state::cell*, uint64_t>> locked;
+			auto unlock = [&]() {
+				for (auto& l : locked)
+					l.first->version.store(l.second, std::memory_order_release);
+			};
+			for (auto& w : t.writes) {
+				auto& c = s.at(*t.tables, w.first.first, w.first.second);
+				auto v = c.version.load(std::memory_order_acquire);
+				auto r = t.reads.find(w.first);
+				if ((v & 1) || (r != t.reads.end() && r->second != v) || !c.version.compare_exchange_strong(v, v + 1)) {
+					unlock();
+					return false;
+				}
+				locked.push_back({ &c, v });
+			}
+			auto version = s._clock.fetch_add(1) + 1;
+
+			// every other read still current
+			if (version != t.start + 1) {
+				for (auto& r : t.reads) {
+					if (t.writes.count(r.first))
+						continue;
+					auto& c = s.at(*t.tables, r.first.first, r.first.second);
+					if (c.version.load() != r.second) {
+						unlock();
+						return false;
+					}
+				}
+			}
+
+			// publish and journal, then release with the new version
+			std::vector<state::change> changes;
+			size_t i = 0;
+			for (auto& w : t.writes) {
+				auto& c = *locked[i++].first;
+				auto old = std::atomic_load(&c.current);
+				changes.push_back({ w.first.first, w.first.second, *old, w.second, version });
+				std::atomic_store(&c.current, std::make_shared<const value>(w.second));
+			}
+			{
+				std::lock_guard<std::mutex> lock(s._mutex);
+				auto at = std::upper_bound(s._journal.begin(), s._journal.end(), version,
+					[](uint64_t v, const state::change& c) { return v < c.version; });
+				s._journal.insert(at, changes.begin(), changes.end());
+			}
+			for (auto& l : locked)
+				l.first->version.store(version * 2, std::memory_order_release);
+			return true;
+		}
+
+		void rollback(state& s, const std::vector<table>& tables, uint64_t version) {
+			for (;;) {
+				auto t = begin(s, tables);
+				auto changes = s.journal();
+				// touched cells are read first, so a concurrent commit retries
+				auto valid = true;
+				for (auto& c : changes) {
+					value v;
+					if (c.version > version && !read(t, c.table, c.offset, v))
+						valid = false;
+				}
+				for (auto it = changes.rbegin(); it != changes.rend() && it->version > version; ++it)
+					write(t, it->table, it->offset, it->before);
+				if (valid && commit(t))
+					return;
+			}
+		}
+
+	}
+}
@@ -0,0 +1,178 @@
+#include "vm.h"
+#include <assert.h>
+#include <set>
+
+namespace jiffle {
+	namespace vm {
+
+		void state_test() {
+			// internal state -------------------------------------------------
+			std::vector<table> _tables;
+
+			// methods --------------------------------------------------------
+			auto op = [](opcode o, unsigned char reg, unsigned char a = 0, unsigned char b = 0, size_t index = 0, size_t owner = 0) {
+				return instruction{ o, reg, a, b, { "", index, owner } };
+			};
+			auto integer = [](data::integer_t i) {
+				value v = {};
+				v.type = data::Integer;
+				v.integer = i;
+				return v;
+			};
+			auto constant = [](table& t, data::integer_t i) {
+				return encode(t, data::Integer, &i, sizeof(i));
+			};
+			auto get = [&](state& s, size_t offset) {
+				auto t = begin(s, _tables);
+				value v;
+				assert(read(t, 0, offset, v));
+				return v.integer;
+			};
+
+			// data { counter = 0, other = 0 }
+			table data = { "data", {}, {}, {}, 0, 0, false, {}, {}, {} };
+			auto counter = constant(data, 0), other = constant(data, 0);
+			// inc { counter = counter + 1, emits new counter }
+			table inc = { "inc", {}, {}, {}, 0, 3, false, {}, {}, {} };
+			auto one = constant(inc, 1);
+			inc.start = {
+				op(LOAD, 0, 0, 0, counter, 0),
+				op(SET, 1, 0, 0, one),
+				op(ADD, 2, 0, 1),
+				op(STORE, 0, 2, 0, counter, 0),
+				op(EMIT, 0, 2),
+			};
+			// swap { counter 0 -> 1 }
+			table swap = { "swap", {}, {}, {}, 0, 3, false, {}, {}, {} };
+			auto zero = constant(swap, 0), first = constant(swap, 1);
+			swap.start = {
+				op(SET, 0, 0, 0, zero),
+				op(SET, 1, 0, 0, first),
+				op(CAS, 2, 0, 1, counter, 0),
+				op(EMIT, 0, 2),
+			};
+			// take { counter = counter + input, emits input }
+			table take = { "take", {}, {}, {}, 0, 3, false, {}, {}, {} };
+			take.start = {
+				op(RECEIVE, 0),
+				op(LOAD, 1, 0, 0, counter, 0),
+				op(ADD, 2, 1, 0),
+				op(STORE, 0, 2, 0, counter, 0),
+				op(EMIT, 0, 0),
+			};
+			_tables = { data, inc, swap, take };
+
+			// tests ----------------------------------------------------------
+
+			{ // commits are seen by later transactions, and journaled
+				state s;
+				auto t = begin(s, _tables);
+				value v;
+				assert(read(t, 0, counter, v) && v.integer == 0);
+				write(t, 0, counter, integer(5));
+				assert(read(t, 0, counter, v) && v.integer == 5); // own write
+				assert(get(s, counter) == 0);
+				assert(commit(t) && s.clock() == 1);
+				assert(get(s, counter) == 5);
+
+				auto journal = s.journal();
+				assert(journal.size() == 1 && journal[0].before.integer == 0 && journal[0].after.integer == 5);
+			}
+			{ // conflicts
+				state s;
+				auto t1 = begin(s, _tables), t2 = begin(s, _tables), t3 = begin(s, _tables);
+				value v;
+				assert(read(t1, 0, counter, v));
+				write(t2, 0, counter, integer(7));
+				assert(commit(t2));
+
+				// read value changed before commit
+				write(t1, 0, other, integer(1));
+				assert(!commit(t1));
+				assert(get(s, other) == 0);
+
+				// newer than the transaction start
+				assert(!read(t3, 0, counter, v));
+
+				// blind writes don't conflict
+				auto t4 = begin(s, _tables), t5 = begin(s, _tables);
+				write(t4, 0, other, integer(1));
+				write(t5, 0, other, integer(2));
+				assert(commit(t5) && commit(t4));
+				assert(get(s, other) == 1);
+			}
+			{ // concurrent increments, retried until committed
+				state s;
+				std::vector<std::thread> threads;
+				for (int i = 0; i < 4; i++) {
+					threads.emplace_back([&]() {
+						for (int n = 0; n < 1000; n++) {
+							for (;;) {
+								auto t = begin(s, _tables);
+								value v;
+								if (!read(t, 0, counter, v))
+									continue;
+								write(t, 0, counter, integer(v.integer + 1));
+								if (commit(t))
+									break;
+							}
+						}
+					});
+				}
+				for (auto& t : threads)
+					t.join();
+				assert(get(s, counter) == 4000);
+				assert(s.journal().size() == 4000);
+			}
+			{ // processes are transactions, serializable
+				state s;
+				const size_t N = 500;
+				std::mutex mutex;
+				std::set<data::integer_t> seen;
+				{
+					scheduler sched(4);
+					for (size_t i = 0; i < N; i++)
+						sched.spawn(_tables, 1, {}, [&](const value& v) {
+							std::lock_guard<std::mutex> lock(mutex);
+							seen.insert(v.integer);
+						}, &s);
+				}
+				assert(get(s, counter) == (data::integer_t)N);
+				assert(seen.size() == N && *seen.begin() == 1 && *seen.rbegin() == (data::integer_t)N);
+
+				// undo back to 100
+				auto journal = s.journal();
+				rollback(s, _tables, journal[99].version);
+				assert(get(s, counter) == 100);
+			}
+			{ // input taken before a conflict is taken again by the retry
+				state s;
+				auto p = start(_tables, 3, {}, &s);
+				p.input.push_back(integer(10));
+				p.input.push_back(integer(20));
+				assert(resume(p, 2) == Suspended);
+				auto t = begin(s, _tables);
+				write(t, 0, counter, integer(7));
+				assert(commit(t));
+				assert(resume(p, 100) == Finished);
+				assert(p.outputs[0].size() == 1 && p.outputs[0][0].integer == 10);
+				assert(get(s, counter) == 17);
+				assert(p.input.size() == 1 && p.input.front().integer == 20);
+			}
+			{ // compare and swap
+				state s;
+				auto out = execute(_tables, s, 2);
+				assert(out.size() == 1 && out[0].type == data::Bool && out[0].boolean);
+				assert(get(s, counter) == 1);
+				out = execute(_tables, s, 2);
+				assert(!out[0].boolean);
+				assert(get(s, counter) == 1);
+
+				// without shared state memory is the constant
+				out = execute(_tables, 1);
+				assert(out.size() == 1 && out[0].integer == 1);
+			}
+		}
+
+	}
+}
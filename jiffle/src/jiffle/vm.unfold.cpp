@@ -0,0 +1,558 @@
+#include "vm.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <set>
+
+namespace jiffle {
+	namespace vm {
+
+		// busy definitions, those a profile shows entered for at least this
+		// share of all calls, inline with bodies this many times larger
+		static const uint64_t BusyShare = 64;
+		static const size_t BusyBody = 4;
+
+		// rewrites the modules with a target, read only ones are seen for
+		// their declarations. Their definitions stay calls, a module isn't
+		// generated again when the bodies of the others change.
+		static size_t unfoldModules(const std::vector<const expr::node*>& modules, const std::vector<expr::node*>& targets,
+			const budget& limits, const feedback* guide) {
+			using namespace expr;
+			trace::scope span("unfold", "compile");
+
+			// internal state -------------------------------------------------
+			struct parameter {
+				std::vector<std::string> names;	// '[x]', or the elements of '[a,b]'
+				data::type type;				// specified type of a single value
+				bool sequence;
+			};
+			struct callee {
+				std::vector<parameter> parameters;
+				const std::list<node>* body;
+				std::map<std::string, size_t> uses;		// parameter to occurrences
+				std::set<std::string> operands;			// parameters inside arithmetic operands
+				std::set<std::string> free;				// other names, top-level definitions
+			};
+			struct scope {
+				std::set<std::string> parameters;
+				std::set<std::string> names;				// declared inside
+				std::map<std::string, data::type> types;	// specified parameter types
+				bool extension;								// 'set.member' sees the set's members too
+			};
+			std::map<std::string, size_t> _declared;		// top-level name to declarations
+			std::map<std::string, const node*> _definitions;	// top-level name declared once
+			std::set<std::string> _extended;				// sets extended by 'set.member'
+			std::set<std::string> _members;					// members added by 'set.member'
+			std::set<std::string> _local;					// names declared below the top level
+			std::set<std::string> _recursive;				// top-level definitions on a cycle of calls
+			std::vector<scope> _scopes;						// definitions around a call, innermost last
+			std::vector<std::string> _unfolding;			// callees inlined around a call
+			std::set<std::string> _busy;					// top-level definitions a profile shows busy
+			std::set<std::string> _foreign;					// top-level names read only modules declare
+			size_t _room = 0;								// nodes the program may still grow by
+			size_t _count = 0;
+
+			// methods --------------------------------------------------------
+
+			// stateless
+			std::function<size_t(const node&)> sizeOf = [&](const node& n) {
+				size_t size = 1;
+				for (auto& i : n.items)
+					size += sizeOf(i);
+				return size;
+			};
+			auto isValue = [](const node& n) {
+				return !(n.type & STRUCTURE_BIT);
+			};
+			auto isDefinition = [](const node& n) {
+				if (n.type != expr::Object)
+					return false;
+				for (auto& i : n.items)
+					if (i.type == expr::Definition || i.type == expr::DefinitionSequence)
+						return true;
+				return false;
+			};
+			auto isDeclaration = [&](const node& eval) {
+				return eval.items.size() == 1
+					&& isDefinition(eval.items.front())
+					&& !eval.items.front().text.empty();
+			};
+			auto isArithmetic = [](const node& eval) {
+				if (eval.type != expr::Evaluation || eval.items.size() != 3)
+					return false;
+				auto& op = *std::next(eval.items.begin());
+				return op.type == expr::Object && op.items.empty() && op.text.size() == 1
+					&& std::string("+-*/%").find(op.text[0]) != std::string::npos;
+			};
+			auto nameOf = [](const node& obj) {
+				return !obj.text.empty() && obj.text[0] == '.' ? obj.text.substr(1) : obj.text;
+			};
+			// '[x]', '[x:Integer]' or '[a,b]', false for any other pattern
+			auto parameterOf = [](const node& p, parameter& out) {
+				out = parameter{ {}, data::Void, p.items.size() > 1 || (p.flags & flags::ExplicitStructure) != 0 };
+				for (auto& eval : p.items) {
+					if (eval.items.size() != 1 || eval.items.front().type != expr::Object || !eval.items.front().items.empty())
+						return false;
+					auto& text = eval.items.front().text;
+					if (text.empty() || text.find_first_of(".|") != std::string::npos)
+						return false;
+					auto colon = text.find(':');
+					if (colon != std::string::npos) {
+						auto spec = text.substr(colon + 1);
+						out.type = spec == "Integer" ? data::Integer : spec == "Real" ? data::Real
+							: spec == "String" ? data::String : spec == "Bool" ? data::Bool : data::Void;
+						if (out.type == data::Void || out.sequence)
+							return false;
+					}
+					out.names.push_back(text.substr(0, colon));
+				}
+				return !out.names.empty();
+			};
+			// names a parameter binds, of any pattern ('[a..,b:Integer|Real]')
+			auto bindings = [](const node& p) {
+				std::vector<std::string> names;
+				for (auto& eval : p.items)
+					for (auto& item : eval.items)
+						if (item.type == expr::Object)
+							names.push_back(item.text.substr(0, item.text.find_first_of(":.")));
+				return names;
+			};
+
+			// statefull
+
+			// every declaration of the program, top-level ones by name
+			std::function<void(const node&, bool)> gather = [&](const node& n, bool top) {
+				for (auto& eval : n.items) {
+					auto declaration = isDeclaration(eval);
+					for (auto& item : eval.items) {
+						if (declaration) {
+							auto name = nameOf(item);
+							auto dot = name.find('.');
+							if (dot != std::string::npos) {
+								// 'set.member' adds a member to a set
+								_extended.insert(name.substr(0, dot));
+								_members.insert(name.substr(name.rfind('.') + 1));
+							}
+							else if (top) {
+								_declared[name]++;
+								_definitions[name] = item.text[0] == '.' ? nullptr : &item;
+							}
+							else
+								_local.insert(name);
+						}
+						for (auto& part : item.items)
+							if (part.type == expr::Definition || part.type == expr::DefinitionSequence)
+								gather(part, false);
+						if (item.type == expr::Sequence)
+							gather(item, false);
+					}
+				}
+			};
+
+			// definitions mentioning each other in a cycle, by strongly
+			// connected components of the top-level names they mention
+			auto cycles = [&]() {
+				std::map<std::string, std::set<std::string>> graph;
+				std::function<void(const node&, std::set<std::string>&)> mentions = [&](const node& n, std::set<std::string>& out) {
+					if (n.type == expr::Object && !n.text.empty()) {
+						auto name = nameOf(n);
+						name = name.substr(0, name.find('.'));
+						if (_declared.count(name))
+							out.insert(name);
+					}
+					for (auto& i : n.items)
+						mentions(i, out);
+				};
+				for (auto& d : _definitions)
+					if (d.second)
+						for (auto& i : d.second->items)
+							mentions(i, graph[d.first]);
+
+				std::map<std::string, std::pair<size_t, size_t>> order;	// name to index and lowest reachable
+				std::vector<std::string> stack;
+				std::set<std::string> open;
+				std::function<void(const std::string&)> connect = [&](const std::string& v) {
+					auto index = order.size();
+					order[v] = { index, index };
+					stack.push_back(v);
+					open.insert(v);
+					for (auto& w : graph[v]) {
+						if (!order.count(w)) {
+							connect(w);
+							order[v].second = std::min(order[v].second, order[w].second);
+						}
+						else if (open.count(w))
+							order[v].second = std::min(order[v].second, order[w].first);
+					}
+					if (order[v].second != index)
+						return;
+					auto single = stack.back() == v;
+					for (std::string w; w != v; stack.pop_back()) {
+						w = stack.back();
+						open.erase(w);
+						if (!single || graph[v].count(v))
+							_recursive.insert(w);
+					}
+				};
+				for (auto& d : _definitions)
+					if (!order.count(d.first))
+						connect(d.first);
+			};
+
+			// name resolving to the same definition at the call as in a
+			// top-level body, where only the top level is in scope
+			auto visible = [&](const std::string& name) {
+				for (auto& s : _scopes)
+					if (s.parameters.count(name) || s.names.count(name) || (s.extension && _local.count(name)))
+						return false;
+				return _scopes.empty() || !_members.count(name);
+			};
+
+			// a definition inlined as it currently is, false when its body
+			// does more than evaluate its parameters and top-level names
+			auto analyze = [&](const std::string& name, callee& out) {
+				auto found = _definitions.find(name);
+				if (found == _definitions.end() || !found->second || _declared[name] != 1
+					|| _extended.count(name) || _recursive.count(name) || _foreign.count(name))
+					return false;
+				out = callee{};
+				for (auto& p : found->second->items) {
+					if (p.type == expr::Parameter) {
+						parameter par;
+						if (!parameterOf(p, par))
+							return false;
+						out.parameters.push_back(par);
+						for (auto& n : par.names)
+							if (!out.uses.emplace(n, 0).second)
+								return false;
+					}
+					else if ((p.type == expr::Definition || p.type == expr::DefinitionSequence) && !out.body)
+						out.body = &p.items;
+					else
+						return false;
+				}
+				if (!out.body)
+					return false;
+				size_t size = 0;
+				for (auto& eval : *out.body)
+					size += sizeOf(eval);
+				if (size > (_busy.count(name) ? limits.body * BusyBody : limits.body))
+					return false;
+
+				std::function<bool(const node&, bool, bool)> check = [&](const node& n, bool head, bool operand) {
+					switch (n.type) {
+					case expr::Evaluation: {
+						if (isDeclaration(n))
+							return false;
+						if (isArithmetic(n))
+							return check(n.items.front(), false, true) && check(n.items.back(), false, true);
+						auto first = true;
+						for (auto& item : n.items) {
+							if (!check(item, first && n.items.size() > 1, operand))
+								return false;
+							first = false;
+						}
+						return true;
+					}
+					case expr::Sequence:
+						for (auto& eval : n.items)
+							if (!check(eval, false, operand))
+								return false;
+						return true;
+					case expr::Object: {
+						if (!n.items.empty())
+							return false;
+						auto use = out.uses.find(n.text);
+						if (use != out.uses.end()) {
+							// applying a closure argument stays a call
+							if (head)
+								return false;
+							use->second++;
+							if (operand)
+								out.operands.insert(n.text);
+							return true;
+						}
+						if (n.text == name || n.text.find('.') != std::string::npos || !_declared.count(n.text))
+							return false;
+						out.free.insert(n.text);
+						return true;
+					}
+					default:
+						return isValue(n);
+					}
+				};
+				for (auto& eval : *out.body)
+					if (!check(eval, false, false))
+						return false;
+				return true;
+			};
+
+			// argument as the node substituted for its parameter, atoms are
+			// cheap to evaluate more than once
+			auto argument = [&](const node& arg, node& value, bool& atom) {
+				if (isValue(arg)) {
+					value = arg;
+					atom = true;
+					return true;
+				}
+				if (arg.type == expr::Object && arg.items.empty()) {
+					atom = !_scopes.empty() && _scopes.back().parameters.count(arg.text);
+					// other names are calls, '(name)' is a call's single value
+					value = atom ? arg : node{ expr::Sequence, flags::Default, arg.pos, "",
+						{ node{ expr::Evaluation, flags::Default, arg.pos, "", { arg } } } };
+					return true;
+				}
+				if (arg.type == expr::Sequence) {
+					value = arg;
+					atom = false;
+					return true;
+				}
+				return false;
+			};
+			auto types = [&]() {
+				static const std::map<std::string, data::type> none;
+				return _scopes.empty() ? none : _scopes.back().types;
+			};
+			// arguments bound to the parameters, false when inlining could
+			// change which operation a body's arithmetic is generated as
+			auto bind = [&](const callee& f, const node& eval, std::map<std::string, node>& bound) {
+				auto arg = std::next(eval.items.begin());
+				auto bindOne = [&](const std::string& name, data::type type, const node& a) {
+					node value;
+					bool atom;
+					if (!argument(a, value, atom))
+						return false;
+					auto t = infer(value, types());
+					if (type != data::Void ? t != type : t == data::String && f.operands.count(name))
+						return false;
+					if (f.uses.at(name) > 1 && !atom)
+						return false;
+					bound[name] = value;
+					return true;
+				};
+				for (auto& p : f.parameters) {
+					auto& a = *arg++;
+					if (!p.sequence) {
+						if (!bindOne(p.names.front(), p.type, a))
+							return false;
+						continue;
+					}
+					// '[a,b]' of a literal sequence of as many single values
+					if (a.type != expr::Sequence || a.items.size() != p.names.size()
+						|| (a.items.size() == 1 && !(a.flags & flags::ExplicitStructure)))
+						return false;
+					auto name = p.names.begin();
+					for (auto& item : a.items) {
+						// a call may output any number of items
+						if (item.items.size() != 1 || (item.items.front().type == expr::Object
+							&& !(item.items.front().items.empty() && _scopes.size() && _scopes.back().parameters.count(item.items.front().text))))
+							return false;
+						if (!bindOne(*name++, data::Void, item.items.front()))
+							return false;
+					}
+				}
+				return true;
+			};
+			std::function<node(const node&, const std::map<std::string, node>&)> substitute =
+				[&](const node& n, const std::map<std::string, node>& bound) {
+				if (n.type == expr::Object && n.items.empty()) {
+					auto it = bound.find(n.text);
+					if (it != bound.end())
+						return it->second;
+				}
+				node out = { n.type, n.flags, n.pos, n.text, {} };
+				for (auto& i : n.items)
+					out.items.push_back(substitute(i, bound));
+				return out;
+			};
+			// body of a callee in place of a call, within the growth budget
+			auto inlined = [&](const std::string& name, const node& eval, bool value, std::list<node>& out) {
+				callee f;
+				if (!visible(name) || std::find(_unfolding.begin(), _unfolding.end(), name) != _unfolding.end()
+					|| _unfolding.size() >= limits.depth || !analyze(name, f)
+					|| f.parameters.size() != eval.items.size() - (value ? 0 : 1))
+					return false;
+				for (auto& n : f.free)
+					if (!visible(n))
+						return false;
+				std::map<std::string, node> bound;
+				if (!bind(f, eval, bound))
+					return false;
+				size_t size = 0;
+				for (auto& s : *f.body) {
+					out.push_back(substitute(s, bound));
+					size += sizeOf(out.back());
+				}
+				auto call = sizeOf(eval);
+				if (size > call && size - call > _room) {
+					out.clear();
+					return false;
+				}
+				_room -= size > call ? size - call : 0;
+				_count++;
+				return true;
+			};
+
+			std::function<void(std::list<node>&)> statements;
+			std::function<void(node&, bool, bool)> item;
+
+			// body of a definition, its parameters in scope
+			auto definition = [&](node& obj) {
+				scope s = { {}, {}, {}, nameOf(obj).find('.') != std::string::npos };
+				for (auto& d : obj.items)
+					if (d.type == expr::Definition || d.type == expr::DefinitionSequence)
+						for (auto& eval : d.items)
+							if (isDeclaration(eval))
+								s.names.insert(nameOf(eval.items.front()));
+				for (auto& p : obj.items) {
+					if (p.type != expr::Parameter)
+						continue;
+					for (auto& n : bindings(p))
+						s.parameters.insert(n);
+					parameter par;
+					if (parameterOf(p, par) && par.type != data::Void)
+						s.types[par.names.front()] = par.type;
+				}
+				_scopes.push_back(s);
+				for (auto& d : obj.items)
+					if (d.type == expr::Definition || d.type == expr::DefinitionSequence)
+						statements(d.items);
+				_scopes.pop_back();
+			};
+
+			// evaluations in order, calls replaced by the statements of their
+			// callee once their arguments are unfolded
+			statements = [&](std::list<node>& items) {
+				for (auto it = items.begin(); it != items.end();) {
+					auto& eval = *it;
+					if (isDeclaration(eval)) {
+						definition(eval.items.front());
+						++it;
+						continue;
+					}
+					if (isArithmetic(eval)) {
+						item(eval.items.front(), true, true);
+						item(eval.items.back(), true, true);
+						++it;
+						continue;
+					}
+					auto value = false;
+					for (auto& i : eval.items) {
+						item(i, value, false);
+						value = true;
+					}
+					std::list<node> body;
+					if (eval.items.empty() || eval.items.front().type != expr::Object || !eval.items.front().items.empty()
+						|| !inlined(eval.items.front().text, eval, false, body)) {
+						++it;
+						continue;
+					}
+					// calls of the callee's body are inlined within it
+					auto name = eval.items.front().text;
+					_unfolding.push_back(name);
+					statements(body);
+					_unfolding.pop_back();
+					it = items.erase(it);
+					items.splice(it, body);
+				}
+			};
+
+			// item of an evaluation, a value unless it is the head of a call
+			item = [&](node& n, bool value, bool operand) {
+				if (n.type == expr::Sequence) {
+					statements(n.items);
+					// '(2)' left by an inlined call is the value itself
+					if (!(n.flags & flags::ExplicitStructure) && n.items.size() == 1
+						&& n.items.front().items.size() == 1 && isValue(n.items.front().items.front()))
+						n = node(n.items.front().items.front());
+					return;
+				}
+				if (n.type != expr::Object)
+					return;
+				if (!n.items.empty()) {
+					definition(n);
+					return;
+				}
+				auto count = _count;
+				auto room = _room;
+				std::list<node> body;
+				if (!value || !inlined(n.text, node{ expr::Evaluation, flags::Default, n.pos, "", {} }, true, body))
+					return;
+				_unfolding.push_back(n.text);
+				statements(body);
+				_unfolding.pop_back();
+
+				// a single value stays itself, more are packed as the call's output
+				node packed = { expr::Sequence, flags::Default, n.pos, "", std::move(body) };
+				if (packed.items.size() == 1 && packed.items.front().items.size() == 1
+					&& isValue(packed.items.front().items.front()))
+					packed = node(packed.items.front().items.front());
+
+				// a string operand would make '+' a join, where the call is added dynamically
+				if (operand && infer(packed, types()) == data::String) {
+					_count = count;
+					_room = room;
+					return;
+				}
+				n = std::move(packed);
+			};
+
+			// entry ----------------------------------------------------------
+			size_t total = 0;
+			for (size_t i = 0; i < modules.size(); i++) {
+				gather(*modules[i], true);
+				if (targets[i])
+					total += sizeOf(*modules[i]);
+				else
+					for (auto& eval : modules[i]->items)
+						if (isDeclaration(eval))
+							_foreign.insert(nameOf(eval.items.front()));
+			}
+			cycles();
+			if (guide) {
+				uint64_t calls = 0;
+				for (auto& c : guide->calls)
+					calls += c.second;
+				for (auto& c : guide->calls)
+					if (c.second * BusyShare >= calls)
+						_busy.insert(c.first);
+			}
+			_room = total * limits.growth / 100 + limits.body;
+			for (auto t : targets)
+				if (t)
+					statements(t->items);
+			return _count;
+		}
+
+		static size_t unfoldAll(std::vector<expr::node>& modules, const budget& limits, const feedback* guide) {
+			std::vector<const expr::node*> all;
+			std::vector<expr::node*> targets;
+			for (auto& m : modules) {
+				all.push_back(&m);
+				targets.push_back(&m);
+			}
+			return unfoldModules(all, targets, limits, guide);
+		}
+
+		size_t unfold(std::vector<expr::node>& modules, const budget& limits) {
+			return unfoldAll(modules, limits, nullptr);
+		}
+
+		size_t unfold(std::vector<expr::node>& modules, const feedback& guide, const budget& limits) {
+			return unfoldAll(modules, limits, &guide);
+		}
+
+		size_t unfold(const std::vector<const expr::node*>& modules, size_t part, expr::node& into, const budget& limits) {
+			into = *modules[part];
+			auto all = modules;
+			all[part] = &into;
+			std::vector<expr::node*> targets(modules.size());
+			targets[part] = &into;
+			return unfoldModules(all, targets, limits, nullptr);
+		}
+
+	}
+}
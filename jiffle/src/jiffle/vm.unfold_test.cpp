@@ -0,0 +1,132 @@
+#include "vm.h"
+#include <assert.h>
+#include <functional>
+
+namespace jiffle {
+	namespace vm {
+
+		void unfold_test() {
+			// internal state -------------------------------------------------
+			std::vector<expr::node> _modules;
+			std::vector<table> _tables;
+
+			// methods --------------------------------------------------------
+			auto parsed = [](const std::string& code) {
+				return expr::parse(syntax::tokenize(code), code);
+			};
+			std::function<std::string(const value&)> print = [&](const value& v) -> std::string {
+				switch (v.type) {
+				case data::Void: return "null";
+				case data::Integer: return std::to_string(v.integer);
+				case data::Real: return std::to_string((double)v.real);
+				case data::String: return "'" + v.text.str() + "'";
+				case data::Error: return "`" + v.text.str() + "`";
+				case data::Closure: return "[closure]";
+				case data::Sequence: {
+					std::string out = "(";
+					for (auto& item : v.items.materialize())
+						out += print(item) + ",";
+					return out + ")";
+				}
+				default: return "?";
+				}
+			};
+			auto output = [&](std::vector<expr::node> modules) {
+				_tables = generate(modules);
+				link(_tables);
+				std::string out;
+				if (!_tables.empty())
+					for (auto& v : execute(_tables))
+						out += print(v) + " ";
+				return out;
+			};
+			// unfolded modules output what they did before, returns the calls inlined
+			auto unfolded = [&](const std::vector<std::string>& codes, const budget& limits) {
+				_modules.clear();
+				for (auto& code : codes)
+					_modules.push_back(parsed(code));
+				auto before = output(_modules);
+				auto count = unfold(_modules, limits);
+				assert(output(_modules) == before);
+				return count;
+			};
+			auto run = [&](const std::string& code) {
+				return unfolded({ code }, { 16, 50, 4 });
+			};
+			// calls left in the module root
+			auto calls = [&]() {
+				size_t n = 0;
+				for (auto& in : _tables[0].start)
+					n += in.opcode == CALL || in.opcode == TAILCALL;
+				return n;
+			};
+
+			// tests ----------------------------------------------------------
+
+			{ // small definitions, parameters substituted
+				assert(run("three = 3\nident [x] = x\nswap [a,b] { b,a }\nthree\nident 'hi'\nswap ('yes','no')") == 3);
+				assert(calls() == 0);
+				assert(run("add [a] [b] { b, a }\nadd 3 8\nsq [x:Integer] = x * x\nsq 7, sq (ident 2)\nident [x] = x") == 4);
+				assert(calls() == 0);
+
+				// values, in arithmetics and arguments
+				assert(run("three = 3\npair { 1, 2 }\nthree + 1\nident [x] = x\nident three\nident pair\n(pair)") == 6);
+				assert(calls() == 0);
+
+				// nested, and over several modules
+				assert(unfolded({ "inc [x] = x + 1\ntwice [x] = inc (inc x)", "twice 5\nf [y:Integer] = twice y\nf 1" }, { 16, 50, 4 }) == 5);
+				assert(calls() == 0);
+
+				// errors of a body's arithmetics stay errors
+				assert(run("g [x] = (x / 0) + 5\ng 3\nh [x:Integer] = (x % 0) * 1.5\nh 7") == 2);
+			}
+			{ // one module of several, inlining its own definitions only
+				_modules = { parsed("inc [x] = x + 1\ninc 2"), parsed("inc 5\nsq [x] = x * x\nsq 3") };
+				auto before = output(_modules);
+				std::vector<const expr::node*> all = { &_modules[0], &_modules[1] };
+				expr::node into;
+				assert(unfold(all, 1, into) == 1);
+				assert(output({ _modules[0], into }) == before);
+				assert(unfold(all, 0, into) == 1);
+				assert(output({ into, _modules[1] }) == before);
+			}
+			{ // calls that stay calls
+				// recursion, direct and mutual
+				assert(run("f [x] = f x\ng [x] = h x\nh [x] = g x\n1") == 0);
+
+				// specified types the argument doesn't have, strings joined where numbers are added
+				assert(run("half [x:Real] = x / 2\nhalf 3\nsquare [x:Integer] = x * x\nsquare 1.5") == 0);
+				assert(run("glue [a] [b] = a + b\nglue 'x' 1\nname = 'x'\nname + 1") == 0);
+				assert(run("glue [a] [b] = a + b\nglue 1 2, glue 'x' 'y'") == 1);
+
+				// names meaning something else at the call
+				assert(run("three = 3\nouter { three = 4\n three }\nouter\nuse [three] { three }\nuse 5") == 1);
+				assert(run("one = 1\nthree = one\nouter { one = 4\n three }\nouter") == 2);
+				assert(run("counter { get = 5 }\ncounter.next = 6\ncounter") == 0);
+				assert(run("v [x] = x\nv [x:Integer] = 1\nv 2\n.p = 1\np") == 0);
+
+				// closures applied, arguments evaluated twice, calls with many outputs
+				assert(run("add [a] [b] = a + b\napp [f] [x] = f x\napp (add 1) 2\nsq [x] = x * x\nsq (1 + 2)") == 0);
+				assert(run("swap [a,b] { b,a }\npair { 1, 2 }\npair.x = 0\nswap (pair, 3)\nswap pair") == 0);
+
+				// partial applications stay expanded by generate
+				assert(run("add [a] [b] = a + b\nadd3to = add 3\nadd3to 6, add 1") == 0);
+			}
+			{ // budget
+				std::string body = "1";
+				for (int i = 2; i < 12; i++)
+					body += ", " + std::to_string(i);
+				auto code = "many { " + body + " }\nmany\nmany\nmany";
+				assert(unfolded({ code }, { 64, 50, 4 }) == 3);
+				assert(unfolded({ code }, { 16, 50, 4 }) == 0);
+				assert(unfolded({ code }, { 24, 0, 4 }) == 1);
+
+				// depth of calls inlined into inlined bodies
+				auto chain = "d\nd = c\nc = b\nb = a\na = 1";
+				assert(unfolded({ chain }, { 16, 50, 4 }) == 10);
+				assert(unfolded({ chain }, { 16, 50, 1 }) == 4);
+			}
+		}
+
+	}
+}
@@ -3,6 +3,15 @@
 #include "jiffle\syntax.h"
 #include "jiffle\expr.h"
 #include "jiffle\vm.h"
+#include "jiffle\stream.h"
+#include "jiffle\persist.h"
+#include "jiffle\number.h"
+#include "jiffle\text.h"
+#include "jiffle\bench.h"
+#include "jiffle\trace.h"
+#include "jiffle\serve.h"
+#include "jiffle\build.h"
+#include "jiffle\aot.h"
 
 #include <iostream>
 #include <fstream>
@@ -10,6 +19,8 @@
 #include <vector>
 #include <map>
 #include <chrono>
+#include <functional>
+#include <sstream>
 
 int main(int argc, char* argv[]) {
 	// methods ----------------------------------------------------------------
@@ -26,9 +37,10 @@ int main(int argc, char* argv[]) {
 	auto toSecs = [](const std::chrono::duration<long long, std::nano>& duration) {
 		return std::chrono::duration<double, std::ratio<1, 1>>(duration).count();
 	};
-	auto loadInput = [](const char* source) {
-		std::string str;
-		std::ifstream input(source);
+	auto loadInput = [](const char* source, std::string& str) {
+		std::ifstream input(source, std::ios::binary);
+		if (!input)
+			return false;
 
 		input.seekg(0, std::ios::end);
 		str.reserve((size_t)input.tellg());
@@ -39,25 +51,292 @@ int main(int argc, char* argv[]) {
 			std::istreambuf_iterator<char>());
 
 		input.close();
-		return str;
+		return true;
+	};
+	std::function<std::string(const jiffle::vm::value&)> print = [&](const jiffle::vm::value& v) -> std::string {
+		switch (v.type) {
+		case jiffle::data::Void: return "null";
+		case jiffle::data::Bool: return v.boolean ? "true" : "false";
+		case jiffle::data::Integer: return std::to_string(v.integer);
+		case jiffle::data::Real: {
+			std::ostringstream out;
+			out << (double)v.real;
+			return out.str();
+		}
+		case jiffle::data::String: return "'" + v.text.str() + "'";
+		case jiffle::data::Error: return "`" + v.text.str() + "`";
+		case jiffle::data::BigInteger: return jiffle::number::format(*v.big);
+		case jiffle::data::Sequence: {
+			std::string out = "(";
+			auto items = v.items.materialize();
+			for (size_t i = 0; i < items.size(); i++)
+				out += (i ? ", " : "") + print(items[i]);
+			return out + (items.size() == 1 ? ",)" : ")");
+		}
+		case jiffle::data::Object: {
+			std::string out = "{ ";
+			for (size_t i = 0; i < v.layout->members.size(); i++)
+				out += (i ? ", " : "") + v.layout->members[i] + " = " + print(v.items[i]);
+			return out + " }";
+		}
+		case jiffle::data::Closure: return "[closure]";
+		default: return "?";
+		}
+	};
+	auto usage = []() {
+		std::cout << "Usage: jiffle [--stats] [--jobs <n>] <source.jfl>...  compiles and runs sources as one program" << std::endl
+			<< "       jiffle --profile <out.folded> <source.jfl>...  sampled table stacks for flamegraphs" << std::endl
+			<< "       jiffle --record <out.profile> <source.jfl>...  calls, branches and operand types for --guided" << std::endl
+			<< "       jiffle --guided <in.profile> <source.jfl>...  inlines and lays out code by a recorded profile" << std::endl
+			<< "         (--profile and --record need the Profile configuration, which defines JIFFLE_PROFILE)" << std::endl
+			<< "       jiffle --trace <out.json> <source.jfl>...  compile and table spans for chrome://tracing" << std::endl
+			<< "       jiffle --aot <out.c> <source.jfl>...  C source and its runtime header instead of running" << std::endl
+			<< "       jiffle --serve <socket>            compile server, keeps parsed and linked sources warm" << std::endl
+			<< "       jiffle --connect <socket> run|compile <source.jfl>...  through the server (or stats|drop|stop)" << std::endl
+			<< "       jiffle --test                      runs the unit tests (default)" << std::endl
+			<< "       jiffle --bench [bytes] [runs]      front-end stages over a synthetic corpus, as JSON" << std::endl;
+	};
+	auto test = [&]() {
+		auto timer = clockTime();
+
+		jiffle::syntax::tokenize_test();
+		jiffle::expr::parse_test();
+		jiffle::expr::pool_test();
+		jiffle::vm::infer_test();
+		jiffle::vm::match_test();
+		jiffle::vm::generate_test();
+		jiffle::vm::unfold_test();
+		jiffle::vm::link_test();
+		jiffle::vm::merge_test();
+		jiffle::vm::execute_test();
+		jiffle::vm::shape_test();
+		jiffle::vm::schedule_test();
+		jiffle::vm::state_test();
+		jiffle::vm::profile_test();
+		jiffle::vm::feedback_test();
+		jiffle::stream::range_test();
+		jiffle::stream::kernel_test();
+		jiffle::stream::pipeline_test();
+		jiffle::persist::vector_test();
+		jiffle::persist::map_test();
+		jiffle::number::integer_test();
+		jiffle::text::string_test();
+		jiffle::bench::corpus_test();
+		jiffle::bench::usage_test();
+		jiffle::trace::events_test();
+		jiffle::serve::server_test();
+		jiffle::build::project_test();
+		jiffle::aot::translate_test();
+
+		auto metric = clockMeasure(timer);
+		std::cout << "Tests: " << toSecs(metric) << " sec" << std::endl;
 	};
 
 	// entry ------------------------------------------------------------------
 
-	//if (argc != 2) {
-	//	std::cout << "Usage: jiffle <source.jfl>" << std::endl;
-	//	return 1;
-	//}
-	
-	auto timer = clockTime();
+	std::vector<const char*> sources;
+	const char* profiled = nullptr;
+	const char* recorded = nullptr;
+	const char* guided = nullptr;
+	const char* traced = nullptr;
+	const char* translated = nullptr;
+	size_t jobs = 0;
+	auto stats = false;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--test") {
+			test();
+			return 0;
+		}
+		if (arg == "--bench") {
+			auto bytes = i + 1 < argc ? std::stoul(argv[i + 1]) : 4 * 1024 * 1024;
+			auto runs = i + 2 < argc ? std::stoul(argv[i + 2]) : 5;
+			std::cout << jiffle::bench::json(jiffle::bench::measure(jiffle::bench::corpus(bytes), runs)) << std::endl;
+			return 0;
+		}
+		if (arg == "--serve" && i + 1 < argc) {
+			jiffle::serve::server daemon(print);
+			if (daemon.listen(argv[i + 1]))
+				return 0;
+			std::cerr << "jiffle: cannot listen on '" << argv[i + 1] << "'" << std::endl;
+			return 1;
+		}
+		if (arg == "--connect" && i + 2 < argc) {
+			std::string out, err;
+			auto code = jiffle::serve::request(argv[i + 1], argv[i + 2],
+				std::vector<std::string>(argv + i + 3, argv + argc), out, err);
+			std::cout << out;
+			std::cerr << err;
+			if (code < 0)
+				std::cerr << "jiffle: no server on '" << argv[i + 1] << "'" << std::endl;
+			return code < 0 ? 1 : code;
+		}
+		if (arg == "--stats")
+			stats = true;
+		else if (arg == "--profile" && i + 1 < argc)
+			profiled = argv[++i];
+		else if (arg == "--record" && i + 1 < argc)
+			recorded = argv[++i];
+		else if (arg == "--guided" && i + 1 < argc)
+			guided = argv[++i];
+		else if (arg == "--trace" && i + 1 < argc)
+			traced = argv[++i];
+		else if (arg == "--aot" && i + 1 < argc)
+			translated = argv[++i];
+		else if (arg == "--jobs" && i + 1 < argc)
+			jobs = std::stoul(argv[++i]);
+		else if (arg.size() > 1 && arg[0] == '-') {
+			usage();
+			return 1;
+		}
+		else
+			sources.push_back(argv[i]);
+	}
+	if (sources.empty()) {
+		if (stats || profiled || recorded || guided || traced || translated || jobs) {
+			usage();
+			return 1;
+		}
+		test();
+		return 0;
+	}
+
+	// phases of the whole program, each measured when asked
+	std::vector<jiffle::bench::phase> phases;
+	auto measured = [&](const char* name, const std::function<void()>& run) {
+		auto start = jiffle::bench::now();
+		run();
+		if (stats)
+			phases.push_back(jiffle::bench::since(name, start));
+	};
 
-	jiffle::syntax::tokenize_test();
-	jiffle::expr::parse_test();
-	jiffle::vm::generate_test();
+	std::vector<std::string> codes(sources.size());
+	std::vector<std::vector<jiffle::syntax::token>> tokens(sources.size());
+	std::vector<jiffle::expr::node> modules(sources.size());
+	std::vector<jiffle::vm::table> tables;
+	std::vector<jiffle::vm::value> output;
+	jiffle::vm::feedback guide;
+	auto loaded = true;
+	auto resolved = true;
 
-	auto metric = clockMeasure(timer);
-	std::cout << "Tests: " << toSecs(metric) << " sec" << std::endl;
-	getchar();
-	return 0;	
+	if (traced && !jiffle::trace::start(traced)) {
+		std::cerr << "jiffle: cannot write '" << traced << "'" << std::endl;
+		return 1;
+	}
+	measured("load", [&]() {
+		for (size_t i = 0; i < sources.size(); i++) {
+			jiffle::trace::scope span(sources[i], "load");
+			if (!loadInput(sources[i], codes[i])) {
+				std::cerr << "jiffle: cannot read '" << sources[i] << "'" << std::endl;
+				loaded = false;
+			}
+		}
+	});
+	if (guided) {
+		std::string text;
+		if (!loadInput(guided, text) || !jiffle::vm::load(text, guide)) {
+			std::cerr << "jiffle: cannot read profile '" << guided << "'" << std::endl;
+			loaded = false;
+		}
+		else if (jobs)
+			std::cerr << "jiffle: --guided builds in one process, the profile is ignored with --jobs" << std::endl;
+	}
+	if (!loaded) {
+		jiffle::trace::stop();
+		return 1;
+	}
+	if (jobs) {
+		// modules compiled side by side, one phase for all stages
+		measured("build", [&]() {
+			std::vector<std::pair<std::string, std::string>> named;
+			for (size_t i = 0; i < sources.size(); i++)
+				named.push_back({ sources[i], codes[i] });
+			std::vector<std::string> unresolved;
+			tables = jiffle::build::project(jobs).build(named, unresolved);
+			for (auto& symbol : unresolved)
+				std::cerr << "jiffle: unresolved symbol '" << symbol << "'" << std::endl;
+			resolved = unresolved.empty();
+		});
+	}
+	else {
+		measured("tokenize", [&]() {
+			for (size_t i = 0; i < sources.size(); i++)
+				tokens[i] = jiffle::syntax::tokenize(codes[i]);
+		});
+		measured("parse", [&]() {
+			for (size_t i = 0; i < sources.size(); i++)
+				modules[i] = jiffle::expr::parse(tokens[i], codes[i]);
+		});
+		std::vector<const jiffle::expr::node*> roots;
+		for (auto& m : modules)
+			roots.push_back(&m);
+		std::vector<std::string> unresolved;
+		tables = jiffle::vm::compile(roots, unresolved, guided ? &guide : nullptr, measured);
+		for (auto& symbol : unresolved)
+			std::cerr << "jiffle: unresolved symbol '" << symbol << "'" << std::endl;
+		resolved = unresolved.empty();
+	}
+	if (translated) {
+		// native code through a C compiler, the runtime header beside the source
+		std::string source;
+		std::vector<std::string> unsupported;
+		auto ok = true;
+		measured("translate", [&]() {
+			ok = jiffle::aot::translate(tables, source, unsupported);
+		});
+		jiffle::trace::stop();
+		for (auto& what : unsupported)
+			std::cerr << "jiffle: cannot translate " << what << std::endl;
+		if (!ok || !resolved)
+			return 1;
+		std::string path = translated;
+		auto folder = path.find_last_of("/\\");
+		auto header = (folder == std::string::npos ? std::string() : path.substr(0, folder + 1)) + "jiffle_runtime.h";
+		std::ofstream c(path, std::ios::binary), h(header, std::ios::binary);
+		c << source;
+		h << jiffle::aot::runtime();
+		if (!c || !h) {
+			std::cerr << "jiffle: cannot write '" << (c ? header : path) << "'" << std::endl;
+			return 1;
+		}
+		if (stats)
+			std::cerr << jiffle::bench::format(phases);
+		return 0;
+	}
+	// stacks sampled every few hundred instructions, an odd interval
+	// so loops of a fixed length don't always sample the same place
+	jiffle::vm::profile profile(997);
+	if ((profiled || recorded) && !jiffle::vm::Profiling)
+		std::cerr << "jiffle: built without JIFFLE_PROFILE, the profile is empty (build the Profile configuration)" << std::endl;
+	measured("execute", [&]() {
+		if (tables.empty())
+			return;
+		output = profiled || recorded ? jiffle::vm::execute(tables, profile) : jiffle::vm::execute(tables);
+	});
+	if (traced) {
+		auto dropped = jiffle::trace::stop();
+		if (dropped)
+			std::cerr << "jiffle: trace dropped " << dropped << " events" << std::endl;
+	}
+	if (profiled) {
+		std::ofstream folded(profiled, std::ios::binary);
+		folded << jiffle::vm::collapsed(profile);
+		if (!folded)
+			std::cerr << "jiffle: cannot write '" << profiled << "'" << std::endl;
+	}
+	if (recorded) {
+		std::ofstream saved(recorded, std::ios::binary);
+		saved << jiffle::vm::save(profile, tables);
+		if (!saved)
+			std::cerr << "jiffle: cannot write '" << recorded << "'" << std::endl;
+	}
 
-}
\ No newline at end of file
+	for (auto& v : output)
+		std::cout << print(v) << std::endl;
+	if (stats)
+		std::cerr << jiffle::bench::format(phases);
+	if (stats && profiled)
+		std::cerr << jiffle::vm::summary(profile, tables);
+	// the program ran with errors in place of what is unresolved
+	return resolved ? 0 : 1;
+}